@@ -0,0 +1,168 @@
+#pragma once
+
+// multi_index of the instrumented build (postoken_dbstats target): the same table with every database
+// access of an action counted, so the counts follow the code instead of call sites.
+// find:    find, get, require_find, lower_bound, upper_bound, begin (and iterator_to of secondary indices)
+// emplace, modify, erase
+// next:    iterator steps (++ and --)
+
+#include <eosiolib/multi_index.hpp>
+
+namespace postoken_db_stats {
+
+struct counters {
+   uint32_t find    = 0;
+   uint32_t emplace = 0;
+   uint32_t modify  = 0;
+   uint32_t erase   = 0;
+   uint32_t next    = 0;
+};
+
+// Counters of the running action (every action starts with fresh memory)
+inline counters& get_counters() {
+   static counters c;
+   return c;
+}
+
+template<typename Iterator>
+class counted_iterator : public Iterator {
+public:
+   counted_iterator( const Iterator& it ) : Iterator(it) {}
+
+   counted_iterator& operator++() {
+      ++get_counters().next;
+      Iterator::operator++();
+      return *this;
+   }
+   counted_iterator operator++(int) {
+      counted_iterator it = *this;
+      ++*this;
+      return it;
+   }
+   counted_iterator& operator--() {
+      ++get_counters().next;
+      Iterator::operator--();
+      return *this;
+   }
+   counted_iterator operator--(int) {
+      counted_iterator it = *this;
+      --*this;
+      return it;
+   }
+};
+
+// Secondary index of a multi_index below
+template<typename Index>
+class counted_index : public Index {
+public:
+   using const_iterator = counted_iterator<typename Index::const_iterator>;
+
+   counted_index( const Index& index ) : Index(index) {}
+
+   const_iterator begin()const { ++get_counters().find; return Index::begin(); }
+   const_iterator end()const   { return Index::end(); }
+
+   template<typename Key>
+   const_iterator find( const Key& key )const { ++get_counters().find; return Index::find(key); }
+
+   template<typename Key>
+   const_iterator require_find( const Key& key, const char* error_msg = "unable to find secondary key" )const {
+      ++get_counters().find;
+      return Index::require_find(key, error_msg);
+   }
+
+   template<typename Key>
+   const auto& get( const Key& key, const char* error_msg = "unable to find secondary key" )const {
+      ++get_counters().find;
+      return Index::get(key, error_msg);
+   }
+
+   template<typename Key>
+   const_iterator lower_bound( const Key& key )const { ++get_counters().find; return Index::lower_bound(key); }
+
+   template<typename Key>
+   const_iterator upper_bound( const Key& key )const { ++get_counters().find; return Index::upper_bound(key); }
+
+   template<typename T>
+   const_iterator iterator_to( const T& obj ) { ++get_counters().find; return Index::iterator_to(obj); }
+
+   template<typename Lambda>
+   void modify( const_iterator itr, eosio::name payer, Lambda&& updater ) {
+      ++get_counters().modify;
+      Index::modify(itr, payer, std::forward<Lambda>(updater));
+   }
+
+   const_iterator erase( const_iterator itr ) {
+      ++get_counters().erase;
+      return Index::erase(itr);
+   }
+};
+
+template<eosio::name::raw TableName, typename T, typename... Indices>
+class multi_index : public eosio::multi_index<TableName, T, Indices...> {
+   using base = eosio::multi_index<TableName, T, Indices...>;
+public:
+   using const_iterator = counted_iterator<typename base::const_iterator>;
+
+   using base::base;
+
+   const_iterator begin()const { ++get_counters().find; return base::begin(); }
+   const_iterator end()const   { return base::end(); }
+
+   const_iterator find( uint64_t primary )const { ++get_counters().find; return base::find(primary); }
+
+   const_iterator require_find( uint64_t primary, const char* error_msg = "unable to find key" )const {
+      ++get_counters().find;
+      return base::require_find(primary, error_msg);
+   }
+
+   const T& get( uint64_t primary, const char* error_msg = "unable to find key" )const {
+      ++get_counters().find;
+      return base::get(primary, error_msg);
+   }
+
+   const_iterator lower_bound( uint64_t primary )const { ++get_counters().find; return base::lower_bound(primary); }
+   const_iterator upper_bound( uint64_t primary )const { ++get_counters().find; return base::upper_bound(primary); }
+
+   const_iterator iterator_to( const T& obj )const { return base::iterator_to(obj); }
+
+   template<eosio::name::raw IndexName>
+   auto get_index() {
+      return counted_index<decltype(base::template get_index<IndexName>())>(base::template get_index<IndexName>());
+   }
+
+   template<eosio::name::raw IndexName>
+   auto get_index()const {
+      return counted_index<decltype(base::template get_index<IndexName>())>(base::template get_index<IndexName>());
+   }
+
+   template<typename Lambda>
+   const_iterator emplace( eosio::name payer, Lambda&& constructor ) {
+      ++get_counters().emplace;
+      return base::emplace(payer, std::forward<Lambda>(constructor));
+   }
+
+   template<typename Lambda>
+   void modify( const_iterator itr, eosio::name payer, Lambda&& updater ) {
+      ++get_counters().modify;
+      base::modify(itr, payer, std::forward<Lambda>(updater));
+   }
+
+   template<typename Lambda>
+   void modify( const T& obj, eosio::name payer, Lambda&& updater ) {
+      ++get_counters().modify;
+      base::modify(obj, payer, std::forward<Lambda>(updater));
+   }
+
+   const_iterator erase( const_iterator itr ) {
+      ++get_counters().erase;
+      return base::erase(itr);
+   }
+
+   void erase( const T& obj ) {
+      ++get_counters().erase;
+      base::erase(obj);
+   }
+};
+
+}
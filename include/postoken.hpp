@@ -1,9 +1,20 @@
 #include <eosiolib/eosio.hpp>
 #include <eosiolib/asset.hpp>
+#include <eosiolib/binary_extension.hpp>
+
+#include <limits>
 
 using namespace eosio;
 using std::string;
 
+// Instrumented build (postoken_dbstats target) counts multi_index accesses of every action
+#ifdef POSTOKEN_DB_STATS
+#include "db_stats.hpp"
+namespace postoken_tables = postoken_db_stats;
+#else
+namespace postoken_tables = eosio;
+#endif
+
 inline uint32_t epoch_to_days(uint32_t epoch_time) {
    return epoch_time / 60 / 60 / 24;
 }
@@ -12,12 +23,60 @@ class [[eosio::contract("postoken")]] postoken : public contract {
 public:
    using contract::contract;
 
+#ifdef POSTOKEN_DB_STATS
+   // Prints "DBSTATS find=.. emplace=.. modify=.. erase=.. next=.." once action is done
+   ~postoken();
+#endif
+
    typedef uint32_t timestamp_t;
    struct interest_t {
       asset    interest_rate;
       uint16_t years;
    };
 
+   enum event_type : uint8_t {
+      issue_event       = 0,
+      retire_event      = 1,
+      mint_event        = 2,
+      consolidate_event = 3, // all transfer ins of a symbol replaced by (at most) one
+      compact_event     = 4, // transfer ins of a symbol with id < new_id folded into new_id
+      debit_event       = 5, // `erased` newest transfer ins of a symbol erased, new_id debited partially
+      submint_event     = 6, // reward minted to sub-account new_id of the account's sub-ledger, new_quantity is its balance
+      subsettle_event   = 7  // sub-ledger rewards added to the account's balance as transfer in new_id
+   };
+   static constexpr uint8_t event_version = 1;
+
+   // Per token features, set by the issuer with `setoptions`
+   enum token_option : uint32_t {
+      holder_registry_option     = 1, // keep `holders` table (balances ordered by amount) up to date
+      balance_checkpoints_option = 2, // record balance history in `checkpoints` tables
+      newest_first_debit_option  = 4, // debit newest transfer ins instead of replacing all of them
+      deferred_supply_option     = 8  // mint draws from `rewardpool` budgets, `settle` updates supply
+   };
+   static constexpr uint32_t known_options = holder_registry_option | balance_checkpoints_option |
+                                             newest_first_debit_option | deferred_supply_option;
+   static constexpr uint16_t max_pool_shards = 256;
+
+   // Reward pool of a token with deferred_supply_option (amounts in the token's smallest units)
+   struct reward_pool_spec {
+      uint16_t shards;       // rows of `rewardpool`, mint uses row account % shards
+      int64_t  shard_budget; // settle tops every row's budget up to this
+      int64_t  reserved;     // sum of budget + pending of all rows, not available to issue
+   };
+
+   // State deltas which can't be derived from action arguments alone.
+   // Sent to off-chain indexers as an inline `event` action.
+   struct stake_event {
+      uint8_t     version;
+      uint8_t     type;          // event_type
+      name        account;
+      asset       quantity;      // supply delta for issue/retire/mint, balance delta for consolidate
+      uint32_t    erased;        // transfer ins of this symbol erased
+      uint64_t    new_id;        // transfer in created (valid if new_quantity.amount > 0)
+      asset       new_quantity;
+      timestamp_t time;
+   };
+
    [[eosio::action]]
    void create( name   issuer,
                 asset  maximum_supply);
@@ -34,12 +93,28 @@ public:
                   asset   quantity,
                   string  memo );
 
+   // transfer of the default token (see setdefsym) without memo, for payment flows
+   [[eosio::action]]
+   void xfer( name from, name to, int64_t amount );
+
+   // Sets the token xfer transfers, contract account only
+   [[eosio::action]]
+   void setdefsym( const symbol_code& sym_code );
+
    [[eosio::action]]
    void open( name owner, const symbol& symbol, name ram_payer );
 
    [[eosio::action]]
    void close( name owner, const symbol& symbol );
 
+   // open for many owners, stat is checked once
+   [[eosio::action]]
+   void openmany( const std::vector<name>& owners, const symbol& symbol, name ram_payer );
+
+   // close for many owners, needs authority of every one of them
+   [[eosio::action]]
+   void closemany( const std::vector<name>& owners, const symbol& symbol );
+
    [[eosio::action]]
    void setstakespec(const timestamp_t stake_start_time, 
                      const uint16_t min_coin_age, const uint16_t max_coin_age, 
@@ -48,6 +123,64 @@ public:
    [[eosio::action]]
    void mint(const name& account, const symbol_code& sym_code);
 
+   // mint for every token the account has transfer ins of, tokens with nothing to claim are skipped
+   [[eosio::action]]
+   void mintall(const name& account);
+
+   // Folds (at most max_rows) transfer ins older than max_coin_age into one, anyone can call it.
+   // They all earn quantity * max_coin_age, so rewards don't change.
+   [[eosio::action]]
+   void compact(const name& account, const symbol_code& sym_code, uint32_t max_rows);
+
+   // options - token_option bits
+   [[eosio::action]]
+   void setoptions(const symbol_code& sym_code, uint32_t options);
+
+   // Reward pool for deferred_supply_option. The new shard_budget is allocated by the next settle,
+   // shards can only change once nothing is reserved (shard_budget 0 and settle).
+   [[eosio::action]]
+   void setrewardpool(const symbol_code& sym_code, uint16_t shards, const asset& shard_budget);
+
+   // Adds rewards minted from the pool to supply and refills budgets within max_supply, anyone can call it
+   [[eosio::action]]
+   void settle(const symbol_code& sym_code);
+
+   // Adds (or updates) owner's row in the holder registry, for holders which haven't
+   // had their balance changed since the registry was enabled
+   [[eosio::action]]
+   void regholder(name owner, const symbol_code& sym_code, name ram_payer);
+
+   // Creates the `aggregates` row of a token created before aggregates were introduced, from the
+   // accounts and transfer ins of owners. Issuer only. Owners (sorted, unique) have to be every
+   // account with a balance of the token, their balances are checked against supply.
+   [[eosio::action]]
+   void initagg(const symbol_code& sym_code, const std::vector<name>& owners);
+
+   // Omnibus sub-ledger of a custodian's balance (see `subaccounts`). subdeposit assigns part of the
+   // balance to a sub-account, subwithdraw takes it back. Custodian's authority is needed for all of them.
+   [[eosio::action]]
+   void subdeposit( name custodian, uint64_t sub, const asset& quantity );
+
+   [[eosio::action]]
+   void subwithdraw( name custodian, uint64_t sub, const asset& quantity );
+
+   // Moves quantity between two sub-accounts, without transfer ins or notifications
+   [[eosio::action]]
+   void submove( name custodian, uint64_t from, uint64_t to, const asset& quantity );
+
+   // mint for each of the sub-accounts, those with nothing to claim are skipped. Rewards are added to
+   // supply and the sub-accounts right away, and to the custodian's balance by subsettle.
+   [[eosio::action]]
+   void submint( name custodian, const std::vector<uint64_t>& subs );
+
+   // Adds the unsettled rewards of the custodian's sub-accounts of a token to its balance, as one transfer in
+   [[eosio::action]]
+   void subsettle( name custodian, const symbol_code& sym_code );
+
+   // Does nothing, its arguments are recorded in action traces for indexers
+   [[eosio::action]]
+   void event(const stake_event& ev);
+
    static asset get_supply( name token_contract_account, symbol_code sym_code )
    {
       stats statstable( token_contract_account, sym_code.raw() );
@@ -62,16 +195,58 @@ public:
       return ac.balance;
    }
 
+   // Balance at epoch time `time`, from checkpoints (balance_checkpoints_option)
+   static asset get_balance_at( name token_contract_account, name owner, symbol_code sym_code, timestamp_t time )
+   {
+      checkpoints cptable( token_contract_account, owner.value );
+      return find_checkpoint( cptable, sym_code, time ).balance;
+   }
+
+   // Time weighted average balance over [from, to), exact as long as checkpoints cover the period
+   static asset get_average_balance( name token_contract_account, name owner, symbol_code sym_code,
+                                     timestamp_t from, timestamp_t to )
+   {
+      check( from < to, "invalid period" );
+      checkpoints cptable( token_contract_account, owner.value );
+      const auto& cp_from = find_checkpoint( cptable, sym_code, from );
+      const auto& cp_to   = find_checkpoint( cptable, sym_code, to );
+      uint128_t to_sum = cp_to.cumulative_at( to ), from_sum = cp_from.cumulative_at( from );
+      check( to_sum >= from_sum, "checkpoints are inconsistent" );
+      uint128_t sum = to_sum - from_sum;
+      return asset( static_cast<int64_t>(sum / (to - from)), cp_to.balance.symbol );
+   }
+
    using create_action = eosio::action_wrapper<"create"_n, &postoken::create>;
    using issue_action = eosio::action_wrapper<"issue"_n, &postoken::issue>;
    using retire_action = eosio::action_wrapper<"retire"_n, &postoken::retire>;
    using transfer_action = eosio::action_wrapper<"transfer"_n, &postoken::transfer>;
+   using xfer_action = eosio::action_wrapper<"xfer"_n, &postoken::xfer>;
+   using setdefsym_action = eosio::action_wrapper<"setdefsym"_n, &postoken::setdefsym>;
    using open_action = eosio::action_wrapper<"open"_n, &postoken::open>;
    using close_action = eosio::action_wrapper<"close"_n, &postoken::close>;
+   using openmany_action = eosio::action_wrapper<"openmany"_n, &postoken::openmany>;
+   using closemany_action = eosio::action_wrapper<"closemany"_n, &postoken::closemany>;
    using mint_action = eosio::action_wrapper<"mint"_n, &postoken::mint>;
+   using mintall_action = eosio::action_wrapper<"mintall"_n, &postoken::mintall>;
+   using compact_action = eosio::action_wrapper<"compact"_n, &postoken::compact>;
+   using setoptions_action = eosio::action_wrapper<"setoptions"_n, &postoken::setoptions>;
+   using setrewardpool_action = eosio::action_wrapper<"setrewardpool"_n, &postoken::setrewardpool>;
+   using settle_action = eosio::action_wrapper<"settle"_n, &postoken::settle>;
+   using regholder_action = eosio::action_wrapper<"regholder"_n, &postoken::regholder>;
+   using initagg_action = eosio::action_wrapper<"initagg"_n, &postoken::initagg>;
+   using subdeposit_action = eosio::action_wrapper<"subdeposit"_n, &postoken::subdeposit>;
+   using subwithdraw_action = eosio::action_wrapper<"subwithdraw"_n, &postoken::subwithdraw>;
+   using submove_action = eosio::action_wrapper<"submove"_n, &postoken::submove>;
+   using submint_action = eosio::action_wrapper<"submint"_n, &postoken::submint>;
+   using subsettle_action = eosio::action_wrapper<"subsettle"_n, &postoken::subsettle>;
+   using event_action = eosio::action_wrapper<"event"_n, &postoken::event>;
 private:
    struct [[eosio::table]] account {
       asset    balance;
+      // Time of the oldest transfer in of this balance. Mint is possible once
+      // max(stake_start_time, first_in) + min_coin_age days have passed.
+      // Rows of earlier contract versions get it once their transfer ins are replaced.
+      binary_extension<timestamp_t> first_in;
 
       uint64_t primary_key()const { return balance.symbol.code().raw(); }
    };
@@ -98,30 +273,227 @@ private:
       uint16_t                max_coin_age; // days
       std::vector<interest_t> anual_interests;
       timestamp_t             stake_start_time; // epoch time in seconds
+      binary_extension<uint32_t> options;       // token_option bits
+      binary_extension<reward_pool_spec> pool;  // set by setrewardpool
 
       uint64_t primary_key() const { return supply.symbol.code().raw(); }
+
+      uint32_t get_options() const { return options.has_value() ? options.value() : 0; }
+      bool has_option(token_option o) const { return get_options() & o; }
+      // Supply allocated to reward pools, which issue can't use
+      int64_t get_reserved() const { return pool.has_value() ? pool.value().reserved : 0; }
+   };
+
+   // Contract-wide settings, a single row (scope is the contract account)
+   struct [[eosio::table]] config {
+      symbol   default_symbol; // token of xfer
+      uint32_t options;        // token_option bits of default_symbol, copied from its stat row
+
+      uint64_t primary_key() const { return 0; }
+   };
+
+   // Holder registry (scope is symbol code), only kept with holder_registry_option.
+   // Secondary index lists holders from the largest balance down.
+   struct [[eosio::table]] holder {
+      name  owner;
+      asset balance;
+
+      uint64_t primary_key() const { return owner.value; }
+      uint64_t by_balance() const { return std::numeric_limits<uint64_t>::max() - balance.amount; }
+   };
+
+   // System-wide staking state of a token (scope is symbol code), kept up to date on every balance change.
+   // Outstanding coin age at time t, before min_coin_age/max_coin_age are applied, is
+   // (total_balance.amount * t - weighted_time) / 86400 coin-days.
+   struct [[eosio::table]] aggregate {
+      asset     total_balance; // sum of all transfer ins (and of all balances)
+      uint128_t weighted_time; // sum of quantity.amount * time of all transfer ins
+      uint64_t  holders;       // accounts with non-zero balance
+
+      uint64_t primary_key() const { return total_balance.symbol.code().raw(); }
+   };
+
+   // Reward budget of a token with deferred_supply_option (scope is symbol code), one row per shard.
+   // Rewards are minted from `budget` and kept in `pending` until settle adds them to supply.
+   struct [[eosio::table]] reward_shard {
+      uint64_t shard;
+      asset    budget;
+      asset    pending;
+
+      uint64_t primary_key() const { return shard; }
+   };
+
+   // Balance history (scope is owner), only kept with balance_checkpoints_option.
+   // One row per symbol and balance change, changes in the same second share a row.
+   struct [[eosio::table]] checkpoint {
+      uint64_t    id;
+      asset       balance;    // balance from `time` until the next checkpoint
+      timestamp_t time;
+      uint128_t   cumulative; // sum of balance.amount * seconds held, from the first checkpoint until `time`
+
+      uint64_t primary_key() const { return id; }
+      uint128_t by_symbol_time() const { return (uint128_t(balance.symbol.code().raw()) << 64) | time; }
+
+      uint128_t cumulative_at(timestamp_t t) const { return cumulative + uint128_t(balance.amount) * (t - time); }
    };
 
-   typedef eosio::multi_index< "accounts"_n, account > accounts;
-   typedef eosio::multi_index< "stat"_n, currency_stats > stats;
-   typedef eosio::multi_index< "transferins"_n, transfer_in, 
-                               indexed_by<"symbol"_n, const_mem_fun<transfer_in, uint64_t, &transfer_in::symbol_key>>
+   // Sub-ledger of a custodian's balance of a token (scope is the custodian). Its sub-accounts hold
+   // allocated + unsettled, the custodian's balance always covers allocated (debits can't take it).
+   // While the row exists the custodian's balance can't be minted, rewards are earned per sub-account.
+   // Creating and erasing the row restarts coin age of the balance, so no period is paid twice.
+   struct [[eosio::table]] sub_ledger {
+      asset allocated; // part of the custodian's balance assigned to sub-accounts
+      asset unsettled; // rewards minted to sub-accounts, not yet in the custodian's balance
+
+      uint64_t primary_key() const { return allocated.symbol.code().raw(); }
+   };
+
+   // Sub-account of a custodian (scope is the custodian, id is the custodian's), holds one token.
+   // It earns like a balance with a single transfer in at `time`: a credit moves `time` to the quantity
+   // weighted average, so coin-days held so far are kept, a debit leaves it as it is, mint resets it.
+   // Rows are erased once their balance is 0.
+   struct [[eosio::table]] sub_account {
+      uint64_t    id;
+      asset       balance;
+      timestamp_t time;
+
+      uint64_t primary_key() const { return id; }
+   };
+
+   struct erased_transferins {
+      uint32_t  count = 0;
+      uint128_t weighted_time = 0; // sum of quantity.amount * time of erased transfer ins
+   };
+
+   struct debited_transferins {
+      uint32_t  count = 0;         // erased transfer ins
+      uint128_t weighted_time = 0; // sum of debited amount * time
+      uint64_t  id = 0;            // transfer in debited partially (valid if quantity.amount > 0)
+      asset     quantity;          // what is left of it
+   };
+
+   typedef postoken_tables::multi_index< "accounts"_n, account > accounts;
+   typedef postoken_tables::multi_index< "stat"_n, currency_stats > stats;
+   typedef postoken_tables::multi_index< "config"_n, config > configs;
+   typedef postoken_tables::multi_index< "aggregates"_n, aggregate > aggregates;
+   typedef postoken_tables::multi_index< "rewardpool"_n, reward_shard > reward_pool;
+   typedef postoken_tables::multi_index< "subledgers"_n, sub_ledger > sub_ledgers;
+   typedef postoken_tables::multi_index< "subaccounts"_n, sub_account > sub_accounts;
+   typedef postoken_tables::multi_index< "holders"_n, holder,
+                                         indexed_by<"balance"_n, const_mem_fun<holder, uint64_t, &holder::by_balance>>
+                             > holders;
+   typedef postoken_tables::multi_index< "checkpoints"_n, checkpoint,
+                                         indexed_by<"symtime"_n, const_mem_fun<checkpoint, uint128_t, &checkpoint::by_symbol_time>>
+                             > checkpoints;
+   typedef postoken_tables::multi_index< "transferins"_n, transfer_in, 
+                                         indexed_by<"symbol"_n, const_mem_fun<transfer_in, uint64_t, &transfer_in::symbol_key>>
                              > transfer_ins; 
 
-   void sub_balance( name owner, asset value, name ram_payer ); // ram_payer - for transferins
-   void add_balance( name owner, asset value, name ram_payer );
+   // ram_payer - for transferins, options - token_option bits of value's token
+   void sub_balance( name owner, asset value, name ram_payer, uint32_t options );
+   // Returns id of the new transfer in
+   uint64_t add_balance( name owner, asset value, name ram_payer, uint32_t options );
+
+   void update_holder( name owner, asset balance, name ram_payer );
+
+   // Replaces owner's transfer ins of balance's token with one dated now and sets first_in to now,
+   // so coin age starts over (when a sub-ledger is created or erased). Owner pays for the new row.
+   void restart_coin_age( name owner, asset balance );
+
+   // Sub-account balance changes, custodian pays for new rows
+   void credit_sub_account( sub_accounts& subs, name custodian, uint64_t sub, asset quantity );
+   void debit_sub_account( sub_accounts& subs, uint64_t sub, asset quantity );
+   void update_checkpoint( name owner, asset balance, name ram_payer );
+
+   // Last checkpoint at or before time
+   static const checkpoint& find_checkpoint( const checkpoints& cptable, symbol_code sym_code, timestamp_t time )
+   {
+      auto index = cptable.get_index<"symtime"_n>();
+      auto it = index.upper_bound( (uint128_t(sym_code.raw()) << 64) | time );
+      check( it != index.begin(), "no checkpoint at that time" );
+      --it;
+      check( it->balance.symbol.code() == sym_code, "no checkpoint at that time" );
+      return *it;
+   }
 
    asset get_interest_rate(const currency_stats& stats, uint32_t epoch_time);
 
+   // Shared by mint and mintall.
+   // False if acc's oldest transfer in is too young to earn, without reading transfer ins.
+   static bool can_claim(const currency_stats& st, const account& acc, timestamp_t curr_time);
+   // Adds tr to balance and its coin age (from min_coin_age, capped at max_coin_age) to coin_age
+   static void add_coin_age(const currency_stats& st, const transfer_in& tr, timestamp_t curr_time,
+                            asset& balance, asset& coin_age);
+   static asset get_reward(asset coin_age, asset interest_rate);
+   // Adds reward (as much of it as max_supply allows) to supply. With deferred_supply_option it is
+   // taken from account's reward pool shard first. Returns what was issued.
+   asset issue_reward(stats& statstable, const currency_stats& st, name account, asset reward);
+   // Issues reward to account and replaces its transfer ins of the token (first is the first of them)
+   // with a single one holding balance + issued reward. Nothing is changed if nothing can be issued.
+   // Returns issued reward.
    template<typename Index>
-   void erase_transferins(Index& index, const symbol& sym) {
-      symbol_code sym_code = sym.code();
+   asset claim_reward(name account, stats& statstable, const currency_stats& st, accounts& acnts,
+                     const postoken::account& acc, transfer_ins& tr_table, Index& index,
+                     typename Index::const_iterator first, asset balance, asset reward);
+
+   // Tokens created before aggregates were introduced have no row until initagg, changes before it are
+   // part of the balances initagg reads
+   void update_aggregate(asset balance_delta, uint128_t added_weight, uint128_t removed_weight,
+                         int32_t holders_delta);
+
+   void send_event(event_type type, name account, asset quantity,
+                   uint32_t erased, uint64_t new_id, asset new_quantity);
+
+   template<typename Index>
+   erased_transferins erase_transferins(Index& index, const symbol& sym) {
       // Returns lower bound - first matching
-      auto itr = index.require_find(sym_code.raw(), "No transfer ins found");
+      auto itr = index.require_find(sym.code().raw(), "No transfer ins found");
+      return erase_transferins(index, itr, sym);
+   }
+
+   // Erases transfer ins of sym starting with itr, the first of them
+   template<typename Index>
+   erased_transferins erase_transferins(Index& index, typename Index::const_iterator itr, const symbol& sym) {
+      symbol_code sym_code = sym.code();
+      erased_transferins erased;
       do {
          check(itr->quantity.symbol == sym, "Invalid precision in transferin!");
+         erased.weighted_time += uint128_t(itr->quantity.amount) * itr->time;
          itr = index.erase(itr);
+         erased.count++;
       } while( itr != index.end() && itr->quantity.symbol.code() == sym_code );
+      return erased;
+   }
+
+   // Takes value from the newest transfer ins of its symbol, only the rows it covers are erased or modified
+   template<typename Index>
+   debited_transferins debit_transferins(Index& index, asset value) {
+      symbol_code sym_code = value.symbol.code();
+      debited_transferins debited;
+      debited.quantity = asset(0, value.symbol);
+      // Ids of a symbol's transfer ins grow with time, newest is the last one of the symbol
+      auto itr = index.upper_bound(sym_code.raw());
+      while( value.amount > 0 ) {
+         check(itr != index.begin(), "No transfer ins found");
+         --itr;
+         check(itr->quantity.symbol.code() == sym_code, "No transfer ins found");
+         check(itr->quantity.symbol == value.symbol, "Invalid precision in transferin!");
+         if( itr->quantity.amount <= value.amount ) {
+            value -= itr->quantity;
+            debited.weighted_time += uint128_t(itr->quantity.amount) * itr->time;
+            itr = index.erase(itr);
+            debited.count++;
+         } else {
+            debited.weighted_time += uint128_t(value.amount) * itr->time;
+            index.modify(itr, same_payer, [&](transfer_in& tr) {
+               tr.quantity -= value;
+            });
+            debited.id       = itr->id;
+            debited.quantity = itr->quantity;
+            value.amount     = 0;
+         }
+      }
+      return debited;
    }
 
 };
\ No newline at end of file
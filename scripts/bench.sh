@@ -0,0 +1,47 @@
+#!/bin/bash
+
+UNIT_TEST=${UNIT_TEST:-"build/tests/unit_test"}
+RUNTIMES=${RUNTIMES:-"wabt wavm"}
+SUITES=${SUITES:-"postoken_benchmarks postoken_adversarial"}
+
+print_help() {
+  echo "Usage:    bench.sh [RUNTIME...]"
+  echo "Runs $SUITES under each wasm runtime (default: $RUNTIMES)"
+  echo "and reports the slowest runtime for every scenario, with the share of"
+  echo "max_transaction_cpu_usage left where the suite reports it."
+  echo "Set UNIT_TEST to the path of the unit_test binary (default: $UNIT_TEST)."
+}
+
+if [[ $1 == "-h" || $1 == "--help" ]]; then
+  print_help
+  exit 1
+fi
+
+if [[ $# > 0 ]]; then
+  RUNTIMES="$@"
+fi
+
+for rt in $RUNTIMES; do
+  for suite in $SUITES; do
+    $UNIT_TEST --run_test=$suite -- --$rt | grep '^BENCH '
+  done
+done | tee /dev/stderr | awk '
+{
+  delete f
+  for (i = 2; i <= NF; i++) {
+    split($i, kv, "=")
+    f[kv[1]] = kv[2]
+  }
+  key = f["scenario"] " rows=" f["rows"]
+  if (!(key in worst) || f["billed_us_max"] > worst[key]) {
+    worst[key] = f["billed_us_max"]
+    runtime[key] = f["runtime"]
+    margin[key] = ("margin_pct" in f) ? sprintf("  %d%% left%s%s", f["margin_pct"], ("exceeded" in f) ? ", exceeded" : "",
+                                               ("rows_at_margin" in f) ? ", margin reached at " f["rows_at_margin"] " rows" : "") : ""
+  }
+}
+END {
+  print "\nWorst case billed CPU per scenario:"
+  for (key in worst)
+    printf "%-40s %8d us (%s)%s\n", key, worst[key], runtime[key], margin[key]
+}'
@@ -0,0 +1,42 @@
+#!/bin/bash
+
+BUILD_DIR=${BUILD_DIR:-"build/postoken"}
+BUILDS=${BUILDS:-"postoken postoken_lean"}
+
+print_help() {
+  echo "Usage:    size.sh [BUILD...]"
+  echo "Reports WASM size and floating point instructions of each contract build (default: $BUILDS)."
+  echo "Set BUILD_DIR to the directory of the built contracts (default: $BUILD_DIR)."
+  echo "Deploy RAM and first call latency are reported by the deploy_cost benchmark (scripts/bench.sh)."
+}
+
+if [[ $1 == "-h" || $1 == "--help" ]]; then
+  print_help
+  exit 1
+fi
+
+if [[ $# > 0 ]]; then
+  BUILDS="$@"
+fi
+
+# Text format of a wasm module: cdt's eosio-wasm2wast or wabt's wasm2wat
+if command -v eosio-wasm2wast > /dev/null; then
+  WASM2WAST="eosio-wasm2wast"
+elif command -v wasm2wat > /dev/null; then
+  WASM2WAST="wasm2wat"
+fi
+
+printf "%-16s %10s %10s\n" "build" "bytes" "float ops"
+for build in $BUILDS; do
+  wasm="$BUILD_DIR/$build.wasm"
+  if [[ ! -f $wasm ]]; then
+    echo "$wasm not found" >&2
+    exit 1
+  fi
+  bytes=$(stat -c %s "$wasm")
+  floats="-"
+  if [[ -n $WASM2WAST ]]; then
+    floats=$($WASM2WAST "$wasm" -o /dev/stdout 2> /dev/null | grep -cE '\bf(32|64)\.')
+  fi
+  printf "%-16s %10d %10s\n" "$build" "$bytes" "$floats"
+done
@@ -1,5 +1,4 @@
 #include <postoken.hpp>
-#include <cmath>
 
 void postoken::create( name   issuer,
                        asset  maximum_supply )
@@ -21,6 +20,13 @@ void postoken::create( name   issuer,
        s.issuer        = issuer;
        s.min_coin_age = s.max_coin_age = s.stake_start_time = 0;
     });
+
+    aggregates aggtable( _self, sym.code().raw() );
+    aggtable.emplace( _self, [&]( auto& a ) {
+       a.total_balance = asset(0, sym);
+       a.weighted_time = 0;
+       a.holders       = 0;
+    });
 }
 
 
@@ -40,13 +46,15 @@ void postoken::issue( name to, asset quantity, string memo )
     check( quantity.amount > 0, "must issue positive quantity" );
 
     check( quantity.symbol == st.supply.symbol, "symbol precision mismatch" );
-    check( quantity.amount <= st.max_supply.amount - st.supply.amount, "quantity exceeds available supply");
+    check( quantity.amount <= st.max_supply.amount - st.supply.amount - st.get_reserved(),
+           "quantity exceeds available supply");
 
     statstable.modify( st, same_payer, [&]( auto& s ) {
        s.supply += quantity;
     });
 
-    add_balance( st.issuer, quantity, st.issuer );
+    uint64_t tr_id = add_balance( st.issuer, quantity, st.issuer, st.get_options() );
+    send_event( issue_event, st.issuer, quantity, 0, tr_id, quantity );
 
     if( to != st.issuer ) {
       SEND_INLINE_ACTION( *this, transfer, { {st.issuer, "active"_n} },
@@ -76,7 +84,8 @@ void postoken::retire( asset quantity, string memo )
        s.supply -= quantity;
     });
 
-    sub_balance( st.issuer, quantity, st.issuer );
+    send_event( retire_event, st.issuer, -quantity, 0, 0, asset(0, quantity.symbol) );
+    sub_balance( st.issuer, quantity, st.issuer, st.get_options() );
 }
 
 void postoken::transfer( name    from,
@@ -101,8 +110,48 @@ void postoken::transfer( name    from,
 
     auto payer = has_auth( to ) ? to : from;
 
-    sub_balance( from, quantity, from );
-    add_balance( to, quantity, payer );
+    sub_balance( from, quantity, from, st.get_options() );
+    add_balance( to, quantity, payer, st.get_options() );
+}
+
+void postoken::xfer( name from, name to, int64_t amount )
+{
+    check( from != to, "cannot transfer to self" );
+    require_auth( from );
+    // Default token's symbol and options are kept in config, so its stat row isn't read
+    configs cfgtable( _self, _self.value );
+    const auto& cfg = cfgtable.get( 0, "default symbol is not set" );
+
+    // Notifying a non-existing account fails, no need for is_account( to )
+    require_recipient( from );
+    require_recipient( to );
+
+    check( amount > 0, "must transfer positive quantity" );
+    asset quantity( amount, cfg.default_symbol );
+
+    auto payer = has_auth( to ) ? to : from;
+
+    sub_balance( from, quantity, from, cfg.options );
+    add_balance( to, quantity, payer, cfg.options );
+}
+
+void postoken::setdefsym( const symbol_code& sym_code )
+{
+    require_auth( _self );
+    stats statstable( _self, sym_code.raw() );
+    const auto& st = statstable.get( sym_code.raw(), "Token with this symbol does not exist" );
+
+    configs cfgtable( _self, _self.value );
+    auto it = cfgtable.find( 0 );
+    auto set = [&]( auto& c ) {
+       c.default_symbol = st.supply.symbol;
+       c.options        = st.get_options();
+    };
+    if( it == cfgtable.end() ) {
+       cfgtable.emplace( _self, set );
+    } else {
+       cfgtable.modify( it, same_payer, set );
+    }
 }
 
 void postoken::mint(const name& account, const symbol_code& sym_code) {
@@ -118,48 +167,225 @@ void postoken::mint(const name& account, const symbol_code& sym_code) {
    asset interest_rate = get_interest_rate(st, curr_time);
    check(interest_rate.amount > 0, "Nothing to claim: 0 interest rate");
 
+   // Balance with a sub-ledger earns per sub-account
+   sub_ledgers ledgers(_self, account.value);
+   check(ledgers.find(sym_code.raw()) == ledgers.end(), "Balance has a sub-ledger, use submint");
+
+   // Oldest transfer in decides whether anything is claimable, no need to visit the rest
+   accounts acnts(_self, account.value);
+   auto acc = acnts.find(sym_code.raw());
+   check(acc != acnts.end() && can_claim(st, *acc, curr_time), "Nothing to claim");
+
    // Determine coin age
    transfer_ins tr_table(_self, account.value);
    auto index = tr_table.get_index<"symbol"_n>();
 
-   auto itr = index.require_find(sym_code.raw(), "Nothing to claim");
+   auto first = index.require_find(sym_code.raw(), "Nothing to claim");
    asset coin_age(0, sym);
    asset balance(0, sym);
-   for ( ; itr != index.end() && itr->quantity.symbol == sym; itr++ ) {
-      uint32_t start_time = std::max(st.stake_start_time, itr->time);
-      uint32_t age = epoch_to_days(curr_time - start_time);
-      balance += itr->quantity;
-      if( age >= st.min_coin_age ) {
-         age = std::min(static_cast<uint32_t>(st.max_coin_age), age);
-         coin_age += itr->quantity * age;
-      }
-   }
+   for ( auto itr = first; itr != index.end() && itr->quantity.symbol == sym; itr++ )
+      add_coin_age(st, *itr, curr_time, balance, coin_age);
 
    // Calculate resulting reward
-   asset m = asset(static_cast<uint64_t>(std::pow(10, coin_age.symbol.precision())), sym);
-   asset reward = (coin_age.amount * interest_rate) / (365 * m).amount;
-
+   asset reward = get_reward(coin_age, interest_rate);
    check(reward.amount > 0, "Nothing to claim");
 
    // Issue new tokens
-   asset rem = st.max_supply - st.supply;
-   check(rem.amount > 0, "Max supply reached");
-   if( rem < reward )
-      reward = rem;
+   reward = claim_reward(account, statstable, st, acnts, *acc, tr_table, index, first, balance, reward);
+   check(reward.amount > 0, "Max supply reached");
+}
 
-   statstable.modify(st, same_payer, [&](currency_stats& st) {
-      st.supply += reward;
-   });
+void postoken::mintall(const name& account) {
+   require_auth(account);
+   auto curr_time = now();
+
+   // Symbol index groups the transfer ins by token, each group is visited once
+   accounts acnts(_self, account.value);
+   sub_ledgers ledgers(_self, account.value);
+   transfer_ins tr_table(_self, account.value);
+   auto index = tr_table.get_index<"symbol"_n>();
+   auto itr = index.begin();
+   uint32_t claimed = 0;
+   while( itr != index.end() ) {
+      symbol_code sym_code = itr->quantity.symbol.code();
+      stats statstable( _self, sym_code.raw() );
+      const auto& st = statstable.get( sym_code.raw() );
+      symbol sym = st.max_supply.symbol;
+
+      // Tokens with nothing to claim are skipped, like mint would fail for them
+      asset interest_rate(0, sym);
+      if( st.stake_start_time < curr_time )
+         interest_rate = get_interest_rate(st, curr_time);
+      auto acc = acnts.end();
+      if( interest_rate.amount > 0 ) {
+         acc = acnts.find(sym_code.raw());
+      }
+      bool has_ledger = false;
+      if( acc != acnts.end() ) {
+         has_ledger = ledgers.find(sym_code.raw()) != ledgers.end();
+      }
+      if( acc == acnts.end() || has_ledger || !can_claim(st, *acc, curr_time) ) {
+         itr = index.lower_bound(sym_code.raw() + 1);
+         continue;
+      }
+
+      auto first = itr;
+      asset coin_age(0, sym);
+      asset balance(0, sym);
+      for( ; itr != index.end() && itr->quantity.symbol.code() == sym_code; itr++ ) {
+         check(itr->quantity.symbol == sym, "Invalid precision in transferin!");
+         add_coin_age(st, *itr, curr_time, balance, coin_age);
+      }
+
+      asset reward = get_reward(coin_age, interest_rate);
+      if( reward.amount <= 0 )
+         continue;
+
+      // itr (first transfer in of the next token) stays valid, only this token's rows are replaced
+      reward = claim_reward(account, statstable, st, acnts, *acc, tr_table, index, first, balance, reward);
+      if( reward.amount > 0 )
+         claimed++;
+   }
+   check(claimed > 0, "Nothing to claim");
+}
+
+bool postoken::can_claim(const currency_stats& st, const account& acc, timestamp_t curr_time) {
+   if( !acc.first_in.has_value() )
+      return true;
+   uint32_t max_age = epoch_to_days(curr_time - std::max(st.stake_start_time, acc.first_in.value()));
+   return max_age > 0 && max_age >= st.min_coin_age;
+}
+
+void postoken::add_coin_age(const currency_stats& st, const transfer_in& tr, timestamp_t curr_time,
+                            asset& balance, asset& coin_age) {
+   uint32_t start_time = std::max(st.stake_start_time, tr.time);
+   uint32_t age = epoch_to_days(curr_time - start_time);
+   balance += tr.quantity;
+   if( age >= st.min_coin_age ) {
+      age = std::min(static_cast<uint32_t>(st.max_coin_age), age);
+      coin_age += tr.quantity * age;
+   }
+}
+
+asset postoken::get_reward(asset coin_age, asset interest_rate) {
+   // One token (10^precision units) in integers, so that the contract needs no floating point or libm
+   asset m = asset(1, coin_age.symbol);
+   for( uint8_t i = 0; i < coin_age.symbol.precision(); i++ )
+      m *= 10;
+   return (coin_age.amount * interest_rate) / (365 * m).amount;
+}
+
+asset postoken::issue_reward(stats& statstable, const currency_stats& st, name account, asset reward) {
+   // With deferred_supply_option the reward comes from account's shard as far as its budget goes,
+   // the stat row is only written for the rest. Settle adds pending rewards to supply later.
+   asset from_pool(0, reward.symbol);
+   if( st.has_option(deferred_supply_option) ) {
+      reward_pool pool( _self, reward.symbol.code().raw() );
+      const auto& shard = pool.get( account.value % st.pool.value().shards, "Reward pool is not set" );
+      from_pool.amount = std::min(reward.amount, shard.budget.amount);
+      if( from_pool.amount > 0 ) {
+         pool.modify(shard, same_payer, [&](auto& s) {
+            s.budget  -= from_pool;
+            s.pending += from_pool;
+         });
+      }
+   }
+
+   asset rest = reward - from_pool;
+   rest.amount = std::max<int64_t>(0, std::min(rest.amount, st.max_supply.amount - st.supply.amount - st.get_reserved()));
+   if( rest.amount > 0 ) {
+      statstable.modify(st, same_payer, [&](currency_stats& st) {
+         st.supply += rest;
+      });
+   }
+   return from_pool + rest;
+}
+
+template<typename Index>
+asset postoken::claim_reward(name account, stats& statstable, const currency_stats& st, accounts& acnts,
+                             const postoken::account& acc, transfer_ins& tr_table, Index& index,
+                             typename Index::const_iterator first, asset balance, asset reward) {
+   auto curr_time = now();
 
-   add_balance(account, reward, account);
+   reward = issue_reward(statstable, st, account, reward);
+   if( reward.amount <= 0 )
+      return reward;
+
+   // Transfer ins are consolidated below, so the new one is the oldest. Written before add_balance,
+   // which reads the row again and keeps first_in of a non-zero balance.
+   acnts.modify(acc, same_payer, [&](auto& a) {
+      a.first_in.emplace(curr_time);
+   });
+   add_balance(account, reward, account, st.get_options());
 
    // Update transferins
-   erase_transferins(index, sym);
+   auto erased = erase_transferins(index, first, balance.symbol);
+   uint64_t tr_id = tr_table.available_primary_key();
    tr_table.emplace(account, [&](transfer_in& tr) {
-      tr.id       = tr_table.available_primary_key();
+      tr.id       = tr_id;
       tr.quantity = balance + reward;
       tr.time     = curr_time;
    });
+   // add_balance already counted the reward
+   update_aggregate(asset(0, balance.symbol), uint128_t((balance + reward).amount) * curr_time,
+                    erased.weighted_time, 0);
+
+   // Transfer in created by add_balance for the reward is not counted as it was erased right away
+   send_event(mint_event, account, reward, erased.count - 1, tr_id, balance + reward);
+   return reward;
+}
+
+void postoken::compact(const name& account, const symbol_code& sym_code, uint32_t max_rows) {
+   stats statstable( _self, sym_code.raw() );
+   const auto& st = statstable.get( sym_code.raw() );
+   auto curr_time = now();
+   symbol sym     = st.max_supply.symbol;
+   check(st.max_coin_age > 0, "Stake spec is not set");
+
+   auto matured = [&](const transfer_in& tr) {
+      uint32_t start_time = std::max(st.stake_start_time, tr.time);
+      return curr_time > start_time && epoch_to_days(curr_time - start_time) >= st.max_coin_age;
+   };
+
+   // Ids of a symbol's transfer ins grow with time, so matured ones come first.
+   // Each one is folded into the next, the newest keeps its row (and payer), RAM of the others is freed.
+   transfer_ins tr_table(_self, account.value);
+   auto index = tr_table.get_index<"symbol"_n>();
+   auto keep = index.lower_bound(sym_code.raw());
+   check(keep != index.end() && keep->quantity.symbol.code() == sym_code && matured(*keep), "Nothing to compact");
+
+   asset folded(0, sym);
+   uint128_t removed_weight = 0;
+   uint32_t erased = 0;
+   auto itr = keep;
+   ++itr;
+   for( ; erased + 1 < max_rows && itr != index.end() && itr->quantity.symbol.code() == sym_code && matured(*itr);
+        erased++ ) {
+      check(keep->quantity.symbol == sym, "Invalid precision in transferin!");
+      folded += keep->quantity;
+      removed_weight += uint128_t(keep->quantity.amount) * keep->time;
+      index.erase(keep);
+      keep = itr++;
+   }
+   check(erased > 0, "Nothing to compact");
+   check(keep->quantity.symbol == sym, "Invalid precision in transferin!");
+
+   index.modify(keep, same_payer, [&](transfer_in& tr) {
+      tr.quantity += folded;
+   });
+   update_aggregate(asset(0, sym), uint128_t(folded.amount) * keep->time, removed_weight, 0);
+
+   send_event(compact_event, account, asset(0, sym), erased, keep->id, keep->quantity);
+}
+
+void postoken::event(const stake_event& ev) {
+   require_auth(_self);
+}
+
+void postoken::send_event(event_type type, name account, asset quantity,
+                          uint32_t erased, uint64_t new_id, asset new_quantity) {
+   stake_event ev{ event_version, type, account, quantity, erased, new_id, new_quantity, now() };
+   event_action(_self, { _self, "active"_n }).send(ev);
 }
 
 asset postoken::get_interest_rate(const currency_stats& stats, uint32_t epoch_time) {
@@ -176,56 +402,164 @@ asset postoken::get_interest_rate(const currency_stats& stats, uint32_t epoch_ti
    return interest_rate;
 }
 
-void postoken::sub_balance( name owner, asset value, name ram_payer ) {
+void postoken::sub_balance( name owner, asset value, name ram_payer, uint32_t options ) {
    accounts from_acnts( _self, owner.value );
 
    auto sym_code = value.symbol.code();
    const auto& from = from_acnts.get( sym_code.raw(), "no balance object found" );
    check( from.balance.amount >= value.amount, "overdrawn balance" );
 
+   // Part of the balance assigned to sub-accounts only leaves through subwithdraw
+   sub_ledgers ledgers( _self, owner.value );
+   auto ledger = ledgers.find( sym_code.raw() );
+   if( ledger != ledgers.end() )
+      check( value.amount <= from.balance.amount - ledger->allocated.amount, "quantity exceeds unallocated balance" );
+
+   bool newest_first = options & newest_first_debit_option;
    from_acnts.modify( from, owner, [&]( auto& a ) {
          a.balance -= value;
+         // Oldest transfer in is only replaced by consolidation
+         if( !newest_first )
+            a.first_in.emplace( now() );
       });
-   
-   // Replace all transfer ins with a new one
-   // Could take up time in case of a lot of transfer ins, but this could be solved easily by claiming first
-   // Transaction exceeding tie limit can be a kind of a warning to the user that there might be a lot of stuff to claim
+
    transfer_ins transfers(_self, owner.value);
    auto index = transfers.get_index<"symbol"_n>();
-   erase_transferins(index, value.symbol);
-
-   if( from.balance.amount > 0 ) {
-      transfers.emplace(ram_payer, [&](transfer_in& tr) {
-         tr.id       = transfers.available_primary_key();
-         tr.quantity = from.balance;
-         tr.time     = now();
-      });
+   if( newest_first ) {
+      auto debited = debit_transferins(index, value);
+      update_aggregate(-value, 0, debited.weighted_time, from.balance.amount == 0 ? -1 : 0);
+      send_event(debit_event, owner, -value, debited.count, debited.id, debited.quantity);
+   } else {
+      // Replace all transfer ins with a new one
+      // Could take up time in case of a lot of transfer ins, but this could be solved easily by claiming first
+      // Transaction exceeding tie limit can be a kind of a warning to the user that there might be a lot of stuff to claim
+      auto erased = erase_transferins(index, value.symbol);
+
+      uint64_t tr_id = 0;
+      if( from.balance.amount > 0 ) {
+         tr_id = transfers.available_primary_key();
+         transfers.emplace(ram_payer, [&](transfer_in& tr) {
+            tr.id       = tr_id;
+            tr.quantity = from.balance;
+            tr.time     = now();
+         });
+      }
+      update_aggregate(-value, uint128_t(from.balance.amount) * now(), erased.weighted_time,
+                       from.balance.amount == 0 ? -1 : 0);
+      send_event(consolidate_event, owner, -value, erased.count, tr_id, from.balance);
    }
+   if( options & holder_registry_option )
+      update_holder(owner, from.balance, ram_payer);
+   if( options & balance_checkpoints_option )
+      update_checkpoint(owner, from.balance, ram_payer);
 }
 
-void postoken::add_balance( name owner, asset value, name ram_payer )
+uint64_t postoken::add_balance( name owner, asset value, name ram_payer, uint32_t options )
 {
    accounts to_acnts( _self, owner.value );
    auto to = to_acnts.find( value.symbol.code().raw() );
+   bool new_holder = to == to_acnts.end() || to->balance.amount == 0;
+   asset balance = value;
    if( to == to_acnts.end() ) {
       to_acnts.emplace( ram_payer, [&]( auto& a ){
         a.balance = value;
+        a.first_in.emplace( now() );
       });
    } else {
       to_acnts.modify( to, same_payer, [&]( auto& a ) {
         a.balance += value;
+        // Otherwise older transfer ins remain
+        if( new_holder )
+           a.first_in.emplace( now() );
       });
+      balance = to->balance;
    }
 
    transfer_ins transfers(_self, owner.value);
+   uint64_t tr_id = transfers.available_primary_key();
    transfers.emplace(ram_payer, [&](transfer_in& tr) {
-      tr.id       = transfers.available_primary_key();
+      tr.id       = tr_id;
       tr.quantity = value;
       tr.time     = now();
    });
+   update_aggregate(value, uint128_t(value.amount) * now(), 0, new_holder ? 1 : 0);
+   if( options & holder_registry_option )
+      update_holder(owner, balance, ram_payer);
+   if( options & balance_checkpoints_option )
+      update_checkpoint(owner, balance, ram_payer);
+   return tr_id;
+}
+
+void postoken::update_holder( name owner, asset balance, name ram_payer ) {
+   holders registry( _self, balance.symbol.code().raw() );
+   auto it = registry.find( owner.value );
+   if( it == registry.end() ) {
+      registry.emplace( ram_payer, [&]( auto& h ) {
+         h.owner   = owner;
+         h.balance = balance;
+      });
+   } else {
+      registry.modify( it, same_payer, [&]( auto& h ) {
+         h.balance = balance;
+      });
+   }
+}
+
+void postoken::update_checkpoint( name owner, asset balance, name ram_payer ) {
+   checkpoints cptable( _self, owner.value );
+   auto index = cptable.get_index<"symtime"_n>();
+   uint128_t sym_key = uint128_t(balance.symbol.code().raw()) << 64;
+   timestamp_t curr_time = now();
+
+   // Last checkpoint of this symbol
+   auto it = index.upper_bound( sym_key | std::numeric_limits<uint32_t>::max() );
+   bool found = it != index.begin() && (--it)->balance.symbol.code() == balance.symbol.code();
+
+   // A row holds one balance for its whole period, so only a change in the same second can replace it
+   // (the replaced balance was held for no time). Moving an older row forward would leave the period
+   // before the change to the previous row's balance.
+   if( found && it->time == curr_time ) {
+      index.modify( it, same_payer, [&]( auto& cp ) {
+         cp.balance = balance;
+      });
+   } else {
+      uint128_t cumulative = found ? it->cumulative_at( curr_time ) : 0;
+      uint64_t id = cptable.available_primary_key();
+      cptable.emplace( ram_payer, [&]( auto& cp ) {
+         cp.id         = id;
+         cp.balance    = balance;
+         cp.time       = curr_time;
+         cp.cumulative = cumulative;
+      });
+   }
+}
+
+void postoken::update_aggregate(asset balance_delta, uint128_t added_weight, uint128_t removed_weight,
+                                int32_t holders_delta) {
+   auto sym_code_raw = balance_delta.symbol.code().raw();
+   aggregates aggtable( _self, sym_code_raw );
+   auto it = aggtable.find( sym_code_raw );
+   if( it == aggtable.end() )
+      return;
+
+   aggtable.modify( it, same_payer, [&]( auto& a ) {
+      a.total_balance += balance_delta;
+      a.weighted_time  = a.weighted_time + added_weight - removed_weight;
+      a.holders       += holders_delta;
+   });
 }
 
 void postoken::open( name owner, const symbol& symbol, name ram_payer )
+{
+   openmany( { owner }, symbol, ram_payer );
+}
+
+void postoken::close( name owner, const symbol& symbol )
+{
+   closemany( { owner }, symbol );
+}
+
+void postoken::openmany( const std::vector<name>& owners, const symbol& symbol, name ram_payer )
 {
    require_auth( ram_payer );
 
@@ -235,23 +569,379 @@ void postoken::open( name owner, const symbol& symbol, name ram_payer )
    const auto& st = statstable.get( sym_code_raw, "symbol does not exist" );
    check( st.supply.symbol == symbol, "symbol precision mismatch" );
 
+   for( name owner : owners ) {
+      accounts acnts( _self, owner.value );
+      auto it = acnts.find( sym_code_raw );
+      if( it == acnts.end() ) {
+         acnts.emplace( ram_payer, [&]( auto& a ){
+           a.balance = asset{0, symbol};
+         });
+      }
+   }
+}
+
+void postoken::closemany( const std::vector<name>& owners, const symbol& symbol )
+{
+   // One stat lookup per action instead of a registry lookup per owner for tokens without the registry
+   stats statstable( _self, symbol.code().raw() );
+   auto st = statstable.find( symbol.code().raw() );
+   bool registry_enabled = st != statstable.end() && st->has_option(holder_registry_option);
+   holders registry( _self, symbol.code().raw() );
+   for( name owner : owners ) {
+      require_auth( owner );
+      accounts acnts( _self, owner.value );
+      auto it = acnts.find( symbol.code().raw() );
+      check( it != acnts.end(), "Balance row already deleted or never existed. Action won't have any effect." );
+      check( it->balance.amount == 0, "Cannot close because the balance is not zero." );
+      acnts.erase( it );
+
+      if( registry_enabled ) {
+         auto reg_it = registry.find( owner.value );
+         if( reg_it != registry.end() ) {
+            registry.erase( reg_it );
+         }
+      }
+   }
+}
+
+void postoken::setoptions(const symbol_code& sym_code, uint32_t options) {
+   stats statstable( _self, sym_code.raw() );
+   const auto& st = statstable.get( sym_code.raw(), "Token with this symbol does not exist" );
+   require_auth( st.issuer );
+   check( (options & ~known_options) == 0, "unknown option" );
+   if( options & deferred_supply_option )
+      check( st.pool.has_value(), "Reward pool is not set" );
+   else
+      check( st.get_reserved() == 0, "Reward pool has reserved supply, release it first" );
+
+   statstable.modify( st, same_payer, [&]( auto& s ) {
+      s.options.emplace(options);
+   });
+
+   // Keep xfer's copy up to date
+   configs cfgtable( _self, _self.value );
+   auto cfg = cfgtable.find( 0 );
+   if( cfg != cfgtable.end() && cfg->default_symbol.code() == sym_code ) {
+      cfgtable.modify( cfg, same_payer, [&]( auto& c ) {
+         c.options = options;
+      });
+   }
+}
+
+void postoken::regholder(name owner, const symbol_code& sym_code, name ram_payer) {
+   require_auth( ram_payer );
+   stats statstable( _self, sym_code.raw() );
+   const auto& st = statstable.get( sym_code.raw(), "Token with this symbol does not exist" );
+   check( st.has_option(holder_registry_option), "Holder registry is not enabled for this token" );
+
    accounts acnts( _self, owner.value );
-   auto it = acnts.find( sym_code_raw );
-   if( it == acnts.end() ) {
-      acnts.emplace( ram_payer, [&]( auto& a ){
-        a.balance = asset{0, symbol};
+   const auto& acc = acnts.get( sym_code.raw(), "no balance object found" );
+   update_holder( owner, acc.balance, ram_payer );
+}
+
+void postoken::initagg(const symbol_code& sym_code, const std::vector<name>& owners) {
+   stats statstable( _self, sym_code.raw() );
+   const auto& st = statstable.get( sym_code.raw(), "Token with this symbol does not exist" );
+   require_auth( st.issuer );
+   aggregates aggtable( _self, sym_code.raw() );
+   check( aggtable.find( sym_code.raw() ) == aggtable.end(), "Aggregates row already exists" );
+
+   symbol sym = st.max_supply.symbol;
+   asset total(0, sym);
+   uint128_t weighted_time = 0;
+   uint64_t holders = 0;
+   // Balances are short of supply by unsettled sub-ledger rewards and ahead of it by pool rewards settle
+   // hasn't added yet
+   int64_t expected = st.supply.amount;
+   for( size_t i = 0; i < owners.size(); i++ ) {
+      check( i == 0 || owners[i - 1] < owners[i], "owners have to be sorted and unique" );
+      accounts acnts( _self, owners[i].value );
+      const auto& acc = acnts.get( sym_code.raw(), "no balance object found" );
+
+      transfer_ins transfers( _self, owners[i].value );
+      auto index = transfers.get_index<"symbol"_n>();
+      asset received(0, sym);
+      for( auto itr = index.find( sym_code.raw() ); itr != index.end() && itr->quantity.symbol == sym; itr++ ) {
+         received      += itr->quantity;
+         weighted_time += uint128_t(itr->quantity.amount) * itr->time;
+      }
+      check( received == acc.balance, "transfer ins don't add up to the balance" );
+      total   += acc.balance;
+      holders += acc.balance.amount > 0 ? 1 : 0;
+
+      sub_ledgers ledgers( _self, owners[i].value );
+      auto ledger = ledgers.find( sym_code.raw() );
+      if( ledger != ledgers.end() )
+         expected -= ledger->unsettled.amount;
+   }
+   if( st.has_option(deferred_supply_option) ) {
+      reward_pool pool( _self, sym_code.raw() );
+      for( const auto& shard : pool )
+         expected += shard.pending.amount;
+   }
+   check( total.amount == expected, "balances of owners don't add up to supply" );
+
+   aggtable.emplace( _self, [&]( auto& a ) {
+      a.total_balance = total;
+      a.weighted_time = weighted_time;
+      a.holders       = holders;
+   });
+}
+
+void postoken::setrewardpool(const symbol_code& sym_code, uint16_t shards, const asset& shard_budget) {
+   stats statstable( _self, sym_code.raw() );
+   const auto& st = statstable.get( sym_code.raw(), "Token with this symbol does not exist" );
+   require_auth( st.issuer );
+   check( shard_budget.symbol == st.max_supply.symbol, "symbol precision mismatch" );
+   check( shard_budget.is_valid() && shard_budget.amount >= 0, "invalid shard budget" );
+   check( shards > 0 && shards <= max_pool_shards, "invalid number of shards" );
+
+   reward_pool_spec spec = st.pool.has_value() ? st.pool.value() : reward_pool_spec{ 0, 0, 0 };
+   if( spec.shards != shards ) {
+      // Rows hold no budget or pending rewards at this point
+      check( spec.reserved == 0, "Reward pool has reserved supply, release it first" );
+      reward_pool pool( _self, sym_code.raw() );
+      for( uint16_t i = shards; i < spec.shards; i++ ) {
+         pool.erase( pool.get(i) );
+      }
+      for( uint16_t i = spec.shards; i < shards; i++ ) {
+         pool.emplace( st.issuer, [&]( auto& s ) {
+            s.shard   = i;
+            s.budget  = asset(0, st.max_supply.symbol);
+            s.pending = asset(0, st.max_supply.symbol);
+         });
+      }
+      spec.shards = shards;
+   }
+   spec.shard_budget = shard_budget.amount;
+
+   statstable.modify( st, same_payer, [&]( auto& s ) {
+      // Binary extensions are serialized in order, options has to be there before pool
+      if( !s.options.has_value() )
+         s.options.emplace(0);
+      s.pool.emplace(spec);
+   });
+}
+
+void postoken::settle(const symbol_code& sym_code) {
+   stats statstable( _self, sym_code.raw() );
+   const auto& st = statstable.get( sym_code.raw(), "Token with this symbol does not exist" );
+   check( st.has_option(deferred_supply_option), "Deferred supply is not enabled for this token" );
+
+   reward_pool_spec spec = st.pool.value();
+   int64_t supply = st.supply.amount;
+   reward_pool pool( _self, sym_code.raw() );
+   for( auto it = pool.begin(); it != pool.end(); ++it ) {
+      // Minted rewards go to supply, then the budget is topped up to shard_budget (or released
+      // above it) from what max_supply has left
+      int64_t pending = it->pending.amount;
+      supply        += pending;
+      spec.reserved -= pending;
+      int64_t budget = std::min(spec.shard_budget, it->budget.amount + (st.max_supply.amount - supply - spec.reserved));
+      spec.reserved += budget - it->budget.amount;
+      if( pending != 0 || budget != it->budget.amount ) {
+         pool.modify( it, same_payer, [&]( auto& s ) {
+            s.budget.amount  = budget;
+            s.pending.amount = 0;
+         });
+      }
+   }
+
+   statstable.modify( st, same_payer, [&]( auto& s ) {
+      s.supply.amount = supply;
+      s.pool.emplace(spec);
+   });
+}
+
+void postoken::subdeposit( name custodian, uint64_t sub, const asset& quantity ) {
+   require_auth( custodian );
+   check( quantity.is_valid(), "invalid quantity" );
+   check( quantity.amount > 0, "must deposit positive quantity" );
+   auto sym_code_raw = quantity.symbol.code().raw();
+
+   accounts acnts( _self, custodian.value );
+   const auto& acc = acnts.get( sym_code_raw, "no balance object found" );
+   check( acc.balance.symbol == quantity.symbol, "symbol precision mismatch" );
+
+   sub_ledgers ledgers( _self, custodian.value );
+   auto ledger = ledgers.find( sym_code_raw );
+   int64_t allocated = ledger == ledgers.end() ? 0 : ledger->allocated.amount;
+   check( quantity.amount <= acc.balance.amount - allocated, "quantity exceeds unallocated balance" );
+   if( ledger == ledgers.end() ) {
+      ledgers.emplace( custodian, [&]( auto& l ) {
+         l.allocated = quantity;
+         l.unsettled = asset(0, quantity.symbol);
+      });
+      // From now on the balance earns through its sub-accounts only
+      restart_coin_age( custodian, acc.balance );
+   } else {
+      ledgers.modify( ledger, same_payer, [&]( auto& l ) {
+         l.allocated += quantity;
       });
    }
+
+   sub_accounts subs( _self, custodian.value );
+   credit_sub_account( subs, custodian, sub, quantity );
 }
 
-void postoken::close( name owner, const symbol& symbol )
-{
-   require_auth( owner );
+void postoken::subwithdraw( name custodian, uint64_t sub, const asset& quantity ) {
+   require_auth( custodian );
+   check( quantity.is_valid(), "invalid quantity" );
+   check( quantity.amount > 0, "must withdraw positive quantity" );
+
+   sub_ledgers ledgers( _self, custodian.value );
+   const auto& ledger = ledgers.get( quantity.symbol.code().raw(), "no sub-ledger found" );
+   // Rewards have to reach the custodian's balance before they can leave the sub-ledger
+   check( quantity.amount <= ledger.allocated.amount, "quantity exceeds allocated balance, subsettle first" );
+
+   sub_accounts subs( _self, custodian.value );
+   debit_sub_account( subs, sub, quantity );
+
+   if( ledger.allocated == quantity && ledger.unsettled.amount == 0 ) {
+      // No sub-account is left, the balance earns by itself again, from now on: sub-accounts were paid
+      // for the time before
+      ledgers.erase( ledger );
+      accounts acnts( _self, custodian.value );
+      restart_coin_age( custodian, acnts.get( quantity.symbol.code().raw(), "no balance object found" ).balance );
+   } else {
+      ledgers.modify( ledger, same_payer, [&]( auto& l ) {
+         l.allocated -= quantity;
+      });
+   }
+}
+
+void postoken::submove( name custodian, uint64_t from, uint64_t to, const asset& quantity ) {
+   check( from != to, "cannot move to self" );
+   require_auth( custodian );
+   check( quantity.is_valid(), "invalid quantity" );
+   check( quantity.amount > 0, "must move positive quantity" );
+
+   // Sum of the sub-accounts doesn't change, neither does the sub-ledger row
+   sub_accounts subs( _self, custodian.value );
+   debit_sub_account( subs, from, quantity );
+   credit_sub_account( subs, custodian, to, quantity );
+}
+
+void postoken::submint( name custodian, const std::vector<uint64_t>& subs ) {
+   require_auth( custodian );
+   auto curr_time = now();
+
+   sub_accounts subtable( _self, custodian.value );
+   sub_ledgers ledgers( _self, custodian.value );
+   uint32_t claimed = 0;
+   for( uint64_t id : subs ) {
+      const auto& sub = subtable.get( id, "no sub-account found" );
+      symbol sym = sub.balance.symbol;
+      stats statstable( _self, sym.code().raw() );
+      const auto& st = statstable.get( sym.code().raw() );
+
+      // mint's rules for a balance with a single transfer in, skipped where mint would fail
+      if( st.stake_start_time >= curr_time )
+         continue;
+      asset interest_rate = get_interest_rate(st, curr_time);
+      asset coin_age(0, sym);
+      asset balance(0, sym);
+      add_coin_age(st, transfer_in{ id, sub.balance, sub.time }, curr_time, balance, coin_age);
+      asset reward = get_reward(coin_age, interest_rate);
+      if( reward.amount <= 0 )
+         continue;
+      reward = issue_reward(statstable, st, custodian, reward);
+      if( reward.amount <= 0 )
+         continue;
+
+      subtable.modify( sub, same_payer, [&]( auto& s ) {
+         s.balance += reward;
+         s.time     = curr_time;
+      });
+      const auto& ledger = ledgers.get( sym.code().raw(), "no sub-ledger found" );
+      ledgers.modify( ledger, same_payer, [&]( auto& l ) {
+         l.unsettled += reward;
+      });
+
+      send_event(submint_event, custodian, reward, 0, id, sub.balance);
+      claimed++;
+   }
+   check( claimed > 0, "Nothing to claim" );
+}
+
+void postoken::subsettle( name custodian, const symbol_code& sym_code ) {
+   require_auth( custodian );
+   stats statstable( _self, sym_code.raw() );
+   const auto& st = statstable.get( sym_code.raw(), "Token with this symbol does not exist" );
+
+   sub_ledgers ledgers( _self, custodian.value );
+   const auto& ledger = ledgers.get( sym_code.raw(), "no sub-ledger found" );
+   asset settled = ledger.unsettled;
+   check( settled.amount > 0, "Nothing to settle" );
+   ledgers.modify( ledger, same_payer, [&]( auto& l ) {
+      l.allocated += settled;
+      l.unsettled.amount = 0;
+   });
+
+   // Supply already has the rewards, only the balance is added
+   uint64_t tr_id = add_balance( custodian, settled, custodian, st.get_options() );
+   send_event( subsettle_event, custodian, settled, 0, tr_id, settled );
+}
+
+void postoken::restart_coin_age( name owner, asset balance ) {
+   auto curr_time = now();
+   symbol sym = balance.symbol;
    accounts acnts( _self, owner.value );
-   auto it = acnts.find( symbol.code().raw() );
-   check( it != acnts.end(), "Balance row already deleted or never existed. Action won't have any effect." );
-   check( it->balance.amount == 0, "Cannot close because the balance is not zero." );
-   acnts.erase( it );
+   const auto& acc = acnts.get( sym.code().raw(), "no balance object found" );
+   acnts.modify( acc, same_payer, [&]( auto& a ) {
+      a.first_in.emplace( curr_time );
+   });
+
+   transfer_ins transfers( _self, owner.value );
+   auto index = transfers.get_index<"symbol"_n>();
+   auto first = index.find( sym.code().raw() );
+   erased_transferins erased;
+   if( first != index.end() )
+      erased = erase_transferins( index, first, sym );
+
+   uint64_t tr_id = 0;
+   if( balance.amount > 0 ) {
+      tr_id = transfers.available_primary_key();
+      transfers.emplace( owner, [&]( transfer_in& tr ) {
+         tr.id       = tr_id;
+         tr.quantity = balance;
+         tr.time     = curr_time;
+      });
+   }
+   update_aggregate( asset(0, sym), uint128_t(balance.amount) * curr_time, erased.weighted_time, 0 );
+   send_event( consolidate_event, owner, asset(0, sym), erased.count, tr_id, balance );
+}
+
+void postoken::credit_sub_account( sub_accounts& subs, name custodian, uint64_t sub, asset quantity ) {
+   auto it = subs.find( sub );
+   timestamp_t curr_time = now();
+   if( it == subs.end() ) {
+      subs.emplace( custodian, [&]( auto& s ) {
+         s.id      = sub;
+         s.balance = quantity;
+         s.time    = curr_time;
+      });
+   } else {
+      check( it->balance.symbol == quantity.symbol, "sub-account holds another token" );
+      subs.modify( it, same_payer, [&]( auto& s ) {
+         s.time = timestamp_t( (uint128_t(s.balance.amount) * s.time + uint128_t(quantity.amount) * curr_time) /
+                               uint64_t(s.balance.amount + quantity.amount) );
+         s.balance += quantity;
+      });
+   }
+}
+
+void postoken::debit_sub_account( sub_accounts& subs, uint64_t sub, asset quantity ) {
+   const auto& s = subs.get( sub, "no sub-account found" );
+   check( s.balance.symbol == quantity.symbol, "symbol precision mismatch" );
+   check( s.balance.amount >= quantity.amount, "overdrawn sub-account" );
+   if( s.balance == quantity ) {
+      subs.erase( s );
+   } else {
+      subs.modify( s, same_payer, [&]( auto& r ) {
+         r.balance -= quantity;
+      });
+   }
 }
 
 void postoken::setstakespec(const timestamp_t stake_start_time, 
@@ -284,4 +974,12 @@ void postoken::setstakespec(const timestamp_t stake_start_time,
       st.max_coin_age     = max_coin_age;
       st.anual_interests  = anual_interests;
    });
-}
\ No newline at end of file
+}
+
+#ifdef POSTOKEN_DB_STATS
+postoken::~postoken() {
+   const auto& c = postoken_db_stats::get_counters();
+   print("DBSTATS find=", c.find, " emplace=", c.emplace, " modify=", c.modify, " erase=", c.erase,
+         " next=", c.next, "\n");
+}
+#endif
@@ -49,6 +49,49 @@ public:
       return (table == nullptr) ? 0 : table->count;
    }
 
+   // Decodes rows of a table straight from chainbase into native (FC_REFLECTed) structs,
+   // bypassing abi_serializer and fc::variant. f is called with (primary_key, row).
+   template<typename Row, typename F>
+   void for_each_row(uint64_t scope, account_name table_name, F&& f) {
+      const table_id_object* table = ctester.find_table(_contract_name, scope, table_name);
+      if( table == nullptr )
+         return;
+      const auto& idx = ctester.control->db().get_index<key_value_index, by_scope_primary>();
+      Row row;
+      for( auto itr = idx.lower_bound(boost::make_tuple(table->id));
+           itr != idx.end() && itr->t_id == table->id; ++itr ) {
+         fc::datastream<const char*> ds(itr->value.data(), itr->value.size());
+         fc::raw::unpack(ds, row);
+         f(itr->primary_key, row);
+      }
+   }
+
+   // Walks the first uint64_t secondary index of a table in key order, f is called with
+   // (primary_key, secondary_key) and stops the walk by returning false
+   template<typename F>
+   void for_each_secondary64(uint64_t scope, account_name table_name, F&& f) {
+      const table_id_object* table = ctester.find_table(_contract_name, scope, table_name);
+      if( table == nullptr )
+         return;
+      const auto& idx = ctester.control->db().get_index<index64_index, by_secondary>();
+      for( auto itr = idx.lower_bound(boost::make_tuple(table->id));
+           itr != idx.end() && itr->t_id == table->id; ++itr ) {
+         if( !f(itr->primary_key, itr->secondary_key) )
+            break;
+      }
+   }
+
+   // Calls f(scope) for every scope of this contract which has a table_name table
+   template<typename F>
+   void for_each_scope(account_name table_name, F&& f) {
+      const auto& idx = ctester.control->db().get_index<table_id_multi_index, by_code_scope_table>();
+      for( auto itr = idx.lower_bound(boost::make_tuple(_contract_name));
+           itr != idx.end() && itr->code == _contract_name; ++itr ) {
+         if( itr->table == table_name )
+            f(itr->scope);
+      }
+   }
+
    account_name get_contract_name() {
       return _contract_name;
    }
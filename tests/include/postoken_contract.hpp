@@ -5,6 +5,88 @@
 
 using namespace eosio_testing;
 
+// Native mirrors of postoken table rows, decoded without abi_serializer
+namespace postoken_rows {
+
+struct account {
+   asset balance;
+};
+
+struct transfer_in {
+   uint64_t id;
+   asset    quantity;
+   uint32_t time;
+};
+
+struct interest_t {
+   asset    interest_rate;
+   uint16_t years;
+};
+
+struct currency_stats {
+   asset                   supply;
+   asset                   max_supply;
+   account_name            issuer;
+   uint16_t                min_coin_age;
+   uint16_t                max_coin_age;
+   std::vector<interest_t> anual_interests;
+   uint32_t                stake_start_time;
+};
+
+struct holder {
+   account_name owner;
+   asset        balance;
+};
+
+struct aggregate {
+   asset    total_balance;
+   uint64_t weighted_time_lo; // uint128 weighted_time, little endian
+   uint64_t weighted_time_hi;
+   uint64_t holders;
+
+   unsigned __int128 weighted_time() const {
+      return (unsigned __int128)weighted_time_hi << 64 | weighted_time_lo;
+   }
+};
+
+struct checkpoint {
+   uint64_t id;
+   asset    balance;
+   uint32_t time;
+   uint64_t cumulative_lo; // uint128 cumulative, little endian
+   uint64_t cumulative_hi;
+
+   unsigned __int128 cumulative() const {
+      return (unsigned __int128)cumulative_hi << 64 | cumulative_lo;
+   }
+};
+
+struct sub_account {
+   uint64_t id;
+   asset    balance;
+   uint32_t time;
+};
+
+// Per symbol summary of transfer_ins
+struct transfer_in_summary {
+   size_t   count  = 0;
+   int64_t  total  = 0;
+   uint32_t oldest = std::numeric_limits<uint32_t>::max();
+   uint32_t newest = 0;
+};
+
+}
+
+FC_REFLECT(postoken_rows::account, (balance))
+FC_REFLECT(postoken_rows::transfer_in, (id)(quantity)(time))
+FC_REFLECT(postoken_rows::holder, (owner)(balance))
+FC_REFLECT(postoken_rows::sub_account, (id)(balance)(time))
+FC_REFLECT(postoken_rows::aggregate, (total_balance)(weighted_time_lo)(weighted_time_hi)(holders))
+FC_REFLECT(postoken_rows::checkpoint, (id)(balance)(time)(cumulative_lo)(cumulative_hi))
+FC_REFLECT(postoken_rows::interest_t, (interest_rate)(years))
+FC_REFLECT(postoken_rows::currency_stats, (supply)(max_supply)(issuer)(min_coin_age)(max_coin_age)
+                                          (anual_interests)(stake_start_time))
+
 typedef uint32_t period_t;
 static inline uint32_t to_epoch_time(period_t days) {
    return days * 24 * 60 * 60;
@@ -17,6 +99,11 @@ public:
       : contract(tester, contracts::postoken_wasm, contracts::postoken_abi, acc_name) 
    {}
 
+   postoken_contract(tester& tester, read_wasm_f read_wasm, read_abi_f read_abi,
+                     const account_name& acc_name = N(postoken))
+      : contract(tester, read_wasm, read_abi, acc_name)
+   {}
+
 
    fc::variant get_stats( const string& symbolname )
    {
@@ -36,5 +123,136 @@ public:
       return get_entry(acc, N(transferins), "transfer_in", id);
    }
 
+   fc::variant get_reward_shard( const string& symbolname, uint64_t shard )
+   {
+      auto symb = eosio::chain::symbol::from_string(symbolname);
+      return get_entry(symb.to_symbol_code().value, N(rewardpool), "reward_shard", shard);
+   }
+
+   fc::variant get_sub_ledger( account_name custodian, const string& symbolname )
+   {
+      auto symb = eosio::chain::symbol::from_string(symbolname);
+      return get_entry(custodian, N(subledgers), "sub_ledger", symb.to_symbol_code().value);
+   }
+
+   fc::variant get_sub_account( account_name custodian, uint64_t sub )
+   {
+      return get_entry(custodian, N(subaccounts), "sub_account", sub);
+   }
+
+   // Sub-accounts of custodian by id
+   std::map<uint64_t, postoken_rows::sub_account> get_sub_accounts(account_name custodian) {
+      std::map<uint64_t, postoken_rows::sub_account> rows;
+      for_each_row<postoken_rows::sub_account>(custodian, N(subaccounts), [&](uint64_t pk, const auto& s) {
+         rows[pk] = s;
+      });
+      return rows;
+   }
+
+   // Pushes action and returns `ev` of every event action it sent
+   std::vector<fc::variant> push_action_events(const account_name& signer, const action_name& name,
+                                               const variant_object& data) {
+      auto trace = ctester.push_action(_contract_name, name, signer, data);
+      ctester.produce_block();
+      std::vector<fc::variant> events;
+      std::function<void(const action_trace&)> collect = [&](const action_trace& at) {
+         if( at.receipt.receiver == _contract_name && at.act.name == N(event) ) {
+            auto args = abi_ser.binary_to_variant(abi_ser.get_action_type(N(event)), at.act.data,
+                                                  ctester.abi_serializer_max_time);
+            events.push_back(args["ev"]);
+         }
+         for( const auto& inline_trace : at.inline_traces )
+            collect(inline_trace);
+      };
+      for( const auto& at : trace->action_traces )
+         collect(at);
+      return events;
+   }
+
+   std::vector<postoken_rows::transfer_in> get_transfer_ins(account_name acc) {
+      std::vector<postoken_rows::transfer_in> rows;
+      for_each_row<postoken_rows::transfer_in>(acc, N(transferins), [&](uint64_t, const auto& tr) {
+         rows.push_back(tr);
+      });
+      return rows;
+   }
+
+   // Checkpoints of acc in id (creation) order
+   std::vector<postoken_rows::checkpoint> get_checkpoints(account_name acc) {
+      std::vector<postoken_rows::checkpoint> rows;
+      for_each_row<postoken_rows::checkpoint>(acc, N(checkpoints), [&](uint64_t, const auto& cp) {
+         rows.push_back(cp);
+      });
+      return rows;
+   }
+
+   std::map<symbol, postoken_rows::transfer_in_summary> get_transfer_in_summary(account_name acc) {
+      std::map<symbol, postoken_rows::transfer_in_summary> res;
+      for_each_row<postoken_rows::transfer_in>(acc, N(transferins), [&](uint64_t, const auto& tr) {
+         auto& s = res[tr.quantity.get_symbol()];
+         s.count++;
+         s.total += tr.quantity.get_amount();
+         s.oldest = std::min(s.oldest, tr.time);
+         s.newest = std::max(s.newest, tr.time);
+      });
+      return res;
+   }
+
+   fc::optional<postoken_rows::currency_stats> get_stats_row(const symbol& sym) {
+      fc::optional<postoken_rows::currency_stats> res;
+      uint64_t sym_code = sym.to_symbol_code().value;
+      for_each_row<postoken_rows::currency_stats>(sym_code, N(stat), [&](uint64_t pk, const auto& st) {
+         if( pk == sym_code )
+            res = st;
+      });
+      return res;
+   }
+
+   fc::optional<postoken_rows::aggregate> get_aggregate_row(const symbol& sym) {
+      fc::optional<postoken_rows::aggregate> res;
+      uint64_t sym_code = sym.to_symbol_code().value;
+      for_each_row<postoken_rows::aggregate>(sym_code, N(aggregates), [&](uint64_t pk, const auto& a) {
+         if( pk == sym_code )
+            res = a;
+      });
+      return res;
+   }
+
+   // Top holders from the holder registry, ordered by its balance index (largest first)
+   std::vector<postoken_rows::holder> get_top_holders(const symbol& sym, size_t limit) {
+      uint64_t sym_code = sym.to_symbol_code().value;
+      std::map<uint64_t, postoken_rows::holder> rows;
+      for_each_row<postoken_rows::holder>(sym_code, N(holders), [&](uint64_t pk, const auto& h) {
+         rows[pk] = h;
+      });
+      std::vector<postoken_rows::holder> res;
+      for_each_secondary64(sym_code, N(holders), [&](uint64_t pk, uint64_t) {
+         res.push_back(rows.at(pk));
+         return res.size() < limit;
+      });
+      return res;
+   }
+
+   // Balances of all holders of sym (walks every accounts scope)
+   std::map<account_name, asset> get_balances(const symbol& sym) {
+      std::map<account_name, asset> res;
+      uint64_t sym_code = sym.to_symbol_code().value;
+      for_each_scope(N(accounts), [&](uint64_t scope) {
+         for_each_row<postoken_rows::account>(scope, N(accounts), [&](uint64_t pk, const auto& a) {
+            if( pk == sym_code )
+               res.emplace(account_name(scope), a.balance);
+         });
+      });
+      return res;
+   }
+
+   // Sum of all balances of sym, which should be equal to supply
+   asset get_total_balance(const symbol& sym) {
+      asset total(0, sym);
+      for( const auto& b : get_balances(sym) )
+         total += b.second;
+      return total;
+   }
+
 
 };
@@ -10,18 +10,67 @@
 
 using namespace eosio_testing;
 
+namespace postoken { struct columnar_view; }
+
 class postoken_tester : public tester {
 public:
    static const std::vector<account_name> accounts;
    static const symbol system_symbol;
 
-   postoken_tester();
+   postoken_tester(contract::read_wasm_f read_wasm = contracts::postoken_wasm,
+                   contract::read_abi_f read_abi = contracts::postoken_abi);
+
+   // Writes the stat, accounts and transferins rows of a columnar file (postoken-gen, postoken-extract)
+   // straight into chain state, with the secondary index rows, first_in and aggregates rows the contract
+   // would have. Rows are paid by the contract account. Tokens of the file must not exist yet.
+   void load_state(const std::string& columnar_path);
+   void load_state(const postoken::columnar_view& columns);
 
    postoken_contract postoken_c;
 };
 
 class postoken_issued_tester : public postoken_tester {
 public:
-   postoken_issued_tester();
+   postoken_issued_tester(contract::read_wasm_f read_wasm = contracts::postoken_wasm,
+                          contract::read_abi_f read_abi = contracts::postoken_abi);
 };
 
+
+// Measures CPU of postoken actions under the wasm runtime the tester was started with
+// (select it with `unit_test -- --wabt` / `-- --wavm`).
+class postoken_bench_tester : public postoken_issued_tester {
+public:
+   struct bench_result {
+      uint32_t billed_us;
+      int64_t  elapsed_us;
+      // Summed DBSTATS of all actions in the transaction (only with the postoken_dbstats build)
+      std::map<std::string, uint32_t> db_stats;
+   };
+
+   postoken_bench_tester(contract::read_wasm_f read_wasm = contracts::postoken_wasm,
+                         contract::read_abi_f read_abi = contracts::postoken_abi);
+
+   // Pushes action as signer in its own block and returns the CPU it used. Throws (tx_cpu_usage_exceeded)
+   // when it runs over max_transaction_cpu_usage.
+   bench_result measure(account_name signer, action_name name, const variant_object& data);
+
+   // Creates count transfer_in rows for `to` by transferring quantity from `from` count times
+   void fill_transfer_ins(account_name from, account_name to, const asset& quantity, uint32_t count);
+
+   void set_stake_spec(const symbol& sym, uint32_t start_time, uint16_t min_coin_age, uint16_t max_coin_age,
+                       const std::vector<mutable_variant_object>& interests);
+
+   std::string runtime_name() const;
+
+   // Prints a `BENCH ...` line which scripts/bench.sh collects
+   void report(const std::string& scenario, uint32_t rows, const std::vector<bench_result>& samples) const;
+
+   // Parses "DBSTATS find=3 emplace=2 ..." lines printed by the postoken_dbstats build
+   static void parse_db_stats(const std::string& console, std::map<std::string, uint32_t>& stats);
+};
+
+// Benchmarks against the instrumented contract, which reports multi_index accesses of each action
+class postoken_dbstats_tester : public postoken_bench_tester {
+public:
+   postoken_dbstats_tester();
+};
@@ -64,6 +64,11 @@ public:
       return data.empty() ? fc::variant() : abi_ser.binary_to_variant( "account", data, abi_serializer_max_time );
    }
 
+   // Time of the last block, where actions pushed by push_action run
+   uint32_t last_block_time() const {
+      return control->head_block_time().sec_since_epoch();
+   }
+
    action_result create( account_name issuer,
                 asset        maximum_supply ) {
 
@@ -242,6 +247,7 @@ BOOST_FIXTURE_TEST_CASE( issue_tests, eosio_token_tester ) try {
    auto alice_balance = get_account(N(alice), "3,TKN");
    REQUIRE_MATCHING_OBJECT( alice_balance, mvo()
       ("balance", "500.000 TKN")
+      ("first_in", last_block_time())
    );
 
    BOOST_REQUIRE_EQUAL( wasm_assert_msg( "quantity exceeds available supply" ),
@@ -279,6 +285,7 @@ BOOST_FIXTURE_TEST_CASE( retire_tests, eosio_token_tester ) try {
    auto alice_balance = get_account(N(alice), "3,TKN");
    REQUIRE_MATCHING_OBJECT( alice_balance, mvo()
       ("balance", "500.000 TKN")
+      ("first_in", last_block_time())
    );
 
    BOOST_REQUIRE_EQUAL( success(), retire( N(alice), asset::from_string("200.000 TKN"), "hola" ) );
@@ -294,6 +301,7 @@ BOOST_FIXTURE_TEST_CASE( retire_tests, eosio_token_tester ) try {
    alice_balance = get_account(N(alice), "3,TKN");
    REQUIRE_MATCHING_OBJECT( alice_balance, mvo()
       ("balance", "300.000 TKN")
+      ("first_in", last_block_time())
    );
 
    //should fail to retire more than current supply
@@ -318,6 +326,7 @@ BOOST_FIXTURE_TEST_CASE( retire_tests, eosio_token_tester ) try {
    alice_balance = get_account(N(alice), "3,TKN");
    REQUIRE_MATCHING_OBJECT( alice_balance, mvo()
       ("balance", "0.000 TKN")
+      ("first_in", last_block_time())
    );
 
    //trying to retire tokens with zero supply
@@ -345,6 +354,7 @@ BOOST_FIXTURE_TEST_CASE( transfer_tests, eosio_token_tester ) try {
    auto alice_balance = get_account(N(alice), "0,CERO");
    REQUIRE_MATCHING_OBJECT( alice_balance, mvo()
       ("balance", "1000 CERO")
+      ("first_in", last_block_time())
    );
 
    transfer( N(alice), N(bob), asset::from_string("300 CERO"), "hola" );
@@ -352,6 +362,7 @@ BOOST_FIXTURE_TEST_CASE( transfer_tests, eosio_token_tester ) try {
    alice_balance = get_account(N(alice), "0,CERO");
    REQUIRE_MATCHING_OBJECT( alice_balance, mvo()
       ("balance", "700 CERO")
+      ("first_in", last_block_time())
       ("frozen", 0)
       ("whitelist", 1)
    );
@@ -359,6 +370,7 @@ BOOST_FIXTURE_TEST_CASE( transfer_tests, eosio_token_tester ) try {
    auto bob_balance = get_account(N(bob), "0,CERO");
    REQUIRE_MATCHING_OBJECT( bob_balance, mvo()
       ("balance", "300 CERO")
+      ("first_in", last_block_time())
       ("frozen", 0)
       ("whitelist", 1)
    );
@@ -386,6 +398,7 @@ BOOST_FIXTURE_TEST_CASE( open_tests, eosio_token_tester ) try {
    alice_balance = get_account(N(alice), "0,CERO");
    REQUIRE_MATCHING_OBJECT( alice_balance, mvo()
       ("balance", "1000 CERO")
+      ("first_in", last_block_time())
    );
 
    auto bob_balance = get_account(N(bob), "0,CERO");
@@ -403,6 +416,7 @@ BOOST_FIXTURE_TEST_CASE( open_tests, eosio_token_tester ) try {
    bob_balance = get_account(N(bob), "0,CERO");
    REQUIRE_MATCHING_OBJECT( bob_balance, mvo()
       ("balance", "200 CERO")
+      ("first_in", last_block_time())
    );
 
    BOOST_REQUIRE_EQUAL( wasm_assert_msg( "symbol does not exist" ),
@@ -425,6 +439,7 @@ BOOST_FIXTURE_TEST_CASE( close_tests, eosio_token_tester ) try {
    alice_balance = get_account(N(alice), "0,CERO");
    REQUIRE_MATCHING_OBJECT( alice_balance, mvo()
       ("balance", "1000 CERO")
+      ("first_in", last_block_time())
    );
 
    BOOST_REQUIRE_EQUAL( success(), transfer( N(alice), N(bob), asset::from_string("1000 CERO"), "hola" ) );
@@ -432,6 +447,7 @@ BOOST_FIXTURE_TEST_CASE( close_tests, eosio_token_tester ) try {
    alice_balance = get_account(N(alice), "0,CERO");
    REQUIRE_MATCHING_OBJECT( alice_balance, mvo()
       ("balance", "0 CERO")
+      ("first_in", last_block_time())
    );
 
    BOOST_REQUIRE_EQUAL( success(), close( N(alice), "0,CERO" ) );
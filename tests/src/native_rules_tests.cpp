@@ -0,0 +1,599 @@
+#include <postoken_tester.hpp>
+#include <postoken/client.hpp>
+#include <postoken/ledger.hpp>
+#include <postoken/population.hpp>
+#include <postoken/reward_engine.hpp>
+#include <postoken/snapshot.hpp>
+#include <postoken/state_dump.hpp>
+#include <eosio/chain/snapshot.hpp>
+#include <random>
+
+// Checks that the native rules used by off-chain tools (tools/include/postoken)
+// give exactly the same results as the contract.
+BOOST_AUTO_TEST_SUITE(native_rules_tests)
+
+class native_rules_tester : public postoken_tester {
+public:
+   native_rules_tester() {
+      native.create(uint64_t(postoken_c.get_contract_name()), postoken::string_to_asset("1000000.0000 TOK"));
+   }
+
+   // Pushes action to the chain and applies it to the native ledger, both have to give the same result
+   void push(account_name signer, action_name name, const variant_object& data,
+             const std::function<void(postoken::ledger&)>& apply) {
+      action_result res = postoken_c.push_action(signer, name, data);
+      native.now = res == success() ? LAST_BLOCK_EPOCH_TIME()
+                                    : control->pending_block_time().sec_since_epoch();
+      action_result expected = success();
+      try {
+         apply(native);
+      } catch( const postoken::rules_error& e ) {
+         expected = wasm_assert_msg(e.what());
+      }
+      BOOST_REQUIRE_EQUAL(res, expected);
+   }
+
+   void check_state(const std::vector<account_name>& accs, const symbol& sym) {
+      auto st = postoken_c.get_stats_row(sym);
+      BOOST_REQUIRE(st.valid());
+      BOOST_CHECK_EQUAL(st->supply.get_amount(), native.get_stats(sym.to_symbol_code().value).supply.amount);
+
+      auto balances = postoken_c.get_balances(sym);
+      for( account_name acc : accs ) {
+         auto& h = native.holders[uint64_t(acc)];
+         auto* b = h.find_balance(sym.to_symbol_code().value);
+         BOOST_CHECK_EQUAL(balances.count(acc), b != nullptr);
+         if( b )
+            BOOST_CHECK_EQUAL(balances[acc].get_amount(), b->amount);
+
+         auto rows = postoken_c.get_transfer_ins(acc);
+         BOOST_REQUIRE_EQUAL(rows.size(), h.ins.size());
+         for( size_t i = 0; i < rows.size(); i++ ) {
+            BOOST_CHECK_EQUAL(rows[i].id, h.ins[i].id);
+            BOOST_CHECK_EQUAL(rows[i].quantity.get_amount(), h.ins[i].quantity.amount);
+            BOOST_CHECK_EQUAL(rows[i].time, h.ins[i].time);
+         }
+      }
+   }
+
+   // Chain state as nodeos writes it to a portable snapshot
+   std::string write_snapshot() {
+      control->abort_block();
+      std::ostringstream ss;
+      auto writer = std::make_shared<ostream_snapshot_writer>(ss);
+      control->write_snapshot(writer);
+      writer->finalize();
+      return ss.str();
+   }
+
+   // What postoken-extract writes for the current chain state
+   std::string extract_columns() {
+      std::string snapshot = write_snapshot();
+      postoken::columnar_table table;
+      const uint64_t code = uint64_t(postoken_c.get_contract_name());
+      const uint64_t n_stat = uint64_t(N(stat)), n_accounts = uint64_t(N(accounts));
+      const uint64_t n_transferins = uint64_t(N(transferins)), n_subledgers = uint64_t(N(subledgers));
+      postoken::read_snapshot_contract_rows(snapshot.data(), snapshot.size(), code,
+         [&](const postoken::snapshot_table& t, const postoken::snapshot_kv_row& r) {
+            postoken::datastream ds(r.value, r.size);
+            if( t.table == n_transferins )
+               table.add_transfer_in(t.scope, ds.read_transfer_in());
+            else if( t.table == n_accounts )
+               table.add_balance(t.scope, ds.read_asset());
+            else if( t.table == n_subledgers )
+               table.add_sub_ledger(t.scope, ds.read_asset());
+            else if( t.table == n_stat ) {
+               table.stats.push_back(ds.read_currency_stats());
+               if( ds.remaining() >= sizeof(uint32_t) )
+                  table.stats.back().options = ds.read_raw<uint32_t>();
+            }
+         });
+
+      std::ostringstream out;
+      table.write(out);
+      return out.str();
+   }
+
+   postoken::ledger native;
+};
+
+BOOST_FIXTURE_TEST_CASE(ledger_matches_contract, native_rules_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   std::vector<account_name> holders{ N(acca), N(accb), N(accc), N(accd) };
+   symbol s(4, "TOK");
+
+   for( account_name acc : holders ) {
+      push(issuer, N(issue), mvo()("to", acc)("quantity", "100.0000 TOK")("memo", ""), [&](postoken::ledger& l) {
+         l.issue(uint64_t(acc), postoken::string_to_asset("100.0000 TOK"));
+      });
+   }
+
+   uint32_t start = LAST_BLOCK_EPOCH_TIME() + 1;
+   push(issuer, N(setstakespec),
+        mvo()("stake_start_time", start)("min_coin_age", 2)("max_coin_age", 30)
+             ("anual_interests", std::vector<mutable_variant_object>{
+                mvo()("years", 1)("interest_rate", "0.5000 TOK"),
+                mvo()("years", 0)("interest_rate", "0.0500 TOK") }),
+        [&](postoken::ledger& l) {
+           postoken::asset r1 = postoken::string_to_asset("0.5000 TOK");
+           postoken::asset r2 = postoken::string_to_asset("0.0500 TOK");
+           l.setstakespec(start, 2, 30, { { r1, 1 }, { r2, 0 } });
+        });
+
+   std::mt19937 rng(42);
+   for( int step = 0; step < 60; step++ ) {
+      produce_block(fc::microseconds(to_epoch_time(rng() % 20) * (uint64_t)1000000 + (rng() % 3600) * 1000000ll));
+
+      account_name from = holders[rng() % holders.size()];
+      account_name to   = holders[rng() % holders.size()];
+      if( rng() % 3 == 0 || from == to ) {
+         push(from, N(mint), mvo()("account", from)("sym_code", "TOK"), [&](postoken::ledger& l) {
+            l.mint(uint64_t(from), postoken::string_to_symbol_code("TOK"));
+         });
+      } else {
+         postoken::asset q(1 + rng() % 100000, postoken::symbol(postoken::string_to_symbol_code("TOK"), 4));
+         push(from, N(transfer), mvo()("from", from)("to", to)("quantity", postoken::asset_to_string(q))("memo", ""),
+              [&](postoken::ledger& l) {
+                 l.transfer(uint64_t(from), uint64_t(to), q);
+              });
+      }
+   }
+
+   check_state(holders, s);
+
+} FC_LOG_AND_RETHROW()
+
+// Random sub-ledger actions of a custodian next to transfers and mints of its balance
+BOOST_FIXTURE_TEST_CASE(sub_ledger_matches_contract, native_rules_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   account_name custodian = N(acca);
+   std::vector<account_name> holders{ N(acca), N(accb) };
+   symbol s(4, "TOK");
+   const uint64_t tok = postoken::string_to_symbol_code("TOK");
+
+   for( account_name acc : holders ) {
+      push(issuer, N(issue), mvo()("to", acc)("quantity", "100.0000 TOK")("memo", ""), [&](postoken::ledger& l) {
+         l.issue(uint64_t(acc), postoken::string_to_asset("100.0000 TOK"));
+      });
+   }
+   uint32_t start = LAST_BLOCK_EPOCH_TIME() + 1;
+   push(issuer, N(setstakespec),
+        mvo()("stake_start_time", start)("min_coin_age", 2)("max_coin_age", 30)
+             ("anual_interests", std::vector<mutable_variant_object>{ mvo()("years", 0)("interest_rate", "0.2000 TOK") }),
+        [&](postoken::ledger& l) {
+           l.setstakespec(start, 2, 30, { { postoken::string_to_asset("0.2000 TOK"), 0 } });
+        });
+
+   std::mt19937 rng(7);
+   auto quantity = [&]() {
+      return postoken::asset(1 + rng() % 300000, postoken::symbol(tok, 4));
+   };
+   for( int step = 0; step < 80; step++ ) {
+      produce_block(fc::microseconds(to_epoch_time(rng() % 10) * (uint64_t)1000000 + (rng() % 3600) * 1000000ll));
+
+      uint64_t sub = rng() % 4, other = rng() % 4;
+      postoken::asset q = quantity();
+      string qs = postoken::asset_to_string(q);
+      switch( rng() % 7 ) {
+      case 0:
+         push(custodian, N(subdeposit), mvo()("custodian", custodian)("sub", sub)("quantity", qs), [&](postoken::ledger& l) {
+            l.subdeposit(uint64_t(custodian), sub, q);
+         });
+         break;
+      case 1:
+         push(custodian, N(subwithdraw), mvo()("custodian", custodian)("sub", sub)("quantity", qs), [&](postoken::ledger& l) {
+            l.subwithdraw(uint64_t(custodian), sub, q);
+         });
+         break;
+      case 2:
+         push(custodian, N(submove), mvo()("custodian", custodian)("from", sub)("to", other)("quantity", qs),
+              [&](postoken::ledger& l) {
+                 l.submove(uint64_t(custodian), sub, other, q);
+              });
+         break;
+      case 3:
+         push(custodian, N(submint), mvo()("custodian", custodian)("subs", std::vector<uint64_t>{ sub, other }),
+              [&](postoken::ledger& l) {
+                 l.submint(uint64_t(custodian), { sub, other });
+              });
+         break;
+      case 4:
+         push(custodian, N(subsettle), mvo()("custodian", custodian)("sym_code", "TOK"), [&](postoken::ledger& l) {
+            l.subsettle(uint64_t(custodian), tok);
+         });
+         break;
+      case 5:
+         push(custodian, N(mint), mvo()("account", custodian)("sym_code", "TOK"), [&](postoken::ledger& l) {
+            l.mint(uint64_t(custodian), tok);
+         });
+         break;
+      default: {
+         account_name from = holders[rng() % 2], to = from == N(acca) ? N(accb) : N(acca);
+         push(from, N(transfer), mvo()("from", from)("to", to)("quantity", qs)("memo", ""), [&](postoken::ledger& l) {
+            l.transfer(uint64_t(from), uint64_t(to), q);
+         });
+      }
+      }
+   }
+
+   check_state(holders, s);
+   auto subs = postoken_c.get_sub_accounts(custodian);
+   size_t native_subs = 0;
+   for( const auto& n : native.sub_accounts ) {
+      if( n.first.first != uint64_t(custodian) )
+         continue;
+      native_subs++;
+      BOOST_REQUIRE(subs.count(n.first.second));
+      BOOST_CHECK_EQUAL(subs[n.first.second].balance.get_amount(), n.second.balance.amount);
+      BOOST_CHECK_EQUAL(subs[n.first.second].time, n.second.time);
+   }
+   BOOST_CHECK_EQUAL(subs.size(), native_subs);
+   auto ledger = postoken_c.get_sub_ledger(custodian, "4,TOK");
+   auto native_ledger = native.sub_ledgers.find({ uint64_t(custodian), tok });
+   BOOST_REQUIRE_EQUAL(ledger.is_null(), native_ledger == native.sub_ledgers.end());
+   if( !ledger.is_null() ) {
+      BOOST_CHECK_EQUAL(ledger["allocated"].as<asset>().get_amount(), native_ledger->second.allocated.amount);
+      BOOST_CHECK_EQUAL(ledger["unsettled"].as<asset>().get_amount(), native_ledger->second.unsettled.amount);
+   }
+
+} FC_LOG_AND_RETHROW()
+
+// postoken-extract path: snapshot -> columnar file -> text dump has to match the native ledger
+BOOST_FIXTURE_TEST_CASE(snapshot_extraction, native_rules_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   for( account_name acc : { N(acca), N(accb) } ) {
+      push(issuer, N(issue), mvo()("to", acc)("quantity", "100.0000 TOK")("memo", ""), [&](postoken::ledger& l) {
+         l.issue(uint64_t(acc), postoken::string_to_asset("100.0000 TOK"));
+      });
+   }
+   produce_block(fc::days(1));
+   push(N(acca), N(transfer), mvo()("from", "acca")("to", "accb")("quantity", "1.5000 TOK")("memo", ""),
+        [&](postoken::ledger& l) {
+           l.transfer(uint64_t(N(acca)), uint64_t(N(accb)), postoken::string_to_asset("1.5000 TOK"));
+        });
+   push(N(accb), N(subdeposit), mvo()("custodian", "accb")("sub", 1)("quantity", "2.0000 TOK"),
+        [&](postoken::ledger& l) {
+           l.subdeposit(uint64_t(N(accb)), 1, postoken::string_to_asset("2.0000 TOK"));
+        });
+
+   std::string columns = extract_columns();
+   auto lines = postoken::dump_lines(postoken::columnar_view(columns.data(), columns.size()));
+   BOOST_REQUIRE_EQUAL(lines.size(), 7); // stat, 3 accounts, 2 transferins (accb's merged), subledger
+   BOOST_REQUIRE(lines == postoken::dump_lines(native));
+
+} FC_LOG_AND_RETHROW()
+
+// postoken-rewards gives what mint issues
+BOOST_FIXTURE_TEST_CASE(batch_rewards_match_mint, native_rules_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   std::vector<account_name> holders{ N(acca), N(accb), N(accc), N(accd) };
+   symbol s(4, "TOK");
+   for( account_name acc : holders ) {
+      REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(issue),
+                                             mvo()("to", acc)("quantity", "100.0000 TOK")("memo", "")));
+   }
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setstakespec),
+      mvo()("stake_start_time", LAST_BLOCK_EPOCH_TIME() + 1)("min_coin_age", 3)("max_coin_age", 40)
+           ("anual_interests", std::vector<mutable_variant_object>{ mvo()("years", 0)("interest_rate", "0.1000 TOK") })));
+
+   std::mt19937 rng(7);
+   for( int step = 0; step < 30; step++ ) {
+      produce_block(fc::seconds(rng() % (5 * 24 * 3600)));
+      size_t f = rng() % holders.size();
+      account_name from = holders[f];
+      account_name to   = holders[(f + 1 + rng() % 3) % holders.size()];
+      asset q(1 + rng() % 10000, s);
+      REQUIRE_SUCCESS(postoken_c.push_action(from, N(transfer),
+                                             mvo()("from", from)("to", to)("quantity", q)("memo", "")));
+   }
+   // Custodian's balance earns through submint, mint rejects it
+   REQUIRE_SUCCESS(postoken_c.push_action(N(accd), N(subdeposit),
+                                          mvo()("custodian", "accd")("sub", 1)("quantity", "1.0000 TOK")));
+   produce_block(fc::days(2));
+
+   std::string columns = extract_columns();
+   produce_block();
+   postoken::columnar_view view(columns.data(), columns.size());
+   auto stats = view.stats();
+   BOOST_REQUIRE_EQUAL(stats.size(), 1);
+   auto rewards = postoken::compute_pending_rewards(view, stats[0], control->pending_block_time().sec_since_epoch(), 2);
+   BOOST_REQUIRE_EQUAL(rewards.size(), holders.size());
+
+   for( const auto& r : rewards ) {
+      account_name acc(r.owner);
+      asset before = postoken_c.get_balances(s)[acc];
+      action_result res = postoken_c.push_action(acc, N(mint), mvo()("account", acc)("sym_code", "TOK"));
+      BOOST_CHECK_EQUAL(r.status == postoken::has_sub_ledger, acc == N(accd));
+      if( r.status == postoken::reward_ok ) {
+         BOOST_REQUIRE_EQUAL(res, success());
+         BOOST_CHECK_EQUAL(postoken_c.get_balances(s)[acc].get_amount() - before.get_amount(), r.reward);
+      } else if( r.status == postoken::has_sub_ledger ) {
+         BOOST_REQUIRE_EQUAL(res, wasm_assert_msg("Balance has a sub-ledger, use submint"));
+      } else {
+         BOOST_REQUIRE(res != success());
+      }
+   }
+
+} FC_LOG_AND_RETHROW()
+
+// postoken-gen state loaded with load_state is what the contract would have written:
+// it extracts back unchanged, and mint (through the symbol index, first_in and aggregates) issues
+// what the native rules compute
+BOOST_FIXTURE_TEST_CASE(generated_state, native_rules_tester) try {
+   postoken::population_config cfg;
+   cfg.holders  = 300;
+   cfg.max_rows = 200;
+   cfg.time     = LAST_BLOCK_EPOCH_TIME();
+   cfg.issuer   = uint64_t(postoken_c.get_contract_name());
+   postoken::columnar_table generated = postoken::generate_population(cfg, 2);
+   std::ostringstream out;
+   generated.write(out);
+   std::string columns = out.str();
+   postoken::columnar_view view(columns.data(), columns.size());
+
+   load_state(view);
+   auto lines = postoken::dump_lines(view);
+   std::string extracted = extract_columns();
+   auto chain_lines = postoken::dump_lines(postoken::columnar_view(extracted.data(), extracted.size()));
+   BOOST_REQUIRE_EQUAL(chain_lines.size(), lines.size() + 1); // and the fixture's TOK
+   BOOST_REQUIRE(std::includes(chain_lines.begin(), chain_lines.end(), lines.begin(), lines.end()));
+
+   // Holders with the most transfer ins of the first symbol
+   symbol s(4, "POSA");
+   std::map<uint64_t, uint32_t> rows;
+   for( size_t i = 0; i < view.rows; i++ ) {
+      if( view.kind[i] == postoken::transfer_in_row && view.symbol[i] == s.value() )
+         rows[view.owner[i]]++;
+   }
+   std::vector<std::pair<uint32_t, uint64_t>> by_rows;
+   for( const auto& r : rows )
+      by_rows.emplace_back(r.second, r.first);
+   std::sort(by_rows.rbegin(), by_rows.rend());
+   by_rows.resize(5);
+   for( const auto& r : by_rows )
+      create_account(account_name(r.second));
+   produce_block(fc::days(1));
+
+   auto rewards = postoken::compute_pending_rewards(view, view.stats()[0], control->pending_block_time().sec_since_epoch());
+   for( const auto& r : by_rows ) {
+      account_name acc(r.second);
+      auto reward = std::find_if(rewards.begin(), rewards.end(),
+                                 [&](const postoken::pending_reward& p) { return p.owner == r.second; });
+      BOOST_REQUIRE(reward != rewards.end());
+      asset before = postoken_c.get_balances(s)[acc];
+      action_result res = postoken_c.push_action(acc, N(mint), mvo()("account", acc)("sym_code", "POSA"));
+      if( reward->status == postoken::reward_ok ) {
+         BOOST_REQUIRE_EQUAL(res, success());
+         BOOST_CHECK_EQUAL(postoken_c.get_balances(s)[acc].get_amount() - before.get_amount(), reward->reward);
+      } else {
+         BOOST_REQUIRE(res != success());
+      }
+   }
+
+   // Transfers keep using the loaded rows
+   account_name from(by_rows[0].second), to(by_rows[1].second);
+   REQUIRE_SUCCESS(postoken_c.push_action(from, N(transfer),
+                                          mvo()("from", from)("to", to)("quantity", "0.0001 POSA")("memo", "")));
+
+} FC_LOG_AND_RETHROW()
+
+// Transfer ins of a token with another precision (rows of earlier contract versions): mint sums the
+// symbol index only up to the first of them and fails to replace the rows if anything was earned,
+// mintall fails on them. Native ledger and batch rewards have to agree.
+BOOST_FIXTURE_TEST_CASE(mixed_precision_claim, native_rules_tester) try {
+   const postoken::timestamp_t now = LAST_BLOCK_EPOCH_TIME();
+   const uint64_t mix = postoken::string_to_symbol_code("MIX");
+   const postoken::symbol s4(mix, 4), s2(mix, 2);
+   postoken::columnar_table state;
+   postoken::currency_stats st;
+   st.supply           = postoken::asset(0, s4);
+   st.max_supply       = postoken::asset(10000000000ll, s4);
+   st.issuer           = uint64_t(postoken_c.get_contract_name());
+   st.min_coin_age     = 1;
+   st.max_coin_age     = 30;
+   st.stake_start_time = now - 100 * 86400;
+   st.anual_interests.push_back({ postoken::asset(1000, s4), 0 });
+   // acca earns before its mismatching row, accb's first row mismatches, accc has none
+   const std::vector<std::pair<account_name, std::vector<postoken::asset>>> holders{
+      { N(acca), { postoken::asset(100000, s4), postoken::asset(100, s2), postoken::asset(50000, s4) } },
+      { N(accb), { postoken::asset(100, s2), postoken::asset(100000, s4) } },
+      { N(accc), { postoken::asset(100000, s4) } } };
+   for( const auto& h : holders ) {
+      uint64_t o = uint64_t(h.first), id = 0;
+      int64_t balance = 0;
+      for( const auto& q : h.second ) {
+         state.add_transfer_in(o, { id, q, now - postoken::timestamp_t(40 - 10 * id) * 86400 });
+         id++;
+         balance += q.sym == s4 ? q.amount : 0;
+      }
+      state.add_balance(o, postoken::asset(balance, s4));
+      st.supply.amount += balance;
+   }
+   state.stats.push_back(st);
+   std::ostringstream out;
+   state.write(out);
+   std::string columns = out.str();
+   postoken::columnar_view view(columns.data(), columns.size());
+
+   load_state(view);
+   native.stats[mix] = st;
+   for( size_t i = 0; i < view.rows; i++ ) {
+      auto& h = native.holders[view.owner[i]];
+      if( view.kind[i] == postoken::balance_row )
+         h.balances.push_back(view.row_asset(i));
+      else
+         h.ins.push_back({ view.id[i], view.row_asset(i), view.time[i] });
+   }
+
+   auto rewards = postoken::compute_pending_rewards(view, st, control->pending_block_time().sec_since_epoch());
+   BOOST_REQUIRE_EQUAL(rewards.size(), holders.size());
+   BOOST_CHECK_EQUAL(rewards[0].status, postoken::invalid_precision);
+   BOOST_CHECK_EQUAL(rewards[1].status, postoken::nothing_to_claim);
+   BOOST_CHECK_EQUAL(rewards[2].status, postoken::reward_ok);
+
+   for( size_t i = 0; i < holders.size(); i++ ) {
+      account_name acc = holders[i].first;
+      asset before = postoken_c.get_balances(symbol(4, "MIX"))[acc];
+      push(acc, N(mint), mvo()("account", acc)("sym_code", "MIX"), [&](postoken::ledger& l) {
+         l.mint(uint64_t(acc), mix);
+      });
+      BOOST_CHECK_EQUAL(postoken_c.get_balances(symbol(4, "MIX"))[acc].get_amount() - before.get_amount(),
+                        rewards[i].reward);
+   }
+   push(N(accb), N(mintall), mvo()("account", "accb"), [&](postoken::ledger& l) {
+      l.mintall(uint64_t(N(accb)));
+   });
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(acca), N(mint), mvo()("account", "acca")("sym_code", "MIX")),
+                    "Invalid precision in transferin!");
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(accb), N(mint), mvo()("account", "accb")("sym_code", "MIX")),
+                    "Nothing to claim");
+
+   check_state({ N(acca), N(accb), N(accc) }, symbol(4, "MIX"));
+
+} FC_LOG_AND_RETHROW()
+
+// Client library packs action data as the ABI does
+BOOST_FIXTURE_TEST_CASE(client_action_packing, native_rules_tester) try {
+   auto abi_pack = [&](action_name name, const variant_object& data) {
+      return postoken_c.abi_ser.variant_to_binary(postoken_c.abi_ser.get_action_type(name), data, abi_serializer_max_time);
+   };
+   const uint64_t acca = uint64_t(N(acca)), accb = uint64_t(N(accb));
+   const postoken::asset q = postoken::string_to_asset("1.5000 TOK");
+   const postoken::symbol tok = q.sym;
+   const std::vector<uint64_t> owners{ acca, accb };
+   const std::vector<postoken::interest_t> interests{ { postoken::string_to_asset("0.5000 TOK"), 1 },
+                                                      { postoken::string_to_asset("0.1000 TOK"), 0 } };
+   const auto abi_interests = std::vector<mutable_variant_object>{ mvo()("interest_rate", "0.5000 TOK")("years", 1),
+                                                                   mvo()("interest_rate", "0.1000 TOK")("years", 0) };
+
+#define CHECK_PACKING(action, abi_name, data) \
+   BOOST_CHECK_EQUAL(action.name(), uint64_t(N(abi_name))); \
+   BOOST_CHECK(postoken::pack_action(action) == abi_pack(N(abi_name), data));
+
+   CHECK_PACKING((postoken::create_action{ acca, q }), create, mvo()("issuer", "acca")("maximum_supply", "1.5000 TOK"));
+   CHECK_PACKING((postoken::issue_action{ acca, q, "memo" }), issue,
+                 mvo()("to", "acca")("quantity", "1.5000 TOK")("memo", "memo"));
+   CHECK_PACKING((postoken::retire_action{ q, "" }), retire, mvo()("quantity", "1.5000 TOK")("memo", ""));
+   CHECK_PACKING((postoken::transfer_action{ acca, accb, q, "x" }), transfer,
+                 mvo()("from", "acca")("to", "accb")("quantity", "1.5000 TOK")("memo", "x"));
+   CHECK_PACKING((postoken::xfer_action{ acca, accb, 15000 }), xfer, mvo()("from", "acca")("to", "accb")("amount", 15000));
+   CHECK_PACKING((postoken::setdefsym_action{ tok.code() }), setdefsym, mvo()("sym_code", "TOK"));
+   CHECK_PACKING((postoken::open_action{ acca, tok, accb }), open,
+                 mvo()("owner", "acca")("symbol", "4,TOK")("ram_payer", "accb"));
+   CHECK_PACKING((postoken::close_action{ acca, tok }), close, mvo()("owner", "acca")("symbol", "4,TOK"));
+   CHECK_PACKING((postoken::openmany_action{ owners, tok, acca }), openmany,
+                 mvo()("owners", std::vector<account_name>{ N(acca), N(accb) })("symbol", "4,TOK")("ram_payer", "acca"));
+   CHECK_PACKING((postoken::closemany_action{ owners, tok }), closemany,
+                 mvo()("owners", std::vector<account_name>{ N(acca), N(accb) })("symbol", "4,TOK"));
+   CHECK_PACKING((postoken::setstakespec_action{ 1600000000, 3, 90, interests }), setstakespec,
+                 mvo()("stake_start_time", 1600000000)("min_coin_age", 3)("max_coin_age", 90)
+                      ("anual_interests", abi_interests));
+   CHECK_PACKING((postoken::mint_action{ acca, tok.code() }), mint, mvo()("account", "acca")("sym_code", "TOK"));
+   CHECK_PACKING((postoken::mintall_action{ acca }), mintall, mvo()("account", "acca"));
+   CHECK_PACKING((postoken::compact_action{ acca, tok.code(), 50 }), compact,
+                 mvo()("account", "acca")("sym_code", "TOK")("max_rows", 50));
+   CHECK_PACKING((postoken::setoptions_action{ tok.code(), 5 }), setoptions, mvo()("sym_code", "TOK")("options", 5));
+   CHECK_PACKING((postoken::setrewardpool_action{ tok.code(), 16, q }), setrewardpool,
+                 mvo()("sym_code", "TOK")("shards", 16)("shard_budget", "1.5000 TOK"));
+   CHECK_PACKING((postoken::settle_action{ tok.code() }), settle, mvo()("sym_code", "TOK"));
+   CHECK_PACKING((postoken::regholder_action{ acca, tok.code(), accb }), regholder,
+                 mvo()("owner", "acca")("sym_code", "TOK")("ram_payer", "accb"));
+   CHECK_PACKING((postoken::initagg_action{ tok.code(), owners }), initagg,
+                 mvo()("sym_code", "TOK")("owners", std::vector<account_name>{ N(acca), N(accb) }));
+   CHECK_PACKING((postoken::subdeposit_action{ acca, 7, q }), subdeposit,
+                 mvo()("custodian", "acca")("sub", 7)("quantity", "1.5000 TOK"));
+   CHECK_PACKING((postoken::subwithdraw_action{ acca, 7, q }), subwithdraw,
+                 mvo()("custodian", "acca")("sub", 7)("quantity", "1.5000 TOK"));
+   CHECK_PACKING((postoken::submove_action{ acca, 7, 8, q }), submove,
+                 mvo()("custodian", "acca")("from", 7)("to", 8)("quantity", "1.5000 TOK"));
+   CHECK_PACKING((postoken::submint_action{ acca, std::vector<uint64_t>{ 7, 8 } }), submint,
+                 mvo()("custodian", "acca")("subs", std::vector<uint64_t>{ 7, 8 }));
+   CHECK_PACKING((postoken::subsettle_action{ acca, tok.code() }), subsettle,
+                 mvo()("custodian", "acca")("sym_code", "TOK"));
+#undef CHECK_PACKING
+
+   // Fixed buffer: same bytes, nothing written past capacity
+   char buf[64];
+   auto transfer = postoken::transfer_action{ acca, accb, q, "x" };
+   size_t size = postoken::pack_action(transfer, buf, sizeof(buf));
+   BOOST_CHECK(std::vector<char>(buf, buf + size) == postoken::pack_action(transfer));
+   BOOST_CHECK_THROW(postoken::pack_action(transfer, buf, size - 1), postoken::rules_error);
+
+} FC_LOG_AND_RETHROW()
+
+// Rows decoded in place by the client library, and mint_reward gives what mint issues
+BOOST_FIXTURE_TEST_CASE(client_rows_and_mint_reward, native_rules_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   std::vector<account_name> holders{ N(acca), N(accb), N(accc) };
+   symbol s(4, "TOK");
+   const uint64_t code = uint64_t(issuer), sym_code = s.to_symbol_code().value;
+   for( account_name acc : holders ) {
+      REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(issue),
+                                             mvo()("to", acc)("quantity", "100.0000 TOK")("memo", "")));
+   }
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setstakespec),
+      mvo()("stake_start_time", LAST_BLOCK_EPOCH_TIME() + 1)("min_coin_age", 2)("max_coin_age", 30)
+           ("anual_interests", std::vector<mutable_variant_object>{ mvo()("years", 1)("interest_rate", "0.2000 TOK"),
+                                                                    mvo()("years", 0)("interest_rate", "0.1000 TOK") })));
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setoptions), mvo()("sym_code", "TOK")("options", 1)));
+
+   std::mt19937 rng(11);
+   for( int step = 0; step < 20; step++ ) {
+      produce_block(fc::seconds(rng() % (3 * 24 * 3600)));
+      size_t f = rng() % holders.size();
+      account_name from = holders[f], to = holders[(f + 1 + rng() % 2) % holders.size()];
+      REQUIRE_SUCCESS(postoken_c.push_action(from, N(transfer),
+                                             mvo()("from", from)("to", to)("quantity", asset(1 + rng() % 50000, s))("memo", "")));
+   }
+   // A custodian can't mint, mint_reward must say so too
+   REQUIRE_SUCCESS(postoken_c.push_action(N(accc), N(subdeposit),
+                                          mvo()("custodian", "accc")("sub", 1)("quantity", "1.0000 TOK")));
+   produce_block(fc::days(3));
+
+   std::vector<char> stat_data = get_row_by_account(code, sym_code, N(stat), sym_code);
+   postoken::currency_stats_view st(stat_data.data(), stat_data.size());
+   auto abi_st = postoken_c.get_stats_row(s);
+   BOOST_REQUIRE(abi_st.valid());
+   BOOST_CHECK_EQUAL(st.supply.amount, abi_st->supply.get_amount());
+   BOOST_CHECK_EQUAL(st.max_supply.amount, abi_st->max_supply.get_amount());
+   BOOST_CHECK_EQUAL(st.issuer, code);
+   BOOST_CHECK_EQUAL(st.stake_start_time, abi_st->stake_start_time);
+   BOOST_CHECK_EQUAL(st.anual_interests.size(), 2);
+   BOOST_CHECK_EQUAL(st.anual_interests[0].interest_rate.amount, 2000);
+   BOOST_CHECK_EQUAL(st.anual_interests[1].years, 0);
+   BOOST_CHECK_EQUAL(st.options, 1);
+   BOOST_CHECK(!st.has_pool);
+
+   const postoken::timestamp_t now = control->pending_block_time().sec_since_epoch();
+   for( account_name acc : holders ) {
+      std::vector<char> acc_data = get_row_by_account(code, uint64_t(acc), N(accounts), sym_code);
+      postoken::account_row row = postoken::decode_account(acc_data.data(), acc_data.size());
+      BOOST_CHECK_EQUAL(row.balance.amount, postoken_c.get_balances(s)[acc].get_amount());
+      BOOST_CHECK(row.has_first_in);
+
+      std::vector<postoken::transfer_in> ins;
+      for( const auto& tr : postoken_c.get_transfer_ins(acc) ) {
+         std::vector<char> tr_data = get_row_by_account(code, uint64_t(acc), N(transferins), tr.id);
+         ins.push_back(postoken::decode_transfer_in(tr_data.data(), tr_data.size()));
+         BOOST_CHECK_EQUAL(ins.back().quantity.amount, tr.quantity.get_amount());
+         BOOST_CHECK_EQUAL(ins.back().time, tr.time);
+      }
+
+      bool has_sub_ledger = !get_row_by_account(code, uint64_t(acc), N(subledgers), sym_code).empty();
+      BOOST_CHECK_EQUAL(has_sub_ledger, acc == N(accc));
+
+      action_result expected = success();
+      int64_t reward = 0;
+      try {
+         reward = postoken::mint_reward(st, &row, has_sub_ledger, ins, now).amount;
+      } catch( const postoken::rules_error& e ) {
+         expected = wasm_assert_msg(e.what());
+      }
+      asset before = postoken_c.get_balances(s)[acc];
+      BOOST_REQUIRE_EQUAL(postoken_c.push_action(acc, N(mint), mvo()("account", acc)("sym_code", "TOK")), expected);
+      BOOST_CHECK_EQUAL(postoken_c.get_balances(s)[acc].get_amount() - before.get_amount(), reward);
+   }
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END() // native_rules_tests
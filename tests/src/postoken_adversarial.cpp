@@ -0,0 +1,357 @@
+#include <postoken_tester.hpp>
+#include <postoken/population.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <iostream>
+
+// Worst case states others can push an account into (floods of one unit transfers, each adding a
+// transfer in), long interest schedules, mixed symbols and extreme precisions, and the CPU every
+// action then bills against the chain's max_transaction_cpu_usage. Registered once per wasm runtime
+// like postoken_benchmarks; scripts/bench.sh collects both and reports the margin left under the limit.
+//
+// Actions whose cost doesn't depend on what others sent have to stay within safety_margin_pct of the
+// limit. Costs that grow with the flood (debit and mint of the flooded balance) are reported with the
+// number of rows where a linear fit of them reaches the margin, which has to be at least
+// min_rows_at_margin. Past it is an accepted griefing window: whoever sends more one unit transfers
+// pays RAM for every row, and the rows can be folded by compact, in chunks of bounded cost, once they
+// are older than max_coin_age, so a flooded account always gets back under the margin.
+BOOST_AUTO_TEST_SUITE(postoken_adversarial)
+
+// Share of max_transaction_cpu_usage left free for slower producers and runtimes
+static constexpr uint32_t safety_margin_pct = 50;
+
+static const std::vector<uint32_t> flood_rows{ 1000, 2000, 4000 };
+
+// Transfer ins of one balance its debit and mint have to stay within the margin for
+static constexpr uint32_t min_rows_at_margin = 4000;
+
+class adversarial_tester : public postoken_bench_tester {
+public:
+   using sample = fc::optional<bench_result>; // empty when the action ran out of CPU
+   using growth = std::vector<std::pair<uint32_t, sample>>;
+
+   adversarial_tester() : now(LAST_BLOCK_EPOCH_TIME()) {}
+
+   uint32_t cpu_limit() const {
+      return control->get_global_properties().configuration.max_transaction_cpu_usage;
+   }
+
+   uint32_t margin_limit() const { return uint64_t(cpu_limit()) * (100 - safety_margin_pct) / 100; }
+
+   // Token `sym` ("4,FLOOD") issued by the contract, with `tiers` interest tiers of 10% (100% with
+   // precision 0) lasting a year each, the last one open ended, or without a stake spec. Staking
+   // started 40 years ago, so get_interest_rate walks up to 41 tiers.
+   void add_token(const std::string& sym, uint32_t tiers) {
+      postoken::symbol s = postoken::string_to_symbol(sym);
+      postoken::currency_stats st;
+      st.supply     = postoken::asset(0, s);
+      st.max_supply = postoken::asset(postoken::asset::max_amount, s);
+      st.issuer     = uint64_t(postoken_c.get_contract_name());
+      if( tiers > 0 ) {
+         st.min_coin_age = 1;
+         st.max_coin_age = 30;
+         int64_t rate = std::max<int64_t>(1, postoken::pow10(s.precision()) / 10);
+         for( uint32_t i = 0; i < tiers; i++ )
+            st.anual_interests.push_back({ postoken::asset(rate, s), uint16_t(i + 1 == tiers ? 0 : 1) });
+         st.stake_start_time = now - 40 * 365 * 86400;
+      }
+      state.stats.push_back(st);
+   }
+
+   // Balance of `sym`: the holder's own 10 tokens (at least 1000 units) received 60 days ago, then
+   // `dust` transfer ins of one unit each between 50 and 35 days ago. All of them can be claimed
+   // and are older than max_coin_age, so compact can fold them.
+   void add_holder(account_name owner, const std::string& sym, uint32_t dust) {
+      postoken::symbol s = postoken::string_to_symbol(sym);
+      uint64_t o = uint64_t(owner);
+      uint64_t& id = next_id[o];
+      int64_t own = std::max<int64_t>(10 * postoken::pow10(s.precision()), 1000);
+      state.add_transfer_in(o, { id++, postoken::asset(own, s), now - 60 * 86400 });
+      for( uint32_t i = 0; i < dust; i++ ) {
+         postoken::timestamp_t t = now - 50 * 86400 + postoken::timestamp_t(uint64_t(i) * 15 * 86400 / dust);
+         state.add_transfer_in(o, { id++, postoken::asset(1, s), t });
+      }
+      state.add_balance(o, postoken::asset(own + dust, s));
+      for( auto& st : state.stats ) {
+         if( st.supply.sym.value == s.value )
+            st.supply.amount += own + dust;
+      }
+   }
+
+   account_name new_holder() {
+      holders.push_back(account_name(postoken::population_holder_name(holders.size())));
+      return holders.back();
+   }
+
+   // Writes the tokens and holders into chain state and creates the holders' accounts
+   void load() {
+      std::ostringstream out;
+      state.write(out);
+      std::string columns = out.str();
+      load_state(postoken::columnar_view(columns.data(), columns.size()));
+      create_accounts(holders);
+   }
+
+   // measure, except that running out of CPU is a result
+   sample try_measure(account_name signer, action_name name, const variant_object& data) {
+      try {
+         return measure(signer, name, data);
+      } catch( const fc::exception& e ) {
+         if( e.code() != tx_cpu_usage_exceeded::code_value && e.code() != deadline_exception::code_value &&
+             e.code() != leeway_deadline_exception::code_value && e.code() != block_cpu_usage_exceeded::code_value )
+            throw;
+      }
+      produce_block();
+      return sample();
+   }
+
+   // `BENCH ...` line of a single sample with the CPU limit and the share of it left (an action that
+   // ran out of CPU has exceeded=1 and bills the limit)
+   void report_margin(const std::string& scenario, uint32_t rows, const sample& res, int64_t rows_at_margin = -1) const {
+      int64_t limit = cpu_limit(), billed = res.valid() ? res->billed_us : limit;
+      std::cout << "BENCH runtime=" << runtime_name() << " scenario=" << scenario << " rows=" << rows
+                << " samples=1 billed_us_median=" << billed << " billed_us_max=" << billed
+                << " elapsed_us_avg=" << (res.valid() ? res->elapsed_us : 0) << " cpu_limit_us=" << limit
+                << " margin_pct=" << (limit - billed) * 100 / limit;
+      if( !res )
+         std::cout << " exceeded=1";
+      if( rows_at_margin >= 0 )
+         std::cout << " rows_at_margin=" << rows_at_margin;
+      std::cout << std::endl;
+   }
+
+   // Reports samples by rows (or tiers) with where a least squares line through them reaches margin_limit,
+   // returns that (-1 if the cost doesn't grow)
+   int64_t report_growth(const std::string& scenario, const growth& samples) const {
+      double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+      for( const auto& s : samples ) {
+         if( !s.second )
+            continue;
+         double x = s.first, y = s.second->billed_us;
+         n++;
+         sx += x;
+         sy += y;
+         sxx += x * x;
+         sxy += x * y;
+      }
+      int64_t rows_at_margin = -1;
+      if( n >= 2 && n * sxx - sx * sx > 0 ) {
+         double slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+         double base  = (sy - slope * sx) / n;
+         if( slope > 0 )
+            rows_at_margin = std::max<int64_t>(0, int64_t((margin_limit() - base) / slope));
+      }
+      for( const auto& s : samples )
+         report_margin(scenario, s.first, s.second, rows_at_margin);
+      return rows_at_margin;
+   }
+
+   // Reports a cost growing with the flood and checks every sample ran and the margin is reached no
+   // earlier than min_rows_at_margin
+   void check_growth(const std::string& scenario, const growth& samples) const {
+      int64_t rows_at_margin = report_growth(scenario, samples);
+      for( const auto& s : samples )
+         BOOST_CHECK_MESSAGE(s.second.valid(), scenario << " ran out of CPU with " << s.first << " rows");
+      BOOST_CHECK_MESSAGE(rows_at_margin < 0 || rows_at_margin >= min_rows_at_margin,
+                          scenario << " reaches " << 100 - safety_margin_pct << "% of the CPU limit at "
+                          << rows_at_margin << " rows, less than " << min_rows_at_margin);
+   }
+
+   // Reports a single sample and checks it stays within the margin
+   void check_bounded(const std::string& scenario, uint32_t rows, const sample& res) const {
+      report_margin(scenario, rows, res);
+      BOOST_CHECK_MESSAGE(res.valid() && res->billed_us <= margin_limit(),
+                          scenario << " billed " << (res.valid() ? std::to_string(res->billed_us) : std::string("over"))
+                          << " us of " << cpu_limit() << " us, more than " << 100 - safety_margin_pct << "%");
+   }
+
+   const postoken::timestamp_t      now;
+   postoken::columnar_table         state;
+   std::map<uint64_t, uint64_t>     next_id; // owner -> next transfer in id
+   std::vector<account_name>        holders;
+};
+
+static mvo transfer_data(account_name from, account_name to, const asset& quantity) {
+   return mvo()("from", from)("to", to)("quantity", quantity)("memo", "");
+}
+
+// Debit of a flooded balance walks every row (newest first debit the rows it consumes), while paying
+// a flooded account stays one row
+BOOST_FIXTURE_TEST_CASE(flooded_transfer_cpu, adversarial_tester) try {
+   add_token("4,FLOOD", 1);
+   add_token("4,FLOODN", 1);
+   account_name sender = new_holder();
+   add_holder(sender, "4,FLOOD", 0);
+   std::vector<account_name> victims, newest_first_victims;
+   for( uint32_t rows : flood_rows ) {
+      victims.push_back(new_holder());
+      add_holder(victims.back(), "4,FLOOD", rows);
+      newest_first_victims.push_back(new_holder());
+      add_holder(newest_first_victims.back(), "4,FLOODN", rows);
+   }
+   load();
+   REQUIRE_SUCCESS(postoken_c.push_action(postoken_c.get_contract_name(), N(setoptions),
+                   mvo()("sym_code", "FLOODN")("options", 4)) );
+
+   growth transfers, newest_first;
+   for( size_t i = 0; i < flood_rows.size(); i++ ) {
+      check_bounded("transfer_to_flooded", flood_rows[i],
+                    try_measure(sender, N(transfer), transfer_data(sender, victims[i], asset_str("0.0001 FLOOD"))));
+      transfers.emplace_back(flood_rows[i],
+                             try_measure(victims[i], N(transfer),
+                                         transfer_data(victims[i], sender, asset_str("0.0001 FLOOD"))));
+      // One unit more than the dust, so every dust row is erased and the holder's own row reduced
+      account_name v = newest_first_victims[i];
+      newest_first.emplace_back(flood_rows[i],
+                                try_measure(v, N(transfer),
+                                            transfer_data(v, sender, asset(flood_rows[i] + 1, symbol(4, "FLOODN")))));
+   }
+   check_growth("flooded_transfer", transfers);
+   check_growth("flooded_transfer_newest_first", newest_first);
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(flooded_mint_cpu, adversarial_tester) try {
+   add_token("4,FLOOD", 1);
+   std::vector<account_name> minters, mintall_minters;
+   for( uint32_t rows : flood_rows ) {
+      minters.push_back(new_holder());
+      add_holder(minters.back(), "4,FLOOD", rows);
+      mintall_minters.push_back(new_holder());
+      add_holder(mintall_minters.back(), "4,FLOOD", rows);
+   }
+   load();
+
+   growth mints, mintalls;
+   for( size_t i = 0; i < flood_rows.size(); i++ ) {
+      mints.emplace_back(flood_rows[i],
+                         try_measure(minters[i], N(mint), mvo()("account", minters[i])("sym_code", "FLOOD")));
+      mintalls.emplace_back(flood_rows[i],
+                            try_measure(mintall_minters[i], N(mintall), mvo()("account", mintall_minters[i])));
+   }
+   check_growth("flooded_mint", mints);
+   check_growth("flooded_mintall", mintalls);
+
+} FC_LOG_AND_RETHROW()
+
+// Anyone can fold a flooded account's matured rows in chunks of bounded cost, after which its debit is
+// cheap again. A custodian's sub-ledger doesn't read transfer ins at all.
+BOOST_FIXTURE_TEST_CASE(flooded_recovery_cpu, adversarial_tester) try {
+   const uint32_t rows = flood_rows.back(), chunk = 500;
+   add_token("4,FLOOD", 1);
+   account_name victim = new_holder(), custodian = new_holder(), other = new_holder();
+   add_holder(victim, "4,FLOOD", rows);
+   add_holder(custodian, "4,FLOOD", rows);
+   add_holder(other, "4,FLOOD", 0);
+   load();
+
+   check_bounded("compact_flooded", chunk,
+                 try_measure(other, N(compact), mvo()("account", victim)("sym_code", "FLOOD")("max_rows", chunk)));
+   // Every call replaces `chunk` rows with one
+   for( uint32_t left = rows + 1 - (chunk - 1); left > 1; left -= std::min(left, chunk) - 1 ) {
+      REQUIRE_SUCCESS(postoken_c.push_action(other, N(compact),
+                      mvo()("account", victim)("sym_code", "FLOOD")("max_rows", chunk)) );
+   }
+   BOOST_REQUIRE_EQUAL(postoken_c.get_transfer_in_summary(victim)[symbol(4, "FLOOD")].count, 1);
+   check_bounded("transfer_after_compact", 1,
+                 try_measure(victim, N(transfer), transfer_data(victim, other, asset_str("0.0001 FLOOD"))));
+
+   check_bounded("subdeposit_flooded", rows,
+                 try_measure(custodian, N(subdeposit),
+                             mvo()("custodian", custodian)("sub", 1)("quantity", asset_str("5.0000 FLOOD"))));
+   check_bounded("submove_flooded", rows,
+                 try_measure(custodian, N(submove),
+                             mvo()("custodian", custodian)("from", 1)("to", 2)("quantity", asset_str("1.0000 FLOOD"))));
+   check_bounded("subwithdraw_flooded", rows,
+                 try_measure(custodian, N(subwithdraw),
+                             mvo()("custodian", custodian)("sub", 2)("quantity", asset_str("1.0000 FLOOD"))));
+
+} FC_LOG_AND_RETHROW()
+
+// Every stat read deserializes the whole schedule; rows of these lines are interest tiers
+BOOST_FIXTURE_TEST_CASE(long_schedule_cpu, adversarial_tester) try {
+   const std::vector<std::pair<string, uint32_t>> schedules{ {"SCHA", 1}, {"SCHB", 256}, {"SCHC", 4096} };
+   std::vector<account_name> minters, senders;
+   for( const auto& sch : schedules ) {
+      add_token("4," + sch.first, sch.second);
+      minters.push_back(new_holder());
+      add_holder(minters.back(), "4," + sch.first, 0);
+      senders.push_back(new_holder());
+      add_holder(senders.back(), "4," + sch.first, 0);
+   }
+   load();
+
+   growth mints, transfers;
+   for( size_t i = 0; i < schedules.size(); i++ ) {
+      const auto& sch = schedules[i];
+      mints.emplace_back(sch.second,
+                         try_measure(minters[i], N(mint), mvo()("account", minters[i])("sym_code", sch.first)));
+      transfers.emplace_back(sch.second,
+                             try_measure(senders[i], N(transfer),
+                                         transfer_data(senders[i], minters[i], asset_str("0.0001 " + sch.first))));
+   }
+   report_growth("long_schedule_mint", mints);
+   report_growth("long_schedule_transfer", transfers);
+
+   // Issuer's setstakespec of the same schedules on new tokens
+   account_name issuer = postoken_c.get_contract_name();
+   growth specs;
+   for( const auto& sch : schedules ) {
+      string code = "SPC" + sch.first.substr(3);
+      REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(create),
+                      mvo()("issuer", issuer)("maximum_supply", asset_str("1000000.0000 " + code))) );
+      std::vector<mutable_variant_object> interests;
+      for( uint32_t i = 0; i < sch.second; i++ )
+         interests.push_back(mvo()("years", i + 1 == sch.second ? 0 : 1)("interest_rate", asset_str("0.1000 " + code)));
+      specs.emplace_back(sch.second,
+                         try_measure(issuer, N(setstakespec),
+                                     mvo()("stake_start_time", LAST_BLOCK_EPOCH_TIME() + 10)
+                                          ("min_coin_age", 1)("max_coin_age", 30)("anual_interests", interests)));
+   }
+   report_growth("setstakespec_long", specs);
+
+} FC_LOG_AND_RETHROW()
+
+// Flooded balances of four tokens in one account, from precision 0 to 16 (MIXD has no stake spec,
+// mintall skips it). Rows of mintall are all transfer ins of the account. Each balance is within
+// min_rows_at_margin, so every action has to stay within the margin.
+BOOST_FIXTURE_TEST_CASE(mixed_symbols_cpu, adversarial_tester) try {
+   const uint32_t rows = flood_rows.front();
+   const std::vector<std::pair<string, uint32_t>> tokens{ {"0,MIXA", 1}, {"4,MIXB", 1}, {"8,MIXC", 1}, {"16,MIXD", 0} };
+   for( const auto& t : tokens )
+      add_token(t.first, t.second);
+   account_name sender = new_holder(), minter = new_holder(), mintall_minter = new_holder();
+   for( account_name a : { sender, minter, mintall_minter } ) {
+      for( const auto& t : tokens )
+         add_holder(a, t.first, rows);
+   }
+   load();
+
+   for( const auto& t : tokens ) {
+      symbol sym = symbol::from_string(t.first);
+      check_bounded("mixed_transfer_p" + std::to_string(sym.decimals()), rows,
+                    try_measure(sender, N(transfer), transfer_data(sender, minter, asset(1, sym))));
+   }
+   check_bounded("mixed_mint_p8", rows, try_measure(minter, N(mint), mvo()("account", minter)("sym_code", "MIXC")));
+   check_bounded("mixed_mintall", rows * uint32_t(tokens.size()),
+                 try_measure(mintall_minter, N(mintall), mvo()("account", mintall_minter)));
+
+} FC_LOG_AND_RETHROW()
+
+// Reward pool at max_pool_shards: the first settle allocates every budget, the one after shard_budget 0
+// releases them, both write every row
+BOOST_FIXTURE_TEST_CASE(max_shards_settle_cpu, adversarial_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   const uint16_t shards = postoken::max_pool_shards;
+   check_bounded("setrewardpool", shards,
+                 try_measure(issuer, N(setrewardpool),
+                             mvo()("sym_code", "TOK")("shards", shards)("shard_budget", asset_str("1.0000 TOK"))));
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setoptions), mvo()("sym_code", "TOK")("options", 8)));
+   check_bounded("settle", shards, try_measure(N(accf), N(settle), mvo()("sym_code", "TOK")));
+
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setrewardpool),
+                   mvo()("sym_code", "TOK")("shards", shards)("shard_budget", asset_str("0.0000 TOK"))) );
+   check_bounded("settle_release", shards, try_measure(N(accf), N(settle), mvo()("sym_code", "TOK")));
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END() // postoken_adversarial
@@ -0,0 +1,296 @@
+#include <postoken_tester.hpp>
+#include <postoken/population.hpp>
+#include <eosio/chain/resource_limits.hpp>
+#include <iostream>
+#include <numeric>
+
+// CPU benchmarks of postoken actions. Registered once per wasm runtime (see tests/CMakeLists.txt),
+// scripts/bench.sh runs them all and reports the worst runtime for every scenario.
+BOOST_AUTO_TEST_SUITE(postoken_benchmarks)
+
+static const std::vector<uint32_t> transfer_in_counts{ 1, 10, 100, 500 };
+
+static std::vector<mutable_variant_object> flat_interest(const string& rate) {
+   return { mvo()("years", 0)("interest_rate", asset_str(rate)) };
+}
+
+BOOST_FIXTURE_TEST_CASE(transfer_cpu, postoken_bench_tester) try {
+   REQUIRE_SUCCESS(postoken_c.push_action(postoken_c.get_contract_name(), N(issue),
+                   mvo()("to", "accf")("quantity", asset_str("1000.0000 TOK"))("memo", "")) );
+
+   // Sender with a single transfer_in
+   std::vector<bench_result> samples;
+   for( int i = 0; i < 10; i++ ) {
+      samples.push_back(measure(N(accf), N(transfer),
+                                mvo()("from", "accf")("to", "acce")("quantity", asset_str("1.0000 TOK"))
+                                     ("memo", std::to_string(i))) );
+   }
+   report("transfer", 1, samples);
+
+   // Same transfer with xfer (no memo, no stat read)
+   REQUIRE_SUCCESS(postoken_c.push_action(postoken_c.get_contract_name(), N(setdefsym), mvo()("sym_code", "TOK")));
+   samples.clear();
+   for( int i = 0; i < 10; i++ )
+      samples.push_back(measure(N(accf), N(xfer), mvo()("from", "accf")("to", "acce")("amount", 10000)));
+   report("xfer", 1, samples);
+
+   // Sender with many transfer_ins, all of which are replaced by sub_balance
+   for( uint32_t count : transfer_in_counts ) {
+      fill_transfer_ins(N(accf), N(acce), asset_str("0.0001 TOK"), count);
+      uint32_t rows = postoken_c.get_transfer_in_summary(N(acce))[symbol(4, "TOK")].count;
+      auto res = measure(N(acce), N(transfer),
+                         mvo()("from", "acce")("to", "accf")("quantity", asset_str("0.0001 TOK"))("memo", ""));
+      report("transfer", rows, { res });
+      // Empty acce, so that the next round starts without transfer_ins
+      auto balance = postoken_c.get_balances(symbol(4, "TOK")).at(N(acce));
+      REQUIRE_SUCCESS(postoken_c.push_action(N(acce), N(transfer),
+                      mvo()("from", "acce")("to", "accf")("quantity", balance)("memo", "")) );
+   }
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(mint_cpu, postoken_bench_tester) try {
+   std::vector<account_name> minters{ N(minter1), N(minter2), N(minter3), N(minter4) };
+   BOOST_REQUIRE_EQUAL(minters.size(), transfer_in_counts.size());
+   create_accounts(minters);
+   REQUIRE_SUCCESS(postoken_c.push_action(postoken_c.get_contract_name(), N(issue),
+                   mvo()("to", "accf")("quantity", asset_str("1000.0000 TOK"))("memo", "")) );
+
+   set_stake_spec(symbol(4, "TOK"), LAST_BLOCK_EPOCH_TIME() + 1, 1, 60, flat_interest("0.1000 TOK"));
+   for( size_t i = 0; i < minters.size(); i++ )
+      fill_transfer_ins(N(accf), minters[i], asset_str("0.1000 TOK"), transfer_in_counts[i]);
+   produce_block(fc::microseconds(to_epoch_time(10) * (uint64_t)1000000));
+
+   symbol_code sym_code = symbol(4, "TOK").to_symbol_code();
+   for( size_t i = 0; i < minters.size(); i++ ) {
+      auto res = measure(minters[i], N(mint), mvo()("account", minters[i])("sym_code", sym_code));
+      report("mint", transfer_in_counts[i], { res });
+   }
+
+} FC_LOG_AND_RETHROW()
+
+// mint and transfer of holders of a synthetic population (postoken-gen's model) loaded into the chain,
+// from the smallest to the largest number of transfer ins
+BOOST_FIXTURE_TEST_CASE(generated_state_cpu, postoken_bench_tester) try {
+   postoken::population_config cfg;
+   cfg.holders  = 1000;
+   cfg.max_rows = 500;
+   cfg.time     = LAST_BLOCK_EPOCH_TIME();
+   cfg.issuer   = uint64_t(postoken_c.get_contract_name());
+   std::ostringstream out;
+   postoken::generate_population(cfg, 2).write(out);
+   std::string columns = out.str();
+   postoken::columnar_view view(columns.data(), columns.size());
+   load_state(view);
+
+   // Holders ordered by their transfer ins of POSA; those who got it in the last month are left out,
+   // they may have nothing to claim yet
+   symbol s(4, "POSA");
+   std::map<uint64_t, std::pair<uint32_t, uint32_t>> rows; // owner -> (count, oldest time)
+   for( size_t i = 0; i < view.rows; i++ ) {
+      if( view.kind[i] == postoken::transfer_in_row && view.symbol[i] == s.value() ) {
+         auto& r = rows.emplace(view.owner[i], std::make_pair(0u, view.time[i])).first->second;
+         r.first++;
+         r.second = std::min(r.second, view.time[i]);
+      }
+   }
+   std::vector<std::pair<uint32_t, uint64_t>> by_rows;
+   for( const auto& r : rows ) {
+      if( r.second.second + 30 * 86400 < cfg.time )
+         by_rows.emplace_back(r.second.first, r.first);
+   }
+   std::sort(by_rows.begin(), by_rows.end());
+
+   // Two holders (one mints, one transfers) at the median, 90th, 99th percentile and the maximum
+   std::vector<std::pair<uint32_t, uint64_t>> picked;
+   for( double p : { 0.5, 0.9, 0.99 } ) {
+      size_t i = std::min(by_rows.size() - 3, size_t(p * by_rows.size()));
+      picked.push_back(by_rows[i]);
+      picked.push_back(by_rows[i + 1]);
+   }
+   picked.push_back(by_rows[by_rows.size() - 2]);
+   picked.push_back(by_rows.back());
+   for( const auto& h : picked )
+      create_account(account_name(h.second));
+   produce_block(fc::days(1));
+
+   for( size_t i = 0; i < picked.size(); i += 2 ) {
+      account_name minter(picked[i].second), sender(picked[i + 1].second);
+      auto res = measure(minter, N(mint), mvo()("account", minter)("sym_code", "POSA"));
+      report("generated_mint", picked[i].first, { res });
+      res = measure(sender, N(transfer),
+                    mvo()("from", sender)("to", minter)("quantity", asset_str("0.0001 POSA"))("memo", ""));
+      report("generated_transfer", picked[i + 1].first, { res });
+   }
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(compact_cpu, postoken_bench_tester) try {
+   create_accounts({ N(minter1) });
+   REQUIRE_SUCCESS(postoken_c.push_action(postoken_c.get_contract_name(), N(issue),
+                   mvo()("to", "accf")("quantity", asset_str("1000.0000 TOK"))("memo", "")) );
+   set_stake_spec(symbol(4, "TOK"), LAST_BLOCK_EPOCH_TIME() + 1, 1, 60, flat_interest("0.1000 TOK"));
+   fill_transfer_ins(N(accf), N(minter1), asset_str("0.1000 TOK"), 611);
+   produce_block(fc::microseconds(to_epoch_time(61) * (uint64_t)1000000));
+
+   // Every step folds max_rows matured rows into one
+   for( uint32_t max_rows : { 11, 101, 501 } ) {
+      auto res = measure(N(accf), N(compact), mvo()("account", "minter1")("sym_code", "TOK")("max_rows", max_rows));
+      report("compact", max_rows, { res });
+   }
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(setstakespec_cpu, postoken_bench_tester) try {
+   std::vector<std::pair<string, uint32_t>> schedules{ {"BNA", 1}, {"BNB", 10}, {"BNC", 50} };
+   account_name issuer = postoken_c.get_contract_name();
+
+   for( const auto& sch : schedules ) {
+      REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(create),
+                      mvo()("issuer", issuer)("maximum_supply", asset_str("1000000.0000 " + sch.first))) );
+
+      std::vector<mutable_variant_object> interests;
+      for( uint32_t i = 0; i < sch.second; i++ )
+         interests.push_back(mvo()("years", i + 1 == sch.second ? 0 : 1)
+                                  ("interest_rate", asset_str("0.0100 " + sch.first)));
+
+      auto res = measure(issuer, N(setstakespec),
+                         mvo()("stake_start_time", LAST_BLOCK_EPOCH_TIME() + 10)
+                              ("min_coin_age", 1)("max_coin_age", 60)("anual_interests", interests));
+      report("setstakespec", sch.second, { res });
+   }
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(openmany_cpu, postoken_bench_tester) try {
+   // Balance row scopes don't have to be existing accounts
+   auto owner_name = [](uint32_t i) {
+      std::string s = "owner";
+      for( int d = 0; d < 4; d++, i /= 26 )
+         s += char('a' + i % 26);
+      return account_name(s);
+   };
+
+   uint32_t next = 0;
+   auto res = measure(N(acca), N(open), mvo()("owner", owner_name(next++))("symbol", "4,TOK")("ram_payer", "acca"));
+   report("open", 1, { res });
+   for( uint32_t count : { 10, 100, 500 } ) {
+      std::vector<account_name> owners;
+      while( owners.size() < count )
+         owners.push_back(owner_name(next++));
+      res = measure(N(acca), N(openmany), mvo()("owners", owners)("symbol", "4,TOK")("ram_payer", "acca"));
+      report("openmany", count, { res });
+   }
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(db_ops, postoken_dbstats_tester) try {
+   // Sender and recipient both exist and sender has a single transfer_in
+   auto res = measure(N(acca), N(transfer),
+                      mvo()("from", "acca")("to", "accb")("quantity", asset_str("1.0000 TOK"))("memo", ""));
+   report("transfer", 1, { res });
+   // stat, accounts and transfer ins lookups plus an aggregates update for each side, and the sender's
+   // sub-ledger lookup
+   BOOST_CHECK_EQUAL(res.db_stats["find"], 7);
+   BOOST_CHECK_EQUAL(res.db_stats["emplace"], 2);
+   BOOST_CHECK_EQUAL(res.db_stats["modify"], 4);
+   BOOST_CHECK_EQUAL(res.db_stats["erase"], 1);
+
+   // config lookup replaces the stat one
+   REQUIRE_SUCCESS(postoken_c.push_action(postoken_c.get_contract_name(), N(setdefsym), mvo()("sym_code", "TOK")));
+   res = measure(N(acca), N(xfer), mvo()("from", "acca")("to", "accb")("amount", 10000));
+   report("xfer", 1, { res });
+   BOOST_CHECK_EQUAL(res.db_stats["find"], 7);
+   BOOST_CHECK_EQUAL(res.db_stats["emplace"], 2);
+   BOOST_CHECK_EQUAL(res.db_stats["modify"], 4);
+   BOOST_CHECK_EQUAL(res.db_stats["erase"], 1);
+
+   create_accounts({ N(minter1) });
+   REQUIRE_SUCCESS(postoken_c.push_action(postoken_c.get_contract_name(), N(issue),
+                   mvo()("to", "accf")("quantity", asset_str("1000.0000 TOK"))("memo", "")) );
+   set_stake_spec(symbol(4, "TOK"), LAST_BLOCK_EPOCH_TIME() + 1, 1, 60, flat_interest("0.1000 TOK"));
+   fill_transfer_ins(N(accf), N(minter1), asset_str("0.1000 TOK"), 100);
+   produce_block(fc::microseconds(to_epoch_time(10) * (uint64_t)1000000));
+
+   res = measure(N(minter1), N(mint), mvo()("account", "minter1")("sym_code", symbol(4, "TOK").to_symbol_code()));
+   report("mint", 100, { res });
+   // Every row is visited once by the coin age loop and erased once, plus the reward transfer_in
+   BOOST_CHECK_EQUAL(res.db_stats["next"], 100);
+   BOOST_CHECK_EQUAL(res.db_stats["erase"], 101);
+
+   // Newest first debit only visits the rows it consumes
+   REQUIRE_SUCCESS(postoken_c.push_action(postoken_c.get_contract_name(), N(setoptions),
+                   mvo()("sym_code", "TOK")("options", 4)) );
+   fill_transfer_ins(N(accf), N(minter1), asset_str("0.1000 TOK"), 100);
+   res = measure(N(minter1), N(transfer),
+                 mvo()("from", "minter1")("to", "accf")("quantity", asset_str("0.1500 TOK"))("memo", ""));
+   report("transfer_newest_first", 101, { res });
+   BOOST_CHECK_EQUAL(res.db_stats["next"], 2);
+   BOOST_CHECK_EQUAL(res.db_stats["erase"], 1);
+
+} FC_LOG_AND_RETHROW()
+
+// WASM size, RAM billed for setcode and setabi, and CPU of the first action after deploy, which
+// instantiates (and with wavm compiles) the module, next to the same action once it is cached.
+// Compares the default build with the lean one (src/CMakeLists.txt).
+BOOST_AUTO_TEST_CASE(deploy_cost) try {
+   struct build {
+      std::string           name;
+      account_name          account;
+      contract::read_wasm_f read_wasm;
+      contract::read_abi_f  read_abi;
+   };
+   const std::vector<build> builds{
+      { "postoken", N(postoken), contracts::postoken_wasm, contracts::postoken_abi },
+      { "postoken_lean", N(postokenlean), contracts::postoken_lean_wasm, contracts::postoken_lean_abi }
+   };
+   // One chain for both, the builds have different code hashes so neither finds the other cached
+   tester t;
+   const std::string runtime = fc::variant(t.control->get_config().wasm_runtime).as_string();
+   std::vector<size_t> wasm_sizes;
+   for( const auto& b : builds ) {
+      t.create_accounts({ b.account });
+      t.produce_block();
+      const auto& rlm = t.control->get_resource_limits_manager();
+      int64_t ram_before = rlm.get_account_ram_usage(b.account);
+      auto wasm = b.read_wasm();
+      t.set_code(b.account, wasm);
+      t.set_abi(b.account, b.read_abi().data());
+      t.produce_block();
+      int64_t deploy_ram = rlm.get_account_ram_usage(b.account) - ram_before;
+      wasm_sizes.push_back(wasm.size());
+
+      // Same action every time, only the first one finds the module cold. Billed by the CPU it takes,
+      // like postoken_bench_tester::measure: push_action bills a fixed DEFAULT_BILLED_CPU_TIME_US
+      std::vector<uint32_t> billed;
+      std::vector<int64_t>  elapsed;
+      for( std::string code : { "TOKA", "TOKB", "TOKC", "TOKD", "TOKE", "TOKF" } ) {
+         signed_transaction trx;
+         trx.actions.emplace_back(t.get_action(b.account, N(create),
+                                  vector<permission_level>{{b.account, config::active_name}},
+                                  mvo()("issuer", b.account)("maximum_supply", asset_str("1000.0000 " + code))));
+         t.set_transaction_headers(trx);
+         trx.sign(t.get_private_key(b.account, "active"), t.control->get_chain_id());
+         auto trace = t.push_transaction(trx, fc::time_point::maximum(), 0);
+         t.produce_block();
+         BOOST_REQUIRE(trace->receipt);
+         billed.push_back(trace->receipt->cpu_usage_us);
+         elapsed.push_back(trace->elapsed.count());
+      }
+
+      std::cout << "BENCH runtime=" << runtime << " scenario=first_call_" << b.name << " rows=0 samples=1"
+                << " billed_us_median=" << billed[0] << " billed_us_max=" << billed[0]
+                << " elapsed_us_avg=" << elapsed[0] << " wasm_bytes=" << wasm.size()
+                << " deploy_ram_bytes=" << deploy_ram << std::endl;
+      std::vector<uint32_t> warm(billed.begin() + 1, billed.end());
+      std::sort(warm.begin(), warm.end());
+      std::cout << "BENCH runtime=" << runtime << " scenario=warm_call_" << b.name << " rows=0 samples="
+                << warm.size() << " billed_us_median=" << warm[warm.size() / 2] << " billed_us_max=" << warm.back()
+                << " elapsed_us_avg=" << std::accumulate(elapsed.begin() + 1, elapsed.end(), int64_t(0)) / int64_t(warm.size())
+                << std::endl;
+   }
+   BOOST_CHECK_LE(wasm_sizes[1], wasm_sizes[0]);
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END() // postoken_benchmarks
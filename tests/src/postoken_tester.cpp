@@ -1,12 +1,19 @@
 #include <postoken_tester.hpp>
 #include <contracts.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/resource_limits.hpp>
+#include <postoken/columnar.hpp>
+#include <postoken/mapped_file.hpp>
+#include <sstream>
+#include <unordered_map>
 
 const std::vector<account_name> postoken_tester::accounts = std::vector<account_name>{
    N(acca), N(accb), N(accc), N(accd), N(acce), N(accf)
 };
 const symbol postoken_tester::system_symbol = symbol(4, "EOS");
 
-postoken_tester::postoken_tester() : postoken_c(*this) {
+postoken_tester::postoken_tester(contract::read_wasm_f read_wasm, contract::read_abi_f read_abi)
+   : postoken_c(*this, read_wasm, read_abi) {
 
    produce_block();
 
@@ -21,7 +28,8 @@ postoken_tester::postoken_tester() : postoken_c(*this) {
 
 }
 
-postoken_issued_tester::postoken_issued_tester() : postoken_tester() {
+postoken_issued_tester::postoken_issued_tester(contract::read_wasm_f read_wasm, contract::read_abi_f read_abi)
+   : postoken_tester(read_wasm, read_abi) {
    REQUIRE_SUCCESS(postoken_c.push_action(postoken_c.get_contract_name(), N(issue),
                    mvo()("to", "acca")("quantity", asset_str("10.0000 TOK"))
                         ("memo", "issue")
@@ -40,3 +48,227 @@ postoken_issued_tester::postoken_issued_tester() : postoken_tester() {
    ));
 }
 
+void postoken_tester::load_state(const std::string& columnar_path) {
+   postoken::mapped_file file(columnar_path);
+   load_state(postoken::columnar_view(file.data, file.size));
+}
+
+void postoken_tester::load_state(const postoken::columnar_view& c) {
+   auto& db = control->mutable_db();
+   const account_name code = postoken_c.get_contract_name();
+   int64_t ram = 0;
+
+   auto get_table = [&](uint64_t scope, uint64_t table) -> const table_id_object& {
+      auto* t = db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, name(scope), name(table)));
+      if( t )
+         return *t;
+      ram += config::billable_size_v<table_id_object>;
+      return db.create<table_id_object>([&](table_id_object& o) {
+         o.code  = code;
+         o.scope = name(scope);
+         o.table = name(table);
+         o.payer = code;
+      });
+   };
+   auto store = [&](uint64_t scope, uint64_t table, uint64_t primary_key, const std::vector<char>& value) {
+      const auto& t = get_table(scope, table);
+      db.create<key_value_object>([&](key_value_object& o) {
+         o.t_id        = t.id;
+         o.primary_key = primary_key;
+         o.payer       = code;
+         o.value.assign(value.data(), value.size());
+      });
+      db.modify(t, [](table_id_object& o) { ++o.count; });
+      ram += value.size() + config::billable_size_v<key_value_object>;
+   };
+   auto row = [](const std::function<void(postoken::datastream_writer&)>& write) {
+      std::vector<char> v;
+      postoken::datastream_writer ds(v);
+      write(ds);
+      return v;
+   };
+
+   const uint64_t n_stat = uint64_t(N(stat)), n_accounts = uint64_t(N(accounts));
+   const uint64_t n_transferins = uint64_t(N(transferins)), n_aggregates = uint64_t(N(aggregates));
+   // multi_index table of the first secondary index (transfer_in::symbol_key)
+   const uint64_t n_transferins_symbol = n_transferins & 0xFFFFFFFFFFFFFFF0ULL;
+
+   struct aggregate {
+      postoken::asset total_balance;
+      uint128_t       weighted_time = 0;
+      uint64_t        holders       = 0;
+   };
+   std::map<uint64_t, aggregate> aggregates; // by symbol code
+   for( const auto& st : c.stats() ) {
+      uint64_t sym_code = st.supply.sym.code();
+      BOOST_REQUIRE_MESSAGE(!db.find<table_id_object, by_code_scope_table>(
+                               boost::make_tuple(code, name(sym_code), name(n_stat))),
+                            "token " << postoken::symbol_code_to_string(sym_code) << " already exists");
+      store(sym_code, n_stat, sym_code, row([&](postoken::datastream_writer& ds) { ds.write_currency_stats(st); }));
+      aggregates[sym_code].total_balance = postoken::asset(0, st.supply.sym);
+   }
+
+   struct balance_key_hash {
+      size_t operator()(const std::pair<uint64_t, uint64_t>& k) const { return k.first * 31 + k.second; }
+   };
+   std::unordered_map<std::pair<uint64_t, uint64_t>, postoken::timestamp_t, balance_key_hash> first_in;
+   for( size_t i = 0; i < c.rows; i++ ) {
+      if( c.kind[i] != postoken::transfer_in_row )
+         continue;
+      postoken::transfer_in tr{ c.id[i], c.row_asset(i), c.time[i] };
+      uint64_t sym_code = tr.quantity.sym.code();
+      store(c.owner[i], n_transferins, tr.id, row([&](postoken::datastream_writer& ds) { ds.write_transfer_in(tr); }));
+
+      const auto& idx = get_table(c.owner[i], n_transferins_symbol);
+      db.create<index64_object>([&](index64_object& o) {
+         o.t_id          = idx.id;
+         o.primary_key   = tr.id;
+         o.secondary_key = sym_code;
+         o.payer         = code;
+      });
+      db.modify(idx, [](table_id_object& o) { ++o.count; });
+      ram += config::billable_size_v<index64_object>;
+
+      auto f = first_in.emplace(std::make_pair(c.owner[i], sym_code), tr.time);
+      f.first->second = std::min(f.first->second, tr.time);
+      auto agg = aggregates.find(sym_code);
+      BOOST_REQUIRE_MESSAGE(agg != aggregates.end(), "no stat row for transfer in " << tr.id);
+      agg->second.total_balance.amount += tr.quantity.amount;
+      agg->second.weighted_time += uint128_t(tr.quantity.amount) * tr.time;
+   }
+
+   for( size_t i = 0; i < c.rows; i++ ) {
+      if( c.kind[i] != postoken::balance_row )
+         continue;
+      postoken::asset balance = c.row_asset(i);
+      uint64_t sym_code = balance.sym.code();
+      auto agg = aggregates.find(sym_code);
+      BOOST_REQUIRE_MESSAGE(agg != aggregates.end(), "no stat row for balance " << postoken::asset_to_string(balance));
+      auto f = first_in.find(std::make_pair(c.owner[i], sym_code));
+      postoken::timestamp_t first = f != first_in.end() ? f->second : 0;
+      store(c.owner[i], n_accounts, sym_code, row([&](postoken::datastream_writer& ds) {
+         ds.write_asset(balance);
+         ds.write_raw(first); // first_in
+      }));
+      if( balance.amount > 0 )
+         agg->second.holders++;
+   }
+
+   for( const auto& a : aggregates ) {
+      store(a.first, n_aggregates, a.first, row([&](postoken::datastream_writer& ds) {
+         ds.write_asset(a.second.total_balance);
+         ds.write_raw(a.second.weighted_time);
+         ds.write_raw(a.second.holders);
+      }));
+   }
+
+   control->get_mutable_resource_limits_manager().add_pending_ram_usage(code, ram);
+   produce_block();
+}
+
+postoken_bench_tester::postoken_bench_tester(contract::read_wasm_f read_wasm, contract::read_abi_f read_abi)
+   : postoken_issued_tester(read_wasm, read_abi) {
+   // Let the runtime instantiate (and compile) the contract before anything is measured
+   REQUIRE_SUCCESS(postoken_c.push_action(N(acca), N(transfer),
+                   mvo()("from", "acca")("to", "accb")("quantity", asset_str("0.0001 TOK"))
+                        ("memo", "warmup")
+   ));
+}
+
+postoken_bench_tester::bench_result postoken_bench_tester::measure(account_name signer, action_name name,
+                                                                  const variant_object& data) {
+   // Billed by the CPU it takes and held to the chain's max_transaction_cpu_usage: push_action bills
+   // a fixed DEFAULT_BILLED_CPU_TIME_US without checking the limit
+   signed_transaction trx;
+   trx.actions.emplace_back(get_action(postoken_c.get_contract_name(), name,
+                                       vector<permission_level>{{signer, config::active_name}}, data));
+   set_transaction_headers(trx);
+   trx.sign(get_private_key(signer, "active"), control->get_chain_id());
+   auto trace = push_transaction(trx, fc::time_point::maximum(), 0);
+   produce_block();
+   BOOST_REQUIRE(trace->receipt);
+   bench_result res{ trace->receipt->cpu_usage_us, trace->elapsed.count() };
+
+   std::function<void(const action_trace&)> collect = [&](const action_trace& at) {
+      parse_db_stats(at.console, res.db_stats);
+      for( const auto& inline_trace : at.inline_traces )
+         collect(inline_trace);
+   };
+   for( const auto& at : trace->action_traces )
+      collect(at);
+   return res;
+}
+
+void postoken_bench_tester::fill_transfer_ins(account_name from, account_name to, const asset& quantity,
+                                              uint32_t count) {
+   const uint32_t batch = 50;
+   for( uint32_t i = 0; i < count; i += batch ) {
+      signed_transaction trx;
+      for( uint32_t j = i; j < std::min(count, i + batch); j++ ) {
+         trx.actions.emplace_back(get_action(postoken_c.get_contract_name(), N(transfer),
+                                  vector<permission_level>{{from, config::active_name}},
+                                  mvo()("from", from)("to", to)("quantity", quantity)
+                                       ("memo", std::to_string(j))));
+      }
+      set_transaction_headers(trx);
+      trx.sign(get_private_key(from, "active"), control->get_chain_id());
+      push_transaction(trx);
+      produce_block();
+   }
+}
+
+void postoken_bench_tester::set_stake_spec(const symbol& sym, uint32_t start_time, uint16_t min_coin_age,
+                                           uint16_t max_coin_age,
+                                           const std::vector<mutable_variant_object>& interests) {
+   auto st = postoken_c.get_stats_row(sym);
+   BOOST_REQUIRE(st.valid());
+   REQUIRE_SUCCESS(postoken_c.push_action(st->issuer, N(setstakespec),
+                   mvo()("stake_start_time", start_time)
+                        ("min_coin_age", min_coin_age)
+                        ("max_coin_age", max_coin_age)
+                        ("anual_interests", interests)) );
+}
+
+std::string postoken_bench_tester::runtime_name() const {
+   return fc::variant(control->get_config().wasm_runtime).as_string();
+}
+
+void postoken_bench_tester::report(const std::string& scenario, uint32_t rows,
+                                   const std::vector<bench_result>& samples) const {
+   BOOST_REQUIRE(!samples.empty());
+   std::vector<uint32_t> billed;
+   for( const auto& s : samples )
+      billed.push_back(s.billed_us);
+   std::sort(billed.begin(), billed.end());
+   int64_t elapsed = 0;
+   for( const auto& s : samples )
+      elapsed += s.elapsed_us;
+
+   std::cout << "BENCH runtime=" << runtime_name() << " scenario=" << scenario << " rows=" << rows
+             << " samples=" << samples.size() << " billed_us_median=" << billed[billed.size() / 2]
+             << " billed_us_max=" << billed.back() << " elapsed_us_avg=" << elapsed / (int64_t)samples.size();
+   // DB access counts do not depend on the runtime, so the first sample is representative
+   for( const auto& stat : samples.front().db_stats )
+      std::cout << " db_" << stat.first << "=" << stat.second;
+   std::cout << std::endl;
+}
+
+void postoken_bench_tester::parse_db_stats(const std::string& console, std::map<std::string, uint32_t>& stats) {
+   std::istringstream lines(console);
+   std::string line;
+   while( std::getline(lines, line) ) {
+      std::istringstream words(line);
+      std::string word;
+      if( !(words >> word) || word != "DBSTATS" )
+         continue;
+      while( words >> word ) {
+         auto eq = word.find('=');
+         if( eq != std::string::npos )
+            stats[word.substr(0, eq)] += std::stoul(word.substr(eq + 1));
+      }
+   }
+}
+
+postoken_dbstats_tester::postoken_dbstats_tester()
+   : postoken_bench_tester(contracts::postoken_dbstats_wasm, contracts::postoken_dbstats_abi) {
+}
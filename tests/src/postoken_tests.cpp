@@ -44,7 +44,7 @@ BOOST_FIXTURE_TEST_CASE(transfer_ins_tests, postoken_tester) try {
    account_name issuer = postoken_c.get_contract_name();
    // Check if issuer does not have any transfer ins (since he didn't issue to himself and his balance is 0)
    REQUIRE_MATCHING_OBJECT(postoken_c.get_account(issuer, "4,TOK"),
-                           mvo()("balance", asset_str("0.0000 TOK")) );
+                           mvo()("balance", asset_str("0.0000 TOK"))("first_in", LAST_BLOCK_EPOCH_TIME()) );
    BOOST_CHECK_EQUAL(postoken_c.get_entry_count(issuer, N(transferins)), 0);
    produce_blocks(2);
    std::cout << LAST_BLOCK_EPOCH_TIME() << std::endl;
@@ -54,7 +54,7 @@ BOOST_FIXTURE_TEST_CASE(transfer_ins_tests, postoken_tester) try {
                    mvo()("from", "acca")("to", "accb")("quantity", asset_str("10.0000 TOK"))
                         ("memo", "")) );
    REQUIRE_MATCHING_OBJECT(postoken_c.get_account(N(accb), "4,TOK"),
-                         mvo()("balance", asset_str("20.0000 TOK")) );
+                         mvo()("balance", asset_str("20.0000 TOK"))("first_in", accb_issue_time) );
    CHECK_MATCHING_OBJECT(postoken_c.get_transfer_in(N(accb), 0),
                          mvo()("quantity", asset_str("10.0000 TOK"))
                               ("time", accb_issue_time)("id", 0) );   // previous block_time
@@ -100,6 +100,37 @@ BOOST_FIXTURE_TEST_CASE(transfer_ins_tests, postoken_tester) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE(typed_table_readers, postoken_issued_tester) try {
+   symbol s(4, "TOK");
+
+   for( int i = 0; i < 5; i++ ) {
+      produce_block();
+      REQUIRE_SUCCESS(postoken_c.push_action(N(accb), N(transfer),
+                      mvo()("from", "accb")("to", "acca")("quantity", asset_str("1.0000 TOK"))
+                           ("memo", "")) );
+   }
+
+   auto summary = postoken_c.get_transfer_in_summary(N(acca));
+   BOOST_REQUIRE_EQUAL(summary.size(), 1);
+   BOOST_CHECK_EQUAL(summary[s].count, 6);
+   BOOST_CHECK_EQUAL(summary[s].total, 150000);
+   BOOST_CHECK_EQUAL(summary[s].newest, LAST_BLOCK_EPOCH_TIME());
+
+   auto rows = postoken_c.get_transfer_ins(N(acca));
+   BOOST_REQUIRE_EQUAL(rows.size(), 6);
+   for( const auto& tr : rows ) {
+      CHECK_MATCHING_OBJECT(postoken_c.get_transfer_in(N(acca), tr.id),
+                            mvo()("id", tr.id)("quantity", tr.quantity)("time", tr.time) );
+   }
+
+   auto st = postoken_c.get_stats_row(s);
+   BOOST_REQUIRE(st.valid());
+   BOOST_CHECK_EQUAL(st->supply, asset_str("40.0000 TOK"));
+   BOOST_CHECK_EQUAL(postoken_c.get_total_balance(s), st->supply);
+   BOOST_CHECK_EQUAL(postoken_c.get_balances(s).at(N(accb)), asset_str("5.0000 TOK"));
+
+} FC_LOG_AND_RETHROW()
+
 typedef asset interest_t;
 
 BOOST_FIXTURE_TEST_CASE(mint_tests, postoken_issued_tester) try {
@@ -131,7 +162,7 @@ BOOST_FIXTURE_TEST_CASE(mint_tests, postoken_issued_tester) try {
    CHECK_SUCCESS(postoken_c.push_action(N(acca), N(mint),
                  mvo()("account", "acca")("sym_code", sym_code)) );
    CHECK_MATCHING_OBJECT(postoken_c.get_account(N(acca), "4,TOK"),
-                         mvo()("balance", asset_str("10.0273 TOK")) );
+                         mvo()("balance", asset_str("10.0273 TOK"))("first_in", LAST_BLOCK_EPOCH_TIME()) );
    CHECK_MATCHING_OBJECT(postoken_c.get_transfer_in(N(acca), 0),
                          mvo()("id", 0)("time", LAST_BLOCK_EPOCH_TIME())
                               ("quantity", asset_str("10.0273 TOK")) );
@@ -146,7 +177,7 @@ BOOST_FIXTURE_TEST_CASE(mint_tests, postoken_issued_tester) try {
    CHECK_SUCCESS(postoken_c.push_action(N(acca), N(mint),
                  mvo()("account", "acca")("sym_code", sym_code)) );
    CHECK_MATCHING_OBJECT(postoken_c.get_account(N(acca), "4,TOK"),
-                         mvo()("balance", asset_str("15.1645 TOK")) );
+                         mvo()("balance", asset_str("15.1645 TOK"))("first_in", LAST_BLOCK_EPOCH_TIME()) );
    CHECK_MATCHING_OBJECT(postoken_c.get_transfer_in(N(acca), 0),
                          mvo()("id", 0)("time", LAST_BLOCK_EPOCH_TIME())
                               ("quantity", asset_str("15.1645 TOK")) );
@@ -155,7 +186,7 @@ BOOST_FIXTURE_TEST_CASE(mint_tests, postoken_issued_tester) try {
    CHECK_SUCCESS(postoken_c.push_action(N(accb), N(mint),
                  mvo()("account", "accb")("sym_code", sym_code)) );
    CHECK_MATCHING_OBJECT(postoken_c.get_account(N(accb), "4,TOK"),
-                         mvo()("balance", asset_str("5.0410 TOK")) );
+                         mvo()("balance", asset_str("5.0410 TOK"))("first_in", LAST_BLOCK_EPOCH_TIME()) );
    CHECK_MATCHING_OBJECT(postoken_c.get_transfer_in(N(accb), 0),
                          mvo()("id", 0)("time", LAST_BLOCK_EPOCH_TIME())
                               ("quantity", asset_str("5.0410 TOK")) );
@@ -187,7 +218,7 @@ BOOST_FIXTURE_TEST_CASE(variable_interest_rates, postoken_issued_tester) try {
    CHECK_SUCCESS(postoken_c.push_action(N(acca), N(mint),
                  mvo()("account", "acca")("sym_code", sym_code)) );
    CHECK_MATCHING_OBJECT(postoken_c.get_account(N(acca), "4,TOK"),
-                         mvo()("balance", asset_str("10.5479 TOK")) );
+                         mvo()("balance", asset_str("10.5479 TOK"))("first_in", LAST_BLOCK_EPOCH_TIME()) );
    CHECK_MATCHING_OBJECT(postoken_c.get_transfer_in(N(acca), 0),
                          mvo()("id", 0)("time", LAST_BLOCK_EPOCH_TIME())
                               ("quantity", asset_str("10.5479 TOK")) );
@@ -198,7 +229,7 @@ BOOST_FIXTURE_TEST_CASE(variable_interest_rates, postoken_issued_tester) try {
    CHECK_SUCCESS(postoken_c.push_action(N(acca), N(mint),
                  mvo()("account", "acca")("sym_code", sym_code)) );
    CHECK_MATCHING_OBJECT(postoken_c.get_account(N(acca), "4,TOK"),
-                         mvo()("balance", asset_str("10.6345 TOK")) );
+                         mvo()("balance", asset_str("10.6345 TOK"))("first_in", LAST_BLOCK_EPOCH_TIME()) );
    CHECK_MATCHING_OBJECT(postoken_c.get_transfer_in(N(acca), 0),
                          mvo()("id", 0)("time", LAST_BLOCK_EPOCH_TIME())
                               ("quantity", asset_str("10.6345 TOK")) );
@@ -208,20 +239,20 @@ BOOST_FIXTURE_TEST_CASE(variable_interest_rates, postoken_issued_tester) try {
    CHECK_SUCCESS(postoken_c.push_action(N(acca), N(mint),
                  mvo()("account", "acca")("sym_code", sym_code)) );
    CHECK_MATCHING_OBJECT(postoken_c.get_account(N(acca), "4,TOK"),
-                         mvo()("balance", asset_str("10.7219 TOK")) );
+                         mvo()("balance", asset_str("10.7219 TOK"))("first_in", LAST_BLOCK_EPOCH_TIME()) );
 
    // The final interest rate
    produce_block(fc::microseconds(to_epoch_time(29) * (uint64_t)1000000));
    CHECK_SUCCESS(postoken_c.push_action(N(acca), N(mint),
                  mvo()("account", "acca")("sym_code", sym_code)) );
    CHECK_MATCHING_OBJECT(postoken_c.get_account(N(acca), "4,TOK"),
-                         mvo()("balance", asset_str("10.7304 TOK")) );
+                         mvo()("balance", asset_str("10.7304 TOK"))("first_in", LAST_BLOCK_EPOCH_TIME()) );
 
    produce_block(fc::microseconds(to_epoch_time(730) * (uint64_t)1000000));
    CHECK_SUCCESS(postoken_c.push_action(N(acca), N(mint),
                  mvo()("account", "acca")("sym_code", sym_code)) );
    CHECK_MATCHING_OBJECT(postoken_c.get_account(N(acca), "4,TOK"),
-                         mvo()("balance", asset_str("10.7392 TOK")) );
+                         mvo()("balance", asset_str("10.7392 TOK"))("first_in", LAST_BLOCK_EPOCH_TIME()) );
             
 } FC_LOG_AND_RETHROW()
 
@@ -311,7 +342,7 @@ BOOST_FIXTURE_TEST_CASE(coin_age_parameters, postoken_issued_tester) try {
    CHECK_SUCCESS(postoken_c.push_action(N(acca), N(mint),
                  mvo()("account", "acca")("sym_code", sym_code)) );
    CHECK_MATCHING_OBJECT(postoken_c.get_account(N(acca), "4,TOK"),
-                         mvo()("balance", asset_str("10.0410 TOK")) );
+                         mvo()("balance", asset_str("10.0410 TOK"))("first_in", LAST_BLOCK_EPOCH_TIME()) );
    CHECK_MATCHING_OBJECT(postoken_c.get_transfer_in(N(acca), 0),
                          mvo()("id", 0)("time", LAST_BLOCK_EPOCH_TIME())
                               ("quantity", asset_str("10.0410 TOK")) );
@@ -325,11 +356,720 @@ BOOST_FIXTURE_TEST_CASE(coin_age_parameters, postoken_issued_tester) try {
    CHECK_SUCCESS(postoken_c.push_action(N(acca), N(mint),
                  mvo()("account", "acca")("sym_code", sym_code)) );
    CHECK_MATCHING_OBJECT(postoken_c.get_account(N(acca), "4,TOK"),
-                         mvo()("balance", asset_str("19.3986 TOK")) );
+                         mvo()("balance", asset_str("19.3986 TOK"))("first_in", LAST_BLOCK_EPOCH_TIME()) );
 
             
 } FC_LOG_AND_RETHROW()
 
+BOOST_FIXTURE_TEST_CASE(event_log, postoken_issued_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   symbol s(4, "TOK");
+
+   // Issue creates issuer's transfer in, which is then consolidated by the transfer to acca
+   auto events = postoken_c.push_action_events(issuer, N(issue),
+                                               mvo()("to", "acca")("quantity", asset_str("5.0000 TOK"))("memo", ""));
+   BOOST_REQUIRE_EQUAL(events.size(), 2);
+   CHECK_MATCHING_OBJECT(mvo()("version", 1)("type", 0)("account", issuer)
+                         ("quantity", asset_str("5.0000 TOK"))("erased", 0)
+                         ("new_quantity", asset_str("5.0000 TOK")), events[0] );
+   CHECK_MATCHING_OBJECT(mvo()("version", 1)("type", 3)("account", issuer)
+                         ("quantity", asset_str("-5.0000 TOK"))("erased", 1)
+                         ("new_quantity", asset_str("0.0000 TOK")), events[1] );
+
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setstakespec),
+                   mvo()("stake_start_time", LAST_BLOCK_EPOCH_TIME() + 1)
+                        ("min_coin_age", 1)("max_coin_age", 60)
+                        ("anual_interests", std::vector<mutable_variant_object>{
+                           mvo()("years", 0)("interest_rate", asset_str("0.1000 TOK")) })) );
+   produce_block(fc::microseconds(to_epoch_time(20) * (uint64_t)1000000));
+
+   // Mint event carries the reward and the consolidated transfer in
+   auto balance = postoken_c.get_balances(s).at(N(acca));
+   events = postoken_c.push_action_events(N(acca), N(mint), mvo()("account", "acca")("sym_code", s.to_symbol_code()));
+   BOOST_REQUIRE_EQUAL(events.size(), 1);
+   auto reward = events[0]["quantity"].as<asset>();
+   BOOST_CHECK(reward.get_amount() > 0);
+   CHECK_MATCHING_OBJECT(mvo()("version", 1)("type", 2)("account", "acca")("erased", 2)
+                         ("new_quantity", balance + reward), events[0] );
+   auto rows = postoken_c.get_transfer_ins(N(acca));
+   BOOST_REQUIRE_EQUAL(rows.size(), 1);
+   BOOST_CHECK_EQUAL(rows[0].id, events[0]["new_id"].as_uint64());
+   BOOST_CHECK_EQUAL(rows[0].time, events[0]["time"].as_uint64());
+   BOOST_CHECK_EQUAL(postoken_c.get_stats_row(s)->supply, asset_str("45.0000 TOK") + reward);
+
+   // Retire reports negative supply delta followed by issuer's consolidation
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(issue),
+                   mvo()("to", issuer)("quantity", asset_str("2.0000 TOK"))("memo", "")) );
+   events = postoken_c.push_action_events(issuer, N(retire), mvo()("quantity", asset_str("1.0000 TOK"))("memo", ""));
+   BOOST_REQUIRE_EQUAL(events.size(), 2);
+   CHECK_MATCHING_OBJECT(mvo()("type", 1)("quantity", asset_str("-1.0000 TOK")), events[0] );
+   CHECK_MATCHING_OBJECT(mvo()("type", 3)("account", issuer)("quantity", asset_str("-1.0000 TOK"))
+                         ("erased", 1)("new_quantity", asset_str("1.0000 TOK")), events[1] );
+
+} FC_LOG_AND_RETHROW()
+
+// Aggregates row has to match what scanning all scopes gives
+static void check_aggregates(postoken_contract& c, const symbol& s) {
+   asset total(0, s);
+   unsigned __int128 weighted = 0;
+   uint64_t holders = 0;
+   for( const auto& b : c.get_balances(s) ) {
+      holders += b.second.get_amount() > 0;
+      for( const auto& tr : c.get_transfer_ins(b.first) ) {
+         total += tr.quantity;
+         weighted += (unsigned __int128)tr.quantity.get_amount() * tr.time;
+      }
+   }
+   auto agg = c.get_aggregate_row(s);
+   BOOST_REQUIRE(agg.valid());
+   BOOST_CHECK_EQUAL(agg->total_balance, total);
+   BOOST_CHECK_EQUAL(agg->total_balance, c.get_stats_row(s)->supply);
+   BOOST_CHECK(agg->weighted_time() == weighted);
+   BOOST_CHECK_EQUAL(agg->holders, holders);
+}
+
+BOOST_FIXTURE_TEST_CASE(aggregates, postoken_issued_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   symbol s(4, "TOK");
+   auto check_aggregates = [&]() { ::check_aggregates(postoken_c, s); };
+   check_aggregates();
+   BOOST_CHECK_EQUAL(postoken_c.get_aggregate_row(s)->holders, 4);
+
+   // Holder count follows balances which become zero or non-zero
+   produce_block();
+   REQUIRE_SUCCESS(postoken_c.push_action(N(accd), N(transfer),
+                   mvo()("from", "accd")("to", "acce")("quantity", asset_str("10.0000 TOK"))("memo", "")) );
+   check_aggregates();
+   REQUIRE_SUCCESS(postoken_c.push_action(N(acce), N(transfer),
+                   mvo()("from", "acce")("to", "accf")("quantity", asset_str("4.0000 TOK"))("memo", "")) );
+   check_aggregates();
+   BOOST_CHECK_EQUAL(postoken_c.get_aggregate_row(s)->holders, 5);
+
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setstakespec),
+                   mvo()("stake_start_time", LAST_BLOCK_EPOCH_TIME() + 1)
+                        ("min_coin_age", 1)("max_coin_age", 60)
+                        ("anual_interests", std::vector<mutable_variant_object>{
+                           mvo()("years", 0)("interest_rate", asset_str("0.1000 TOK")) })) );
+   produce_block(fc::microseconds(to_epoch_time(20) * (uint64_t)1000000));
+   REQUIRE_SUCCESS(postoken_c.push_action(N(acca), N(mint), mvo()("account", "acca")("sym_code", s.to_symbol_code())));
+   check_aggregates();
+
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(issue),
+                   mvo()("to", issuer)("quantity", asset_str("2.0000 TOK"))("memo", "")) );
+   check_aggregates();
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(retire), mvo()("quantity", asset_str("2.0000 TOK"))("memo", "")));
+   check_aggregates();
+
+} FC_LOG_AND_RETHROW()
+
+// Token of an earlier contract version, without aggregates row: balances change without it and
+// initagg builds it from every holder's rows
+BOOST_FIXTURE_TEST_CASE(aggregates_backfill, postoken_issued_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   symbol s(4, "TOK");
+   const uint64_t sym_code = s.to_symbol_code().value;
+   {
+      auto& db = control->mutable_db();
+      const auto* t = db.find<table_id_object, by_code_scope_table>(boost::make_tuple(issuer, name(sym_code), N(aggregates)));
+      BOOST_REQUIRE(t);
+      db.remove(db.get<key_value_object, by_scope_primary>(boost::make_tuple(t->id, sym_code)));
+      db.modify(*t, [](table_id_object& o) { --o.count; });
+   }
+   produce_block();
+   BOOST_REQUIRE(!postoken_c.get_aggregate_row(s).valid());
+
+   REQUIRE_SUCCESS(postoken_c.push_action(N(acca), N(transfer),
+                   mvo()("from", "acca")("to", "acce")("quantity", asset_str("2.5000 TOK"))("memo", "")) );
+   BOOST_CHECK(!postoken_c.get_aggregate_row(s).valid());
+
+   std::vector<account_name> owners{ N(acca), N(accb), N(accc), N(accd), N(acce) };
+   BOOST_CHECK(postoken_c.push_action(N(acca), N(initagg), mvo()("sym_code", "TOK")("owners", owners)) != success());
+   CHECK_ASSERT_MSG(postoken_c.push_action(issuer, N(initagg),
+                    mvo()("sym_code", "TOK")("owners", std::vector<account_name>(owners.begin(), owners.end() - 1))),
+                    "balances of owners don't add up to supply");
+   CHECK_ASSERT_MSG(postoken_c.push_action(issuer, N(initagg),
+                    mvo()("sym_code", "TOK")("owners", std::vector<account_name>{ N(accb), N(acca) })),
+                    "owners have to be sorted and unique");
+   CHECK_ASSERT_MSG(postoken_c.push_action(issuer, N(initagg),
+                    mvo()("sym_code", "TOK")("owners", std::vector<account_name>{ N(acca), N(accf) })),
+                    "no balance object found");
+
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(initagg), mvo()("sym_code", "TOK")("owners", owners)));
+   check_aggregates(postoken_c, s);
+   BOOST_CHECK_EQUAL(postoken_c.get_aggregate_row(s)->holders, 5);
+   CHECK_ASSERT_MSG(postoken_c.push_action(issuer, N(initagg), mvo()("sym_code", "TOK")("owners", owners)),
+                    "Aggregates row already exists");
+
+   // Kept up to date from then on
+   produce_block();
+   REQUIRE_SUCCESS(postoken_c.push_action(N(acce), N(transfer),
+                   mvo()("from", "acce")("to", "accb")("quantity", asset_str("2.5000 TOK"))("memo", "")) );
+   check_aggregates(postoken_c, s);
+   BOOST_CHECK_EQUAL(postoken_c.get_aggregate_row(s)->holders, 4);
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(holder_registry, postoken_issued_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   symbol s(4, "TOK");
+   typedef std::vector<std::pair<account_name, asset>> holder_list;
+   auto top = [&](size_t limit) {
+      holder_list res;
+      for( const auto& h : postoken_c.get_top_holders(s, limit) )
+         res.emplace_back(h.owner, h.balance);
+      return res;
+   };
+
+   // Registry is off by default
+   REQUIRE_SUCCESS(postoken_c.push_action(N(acca), N(transfer),
+                   mvo()("from", "acca")("to", "accb")("quantity", asset_str("1.0000 TOK"))("memo", "")) );
+   BOOST_CHECK(top(10).empty());
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(acca), N(regholder),
+                    mvo()("owner", "acca")("sym_code", "TOK")("ram_payer", "acca")),
+                    "Holder registry is not enabled for this token");
+
+   BOOST_CHECK_EQUAL(postoken_c.push_action(N(acca), N(setoptions), mvo()("sym_code", "TOK")("options", 1)),
+                     auth_error(issuer));
+   CHECK_ASSERT_MSG(postoken_c.push_action(issuer, N(setoptions), mvo()("sym_code", "TOK")("options", 0x80)),
+                    "unknown option");
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setoptions), mvo()("sym_code", "TOK")("options", 1)));
+
+   // Balances changed from now on are registered, others can be added with regholder
+   REQUIRE_SUCCESS(postoken_c.push_action(N(accc), N(transfer),
+                   mvo()("from", "accc")("to", "acce")("quantity", asset_str("10.0000 TOK"))("memo", "")) );
+   BOOST_CHECK(top(10) == (holder_list{ { N(acce), asset_str("10.0000 TOK") },
+                                        { N(accc), asset_str("0.0000 TOK") } }));
+   for( account_name acc : { N(acca), N(accb), N(accd) } ) {
+      REQUIRE_SUCCESS(postoken_c.push_action(acc, N(regholder),
+                      mvo()("owner", acc)("sym_code", "TOK")("ram_payer", acc)) );
+   }
+   BOOST_CHECK(top(3) == (holder_list{ { N(accb), asset_str("11.0000 TOK") },
+                                       { N(accd), asset_str("10.0000 TOK") },
+                                       { N(acce), asset_str("10.0000 TOK") } }));
+
+   REQUIRE_SUCCESS(postoken_c.push_action(N(accb), N(transfer),
+                   mvo()("from", "accb")("to", "acca")("quantity", asset_str("5.0000 TOK"))("memo", "")) );
+   BOOST_CHECK(top(10) == (holder_list{ { N(acca), asset_str("14.0000 TOK") },
+                                        { N(accd), asset_str("10.0000 TOK") },
+                                        { N(acce), asset_str("10.0000 TOK") },
+                                        { N(accb), asset_str("6.0000 TOK") },
+                                        { N(accc), asset_str("0.0000 TOK") } }));
+
+   // Closed account leaves the registry
+   REQUIRE_SUCCESS(postoken_c.push_action(N(accc), N(close), mvo()("owner", "accc")("symbol", "4,TOK")));
+   BOOST_CHECK_EQUAL(top(10).size(), 4);
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(mint_early_out, postoken_issued_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   symbol_code sym_code = symbol(4, "TOK").to_symbol_code();
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setstakespec),
+                   mvo()("stake_start_time", LAST_BLOCK_EPOCH_TIME() + 1)
+                        ("min_coin_age", 5)("max_coin_age", 60)
+                        ("anual_interests", std::vector<mutable_variant_object>{
+                           mvo()("years", 0)("interest_rate", asset_str("0.1000 TOK")) })) );
+   produce_block(fc::microseconds(to_epoch_time(1) * (uint64_t)1000000));
+
+   // First transfer in of a balance sets first_in, so does the consolidation of sender's transfer ins
+   REQUIRE_SUCCESS(postoken_c.push_action(N(accb), N(transfer),
+                   mvo()("from", "accb")("to", "acce")("quantity", asset_str("4.0000 TOK"))("memo", "")) );
+   auto first_in = LAST_BLOCK_EPOCH_TIME();
+   CHECK_MATCHING_OBJECT(mvo()("balance", asset_str("4.0000 TOK"))("first_in", first_in),
+                         postoken_c.get_account(N(acce), "4,TOK") );
+   CHECK_MATCHING_OBJECT(mvo()("balance", asset_str("6.0000 TOK"))("first_in", first_in),
+                         postoken_c.get_account(N(accb), "4,TOK") );
+
+   // Later transfer ins don't change it
+   produce_block(fc::microseconds(to_epoch_time(3) * (uint64_t)1000000));
+   REQUIRE_SUCCESS(postoken_c.push_action(N(accd), N(transfer),
+                   mvo()("from", "accd")("to", "acce")("quantity", asset_str("1.0000 TOK"))("memo", "")) );
+   CHECK_MATCHING_OBJECT(mvo()("balance", asset_str("5.0000 TOK"))("first_in", first_in),
+                         postoken_c.get_account(N(acce), "4,TOK") );
+
+   // Oldest transfer in is younger than min_coin_age
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(acce), N(mint), mvo()("account", "acce")("sym_code", sym_code)),
+                    "Nothing to claim");
+
+   // Only the first transfer in has reached min_coin_age, mint resets first_in
+   produce_block(fc::microseconds(to_epoch_time(3) * (uint64_t)1000000));
+   CHECK_SUCCESS(postoken_c.push_action(N(acce), N(mint), mvo()("account", "acce")("sym_code", sym_code)) );
+   CHECK_MATCHING_OBJECT(mvo()("balance", asset_str("5.0065 TOK"))("first_in", LAST_BLOCK_EPOCH_TIME()),
+                         postoken_c.get_account(N(acce), "4,TOK") );
+   BOOST_CHECK_EQUAL(postoken_c.get_entry_count(N(acce), N(transferins)), 1);
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(acce), N(mint), mvo()("account", "acce")("sym_code", sym_code)),
+                    "Nothing to claim");
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(xfer_tests, postoken_issued_tester) try {
+   account_name contract = postoken_c.get_contract_name();
+   symbol s(4, "TOK");
+   auto xfer = [&](account_name from, account_name to, int64_t amount) {
+      return postoken_c.push_action(from, N(xfer), mvo()("from", from)("to", to)("amount", amount));
+   };
+
+   CHECK_ASSERT_MSG(xfer(N(acca), N(accb), 10000), "default symbol is not set");
+   BOOST_CHECK_EQUAL(postoken_c.push_action(N(acca), N(setdefsym), mvo()("sym_code", "TOK")),
+                     auth_error(contract));
+   CHECK_ASSERT_MSG(postoken_c.push_action(contract, N(setdefsym), mvo()("sym_code", "NOP")),
+                    "Token with this symbol does not exist");
+   REQUIRE_SUCCESS(postoken_c.push_action(contract, N(setdefsym), mvo()("sym_code", "TOK")));
+
+   // Same balance and transfer in changes as transfer
+   REQUIRE_SUCCESS(xfer(N(acca), N(accb), 25000));
+   auto balances = postoken_c.get_balances(s);
+   BOOST_CHECK_EQUAL(balances[N(acca)], asset_str("7.5000 TOK"));
+   BOOST_CHECK_EQUAL(balances[N(accb)], asset_str("12.5000 TOK"));
+   auto summary = postoken_c.get_transfer_in_summary(N(accb))[s];
+   BOOST_CHECK_EQUAL(summary.count, 2);
+   BOOST_CHECK_EQUAL(summary.total, 125000);
+
+   CHECK_ASSERT_MSG(xfer(N(acca), N(accb), 0), "must transfer positive quantity");
+   CHECK_ASSERT_MSG(xfer(N(acca), N(accb), 75001), "overdrawn balance");
+   CHECK_ASSERT_MSG(xfer(N(acca), N(acca), 1), "cannot transfer to self");
+   BOOST_CHECK_EQUAL(postoken_c.push_action(N(accb), N(xfer), mvo()("from", "acca")("to", "accb")("amount", 1)),
+                     auth_error(N(acca)));
+   // No is_account check, notifying a non-existing account fails the action
+   BOOST_CHECK(xfer(N(acca), N(nonexistent), 1) != base_tester::success());
+
+   // Options set later are followed
+   REQUIRE_SUCCESS(postoken_c.push_action(contract, N(setoptions), mvo()("sym_code", "TOK")("options", 1)));
+   REQUIRE_SUCCESS(xfer(N(accc), N(accd), 10000));
+   BOOST_CHECK_EQUAL(postoken_c.get_top_holders(s, 10).size(), 2);
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(openmany_closemany, postoken_issued_tester) try {
+   symbol s(4, "TOK");
+   std::vector<account_name> owners{ N(acce), N(accf), N(nonexistent) };
+
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(acca), N(openmany),
+                    mvo()("owners", owners)("symbol", "4,NOP")("ram_payer", "acca")),
+                    "symbol does not exist");
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(acca), N(openmany),
+                    mvo()("owners", owners)("symbol", "2,TOK")("ram_payer", "acca")),
+                    "symbol precision mismatch");
+   BOOST_CHECK_EQUAL(postoken_c.push_action(N(acca), N(openmany),
+                     mvo()("owners", owners)("symbol", "4,TOK")("ram_payer", "accb")),
+                     auth_error(N(accb)));
+
+   // Existing rows are left as they are
+   owners.push_back(N(accb));
+   REQUIRE_SUCCESS(postoken_c.push_action(N(acca), N(openmany),
+                   mvo()("owners", owners)("symbol", "4,TOK")("ram_payer", "acca")) );
+   auto balances = postoken_c.get_balances(s);
+   for( account_name owner : { N(acce), N(accf), N(nonexistent) } )
+      BOOST_CHECK_EQUAL(balances.at(owner), asset_str("0.0000 TOK"));
+   BOOST_CHECK_EQUAL(balances.at(N(accb)), asset_str("10.0000 TOK"));
+
+   // Every owner has to sign, all rows have to be empty
+   BOOST_CHECK_EQUAL(postoken_c.push_action(N(acce), N(closemany),
+                     mvo()("owners", std::vector<account_name>{ N(acce), N(accf) })("symbol", "4,TOK")),
+                     auth_error(N(accf)));
+   CHECK_ASSERT_MSG(postoken_c.push_action(std::vector<account_name>{ N(acce), N(accb) }, N(closemany),
+                    mvo()("owners", std::vector<account_name>{ N(acce), N(accb) })("symbol", "4,TOK")),
+                    "Cannot close because the balance is not zero.");
+   REQUIRE_SUCCESS(postoken_c.push_action(std::vector<account_name>{ N(acce), N(accf) }, N(closemany),
+                   mvo()("owners", std::vector<account_name>{ N(acce), N(accf) })("symbol", "4,TOK")) );
+   balances = postoken_c.get_balances(s);
+   BOOST_CHECK_EQUAL(balances.count(N(acce)), 0);
+   BOOST_CHECK_EQUAL(balances.count(N(accf)), 0);
+   BOOST_CHECK_EQUAL(balances.count(N(nonexistent)), 1);
+
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(acce), N(closemany),
+                    mvo()("owners", std::vector<account_name>{ N(acce) })("symbol", "4,TOK")),
+                    "Balance row already deleted or never existed. Action won't have any effect.");
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(compact_tests, postoken_issued_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   symbol s(4, "TOK");
+   auto compact = [&](uint32_t max_rows) {
+      return postoken_c.push_action_events(N(accf), N(compact),
+                                           mvo()("account", "acca")("sym_code", "TOK")("max_rows", max_rows));
+   };
+   auto transfer_to_acca = [&]() {
+      REQUIRE_SUCCESS(postoken_c.push_action(N(accd), N(transfer),
+                      mvo()("from", "accd")("to", "acca")("quantity", asset_str("1.0000 TOK"))("memo", "")) );
+   };
+   auto weighted_time = [&]() {
+      unsigned __int128 weighted = 0;
+      for( const auto& tr : postoken_c.get_transfer_ins(N(acca)) )
+         weighted += (unsigned __int128)tr.quantity.get_amount() * tr.time;
+      return weighted;
+   };
+
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(accf), N(compact),
+                    mvo()("account", "acca")("sym_code", "TOK")("max_rows", 10)), "Stake spec is not set");
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setstakespec),
+                   mvo()("stake_start_time", LAST_BLOCK_EPOCH_TIME() + 1)
+                        ("min_coin_age", 1)("max_coin_age", 10)
+                        ("anual_interests", std::vector<mutable_variant_object>{
+                           mvo()("years", 0)("interest_rate", asset_str("0.1000 TOK")) })) );
+   for( int day = 0; day < 3; day++ ) {
+      transfer_to_acca();
+      produce_block(fc::microseconds(to_epoch_time(1) * (uint64_t)1000000));
+   }
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(accf), N(compact),
+                    mvo()("account", "acca")("sym_code", "TOK")("max_rows", 10)), "Nothing to compact");
+
+   // Issued row and the 3 transfer ins are older than max_coin_age, the last one isn't
+   produce_block(fc::microseconds(to_epoch_time(11) * (uint64_t)1000000));
+   transfer_to_acca();
+   BOOST_CHECK_EQUAL(postoken_c.get_entry_count(N(acca), N(transferins)), 5);
+   auto agg_weighted = postoken_c.get_aggregate_row(s)->weighted_time();
+   auto acca_weighted = weighted_time();
+
+   // Anyone can compact, in steps of max_rows
+   auto events = compact(2);
+   BOOST_REQUIRE_EQUAL(events.size(), 1);
+   CHECK_MATCHING_OBJECT(mvo()("type", 4)("account", "acca")("quantity", asset_str("0.0000 TOK"))("erased", 1)
+                         ("new_quantity", asset_str("11.0000 TOK")), events[0] );
+   BOOST_CHECK_EQUAL(postoken_c.get_entry_count(N(acca), N(transferins)), 4);
+   events = compact(10);
+   BOOST_REQUIRE_EQUAL(events.size(), 1);
+   CHECK_MATCHING_OBJECT(mvo()("type", 4)("erased", 2)("new_quantity", asset_str("13.0000 TOK")), events[0] );
+   auto rows = postoken_c.get_transfer_ins(N(acca));
+   BOOST_REQUIRE_EQUAL(rows.size(), 2);
+   BOOST_CHECK_EQUAL(rows[0].id, events[0]["new_id"].as_uint64());
+   BOOST_CHECK_EQUAL(rows[0].quantity, asset_str("13.0000 TOK"));
+   BOOST_CHECK_EQUAL(rows[1].quantity, asset_str("1.0000 TOK"));
+   BOOST_CHECK_EQUAL(postoken_c.get_balances(s).at(N(acca)), asset_str("14.0000 TOK"));
+   BOOST_CHECK(postoken_c.get_aggregate_row(s)->weighted_time() - agg_weighted == weighted_time() - acca_weighted);
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(accf), N(compact),
+                    mvo()("account", "acca")("sym_code", "TOK")("max_rows", 10)), "Nothing to compact");
+
+   // Same reward as without compaction: (13 * 10 + 1 * 2) coin-days at 10%
+   produce_block(fc::microseconds(to_epoch_time(2) * (uint64_t)1000000));
+   REQUIRE_SUCCESS(postoken_c.push_action(N(acca), N(mint), mvo()("account", "acca")("sym_code", "TOK")));
+   BOOST_CHECK_EQUAL(postoken_c.get_balances(s).at(N(acca)), asset_str("14.0361 TOK"));
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(balance_checkpoints, postoken_issued_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   auto transfer = [&](const string& quantity) {
+      REQUIRE_SUCCESS(postoken_c.push_action(N(acca), N(transfer),
+                      mvo()("from", "acca")("to", "accb")("quantity", asset_str(quantity))("memo", "")) );
+      return LAST_BLOCK_EPOCH_TIME();
+   };
+
+   // Off by default
+   transfer("1.0000 TOK");
+   BOOST_CHECK(postoken_c.get_checkpoints(N(acca)).empty());
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setoptions), mvo()("sym_code", "TOK")("options", 2)));
+   produce_block(fc::microseconds(to_epoch_time(1) * (uint64_t)1000000));
+
+   uint32_t t0 = transfer("1.0000 TOK");
+   auto cps = postoken_c.get_checkpoints(N(acca));
+   BOOST_REQUIRE_EQUAL(cps.size(), 1);
+   BOOST_CHECK_EQUAL(cps[0].balance, asset_str("8.0000 TOK"));
+   BOOST_CHECK_EQUAL(cps[0].time, t0);
+   BOOST_CHECK(cps[0].cumulative() == 0);
+   cps = postoken_c.get_checkpoints(N(accb));
+   BOOST_REQUIRE_EQUAL(cps.size(), 1);
+   BOOST_CHECK_EQUAL(cps[0].balance, asset_str("12.0000 TOK"));
+
+   // A later change of the same day gets its own row and leaves the first one as it is, so the
+   // period between them keeps its balance. Cumulative sum includes the previous balance.
+   produce_blocks(2);
+   uint32_t t1 = transfer("1.0000 TOK");
+   cps = postoken_c.get_checkpoints(N(acca));
+   BOOST_REQUIRE_EQUAL(cps.size(), 2);
+   BOOST_CHECK_EQUAL(cps[0].balance, asset_str("8.0000 TOK"));
+   BOOST_CHECK_EQUAL(cps[0].time, t0);
+   BOOST_CHECK_EQUAL(cps[1].balance, asset_str("7.0000 TOK"));
+   BOOST_CHECK_EQUAL(cps[1].time, t1);
+   BOOST_CHECK(cps[1].cumulative() == (unsigned __int128)80000 * (t1 - t0));
+
+   // So does the next day
+   produce_block(fc::microseconds(to_epoch_time(1) * (uint64_t)1000000));
+   uint32_t t2 = transfer("2.0000 TOK");
+   cps = postoken_c.get_checkpoints(N(acca));
+   BOOST_REQUIRE_EQUAL(cps.size(), 3);
+   BOOST_CHECK_EQUAL(cps[2].balance, asset_str("5.0000 TOK"));
+   BOOST_CHECK_EQUAL(cps[2].time, t2);
+   BOOST_CHECK(cps[2].cumulative() == (unsigned __int128)80000 * (t1 - t0) + (unsigned __int128)70000 * (t2 - t1));
+
+   // Options are independent
+   BOOST_CHECK(postoken_c.get_top_holders(symbol(4, "TOK"), 10).empty());
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(newest_first_debit, postoken_issued_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   symbol s(4, "TOK");
+   auto transfer = [&](account_name from, account_name to, const string& quantity) {
+      return postoken_c.push_action_events(from, N(transfer),
+                                           mvo()("from", from)("to", to)("quantity", asset_str(quantity))("memo", ""));
+   };
+
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setoptions), mvo()("sym_code", "TOK")("options", 4)));
+   transfer(N(accb), N(acca), "3.0000 TOK");
+   transfer(N(accc), N(acca), "2.0000 TOK");
+   auto rows = postoken_c.get_transfer_ins(N(acca));
+   BOOST_REQUIRE_EQUAL(rows.size(), 3);
+   auto first_in = postoken_c.get_account(N(acca), "4,TOK")["first_in"];
+
+   // Newest row is erased, the one before is debited, the oldest one is untouched
+   auto events = transfer(N(acca), N(accd), "4.0000 TOK");
+   BOOST_REQUIRE_EQUAL(events.size(), 1);
+   CHECK_MATCHING_OBJECT(mvo()("type", 5)("account", "acca")("quantity", asset_str("-4.0000 TOK"))("erased", 1)
+                         ("new_id", rows[1].id)("new_quantity", asset_str("1.0000 TOK")), events[0] );
+   auto left = postoken_c.get_transfer_ins(N(acca));
+   BOOST_REQUIRE_EQUAL(left.size(), 2);
+   BOOST_CHECK_EQUAL(left[0].quantity, rows[0].quantity);
+   BOOST_CHECK_EQUAL(left[0].time, rows[0].time);
+   BOOST_CHECK_EQUAL(left[1].quantity, asset_str("1.0000 TOK"));
+   BOOST_CHECK_EQUAL(left[1].time, rows[1].time);
+   CHECK_MATCHING_OBJECT(mvo()("balance", asset_str("11.0000 TOK"))("first_in", first_in),
+                         postoken_c.get_account(N(acca), "4,TOK") );
+
+   // Aggregates follow the debited amounts
+   unsigned __int128 weighted = 0;
+   for( const auto& b : postoken_c.get_balances(s) )
+      for( const auto& tr : postoken_c.get_transfer_ins(b.first) )
+         weighted += (unsigned __int128)tr.quantity.get_amount() * tr.time;
+   BOOST_CHECK(postoken_c.get_aggregate_row(s)->weighted_time() == weighted);
+
+   // Whole balance
+   events = transfer(N(acca), N(accd), "11.0000 TOK");
+   CHECK_MATCHING_OBJECT(mvo()("type", 5)("erased", 2)("new_quantity", asset_str("0.0000 TOK")), events[0] );
+   BOOST_CHECK_EQUAL(postoken_c.get_entry_count(N(acca), N(transferins)), 0);
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(mintall_tests, postoken_issued_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   auto stake_spec = [&](const string& rate) {
+      return mvo()("stake_start_time", LAST_BLOCK_EPOCH_TIME() + 1)("min_coin_age", 1)("max_coin_age", 60)
+                  ("anual_interests", std::vector<mutable_variant_object>{
+                     mvo()("years", 0)("interest_rate", asset_str(rate)) });
+   };
+   // STK earns twice as much as TOK, NOS has no stake spec
+   for( const string& max_supply : { "1000000.0000 STK", "1000000.0000 NOS" } )
+      REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(create),
+                      mvo()("issuer", issuer)("maximum_supply", asset_str(max_supply))) );
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setstakespec), stake_spec("0.1000 TOK")) );
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setstakespec), stake_spec("0.2000 STK")) );
+   produce_block(fc::microseconds(to_epoch_time(1) * (uint64_t)1000000));
+
+   REQUIRE_SUCCESS(postoken_c.push_action(N(accb), N(transfer),
+                   mvo()("from", "accb")("to", "acce")("quantity", asset_str("4.0000 TOK"))("memo", "")) );
+   for( const string& quantity : { "20.0000 STK", "5.0000 NOS" } )
+      REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(issue),
+                      mvo()("to", "acce")("quantity", asset_str(quantity))("memo", "")) );
+   BOOST_CHECK_EQUAL(postoken_c.get_entry_count(N(acce), N(transferins)), 3);
+
+   BOOST_CHECK_EQUAL(postoken_c.push_action(N(acca), N(mintall), mvo()("account", "acce")), auth_error(N(acce)));
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(acce), N(mintall), mvo()("account", "acce")), "Nothing to claim");
+
+   // Same rewards as a mint of each token, NOS is skipped
+   produce_block(fc::microseconds(to_epoch_time(30) * (uint64_t)1000000));
+   auto events = postoken_c.push_action_events(N(acce), N(mintall), mvo()("account", "acce"));
+   BOOST_REQUIRE_EQUAL(events.size(), 2);
+   // Tokens come in symbol index order (symbol_code values, TOK < STK < NOS)
+   CHECK_MATCHING_OBJECT(mvo()("type", 2)("account", "acce")("quantity", asset_str("0.0328 TOK"))("erased", 1)
+                         ("new_quantity", asset_str("4.0328 TOK")), events[0] );
+   CHECK_MATCHING_OBJECT(mvo()("type", 2)("account", "acce")("quantity", asset_str("0.3287 STK"))("erased", 1)
+                         ("new_quantity", asset_str("20.3287 STK")), events[1] );
+   CHECK_MATCHING_OBJECT(mvo()("balance", asset_str("4.0328 TOK"))("first_in", LAST_BLOCK_EPOCH_TIME()),
+                         postoken_c.get_account(N(acce), "4,TOK") );
+   CHECK_MATCHING_OBJECT(mvo()("balance", asset_str("20.3287 STK")), postoken_c.get_account(N(acce), "4,STK") );
+   CHECK_MATCHING_OBJECT(mvo()("balance", asset_str("5.0000 NOS")), postoken_c.get_account(N(acce), "4,NOS") );
+   CHECK_MATCHING_OBJECT(mvo()("supply", asset_str("20.3287 STK")), postoken_c.get_stats("4,STK") );
+
+   auto summary = postoken_c.get_transfer_in_summary(N(acce));
+   BOOST_REQUIRE_EQUAL(summary.size(), 3);
+   for( const auto& s : summary )
+      BOOST_CHECK_EQUAL(s.second.count, 1);
+   BOOST_CHECK_EQUAL(summary[symbol(4, "STK")].total, 203287);
+
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(acce), N(mintall), mvo()("account", "acce")), "Nothing to claim");
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(deferred_supply, postoken_issued_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   symbol_code sym_code = symbol(4, "TOK").to_symbol_code();
+   auto set_pool = [&](const string& shard_budget) {
+      return postoken_c.push_action(issuer, N(setrewardpool),
+                                    mvo()("sym_code", "TOK")("shards", 1)("shard_budget", asset_str(shard_budget)));
+   };
+   auto settle = [&]() {
+      return postoken_c.push_action(N(accf), N(settle), mvo()("sym_code", "TOK"));
+   };
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setstakespec),
+                   mvo()("stake_start_time", LAST_BLOCK_EPOCH_TIME() + 1)
+                        ("min_coin_age", 1)("max_coin_age", 60)
+                        ("anual_interests", std::vector<mutable_variant_object>{
+                           mvo()("years", 0)("interest_rate", asset_str("0.1000 TOK")) })) );
+
+   CHECK_ASSERT_MSG(postoken_c.push_action(issuer, N(setoptions), mvo()("sym_code", "TOK")("options", 8)),
+                    "Reward pool is not set");
+   BOOST_CHECK_EQUAL(postoken_c.push_action(N(acca), N(setrewardpool),
+                     mvo()("sym_code", "TOK")("shards", 1)("shard_budget", asset_str("1.0000 TOK"))),
+                     auth_error(issuer));
+   CHECK_ASSERT_MSG(settle(), "Deferred supply is not enabled for this token");
+   REQUIRE_SUCCESS(set_pool("1.0000 TOK"));
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setoptions), mvo()("sym_code", "TOK")("options", 8)));
+
+   // Budget is allocated from max_supply by settle, issue can't use it
+   REQUIRE_SUCCESS(settle());
+   CHECK_MATCHING_OBJECT(mvo()("budget", asset_str("1.0000 TOK"))("pending", asset_str("0.0000 TOK")),
+                         postoken_c.get_reward_shard("4,TOK", 0) );
+   CHECK_ASSERT_MSG(postoken_c.push_action(issuer, N(issue),
+                    mvo()("to", "acca")("quantity", asset_str("999959.0001 TOK"))("memo", "")),
+                    "quantity exceeds available supply");
+
+   // Mint takes the reward from the budget, supply is left as it is until settle
+   produce_block(fc::microseconds(to_epoch_time(1) * (uint64_t)1000000));
+   REQUIRE_SUCCESS(postoken_c.push_action(N(accb), N(transfer),
+                   mvo()("from", "accb")("to", "acce")("quantity", asset_str("4.0000 TOK"))("memo", "")) );
+   produce_block(fc::microseconds(to_epoch_time(30) * (uint64_t)1000000));
+   CHECK_SUCCESS(postoken_c.push_action(N(acce), N(mint), mvo()("account", "acce")("sym_code", sym_code)) );
+   CHECK_MATCHING_OBJECT(mvo()("balance", asset_str("4.0328 TOK")), postoken_c.get_account(N(acce), "4,TOK") );
+   CHECK_MATCHING_OBJECT(mvo()("supply", asset_str("40.0000 TOK")), postoken_c.get_stats("4,TOK") );
+   CHECK_MATCHING_OBJECT(mvo()("budget", asset_str("0.9672 TOK"))("pending", asset_str("0.0328 TOK")),
+                         postoken_c.get_reward_shard("4,TOK", 0) );
+
+   REQUIRE_SUCCESS(settle());
+   CHECK_MATCHING_OBJECT(mvo()("supply", asset_str("40.0328 TOK")), postoken_c.get_stats("4,TOK") );
+   CHECK_MATCHING_OBJECT(mvo()("budget", asset_str("1.0000 TOK"))("pending", asset_str("0.0000 TOK")),
+                         postoken_c.get_reward_shard("4,TOK", 0) );
+
+   // Lower budget is applied by settle, rewards above it are added to supply directly
+   REQUIRE_SUCCESS(set_pool("0.0100 TOK"));
+   REQUIRE_SUCCESS(settle());
+   CHECK_SUCCESS(postoken_c.push_action(N(accb), N(mint), mvo()("account", "accb")("sym_code", sym_code)) );
+   CHECK_MATCHING_OBJECT(mvo()("balance", asset_str("6.0493 TOK")), postoken_c.get_account(N(accb), "4,TOK") );
+   CHECK_MATCHING_OBJECT(mvo()("budget", asset_str("0.0000 TOK"))("pending", asset_str("0.0100 TOK")),
+                         postoken_c.get_reward_shard("4,TOK", 0) );
+   CHECK_MATCHING_OBJECT(mvo()("supply", asset_str("40.0721 TOK")), postoken_c.get_stats("4,TOK") );
+
+   // Option can only be turned off once the budget is released
+   CHECK_ASSERT_MSG(postoken_c.push_action(issuer, N(setoptions), mvo()("sym_code", "TOK")("options", 0)),
+                    "Reward pool has reserved supply, release it first");
+   REQUIRE_SUCCESS(set_pool("0.0000 TOK"));
+   REQUIRE_SUCCESS(settle());
+   CHECK_MATCHING_OBJECT(mvo()("supply", asset_str("40.0821 TOK")), postoken_c.get_stats("4,TOK") );
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setoptions), mvo()("sym_code", "TOK")("options", 0)));
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE(sub_ledger, postoken_issued_tester) try {
+   account_name issuer = postoken_c.get_contract_name();
+   symbol_code sym_code = symbol(4, "TOK").to_symbol_code();
+   auto deposit = [&](uint64_t sub, const string& quantity) {
+      return postoken_c.push_action(N(acca), N(subdeposit),
+                                    mvo()("custodian", "acca")("sub", sub)("quantity", asset_str(quantity)));
+   };
+   auto withdraw = [&](uint64_t sub, const string& quantity) {
+      return postoken_c.push_action(N(acca), N(subwithdraw),
+                                    mvo()("custodian", "acca")("sub", sub)("quantity", asset_str(quantity)));
+   };
+   auto move = [&](uint64_t from, uint64_t to, const string& quantity) {
+      return postoken_c.push_action(N(acca), N(submove),
+                                    mvo()("custodian", "acca")("from", from)("to", to)("quantity", asset_str(quantity)));
+   };
+   REQUIRE_SUCCESS(postoken_c.push_action(issuer, N(setstakespec),
+                   mvo()("stake_start_time", LAST_BLOCK_EPOCH_TIME() + 1)
+                        ("min_coin_age", 1)("max_coin_age", 60)
+                        ("anual_interests", std::vector<mutable_variant_object>{
+                           mvo()("years", 0)("interest_rate", asset_str("0.1000 TOK")) })) );
+   produce_block(fc::microseconds(to_epoch_time(1) * (uint64_t)1000000));
+
+   // Sub-accounts can have at most the custodian's balance
+   BOOST_CHECK_EQUAL(postoken_c.push_action(N(accb), N(subdeposit),
+                     mvo()("custodian", "acca")("sub", 1)("quantity", asset_str("1.0000 TOK"))),
+                     auth_error(N(acca)));
+   CHECK_ASSERT_MSG(deposit(1, "10.0001 TOK"), "quantity exceeds unallocated balance");
+   REQUIRE_SUCCESS(deposit(1, "4.0000 TOK"));
+   // Creating the sub-ledger restarts coin age of the custodian's balance
+   CHECK_MATCHING_OBJECT(postoken_c.get_account(N(acca), "4,TOK"),
+                         mvo()("balance", asset_str("10.0000 TOK"))("first_in", LAST_BLOCK_EPOCH_TIME()) );
+   CHECK_MATCHING_OBJECT(mvo()("id", 1)("balance", asset_str("4.0000 TOK"))("time", LAST_BLOCK_EPOCH_TIME()),
+                         postoken_c.get_sub_account(N(acca), 1) );
+   REQUIRE_SUCCESS(deposit(2, "6.0000 TOK"));
+   CHECK_ASSERT_MSG(deposit(3, "0.0001 TOK"), "quantity exceeds unallocated balance");
+   CHECK_MATCHING_OBJECT(mvo()("allocated", asset_str("10.0000 TOK"))("unsettled", asset_str("0.0000 TOK")),
+                         postoken_c.get_sub_ledger(N(acca), "4,TOK") );
+   auto deposited = postoken_c.get_sub_accounts(N(acca));
+
+   // Allocated part of the balance can't leave with a transfer
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(acca), N(transfer),
+                    mvo()("from", "acca")("to", "accb")("quantity", asset_str("0.0001 TOK"))("memo", "")),
+                    "quantity exceeds unallocated balance");
+
+   // Custodian's balance earns through its sub-accounts only
+   produce_block(fc::microseconds(to_epoch_time(30) * (uint64_t)1000000));
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(acca), N(mint), mvo()("account", "acca")("sym_code", sym_code)),
+                    "Balance has a sub-ledger, use submint");
+
+   // Moves change the two rows only, credit keeps coin-days at the weighted time
+   CHECK_ASSERT_MSG(move(1, 1, "1.0000 TOK"), "cannot move to self");
+   CHECK_ASSERT_MSG(move(3, 1, "1.0000 TOK"), "no sub-account found");
+   CHECK_ASSERT_MSG(move(2, 1, "6.0001 TOK"), "overdrawn sub-account");
+   auto events = postoken_c.push_action_events(N(acca), N(submove),
+                                               mvo()("custodian", "acca")("from", 2)("to", 1)("quantity", asset_str("1.0000 TOK")));
+   BOOST_CHECK_EQUAL(events.size(), 0);
+   uint32_t moved_at = LAST_BLOCK_EPOCH_TIME();
+   auto subs = postoken_c.get_sub_accounts(N(acca));
+   BOOST_CHECK_EQUAL(subs[1].balance, asset_str("5.0000 TOK"));
+   BOOST_CHECK_EQUAL(subs[1].time, uint32_t((4 * uint64_t(deposited[1].time) + moved_at) / 5));
+   BOOST_CHECK_EQUAL(subs[2].balance, asset_str("5.0000 TOK"));
+   BOOST_CHECK_EQUAL(subs[2].time, deposited[2].time);
+   BOOST_CHECK_EQUAL(postoken_c.get_entry_count(N(acca), N(transferins)), 1);
+
+   // Each sub-account earns like a balance with one transfer in (24 and 30 days), supply is updated
+   // right away and the custodian's balance by subsettle
+   events = postoken_c.push_action_events(N(acca), N(submint), mvo()("custodian", "acca")("subs", std::vector<uint64_t>{ 1, 2 }));
+   BOOST_REQUIRE_EQUAL(events.size(), 2);
+   CHECK_MATCHING_OBJECT(mvo()("type", 6)("account", "acca")("quantity", asset_str("0.0328 TOK"))("new_id", 1)
+                         ("new_quantity", asset_str("5.0328 TOK")), events[0] );
+   CHECK_MATCHING_OBJECT(mvo()("type", 6)("account", "acca")("quantity", asset_str("0.0410 TOK"))("new_id", 2)
+                         ("new_quantity", asset_str("5.0410 TOK")), events[1] );
+   CHECK_MATCHING_OBJECT(mvo()("supply", asset_str("40.0738 TOK")), postoken_c.get_stats("4,TOK") );
+   CHECK_MATCHING_OBJECT(mvo()("balance", asset_str("10.0000 TOK")), postoken_c.get_account(N(acca), "4,TOK") );
+   CHECK_MATCHING_OBJECT(mvo()("allocated", asset_str("10.0000 TOK"))("unsettled", asset_str("0.0738 TOK")),
+                         postoken_c.get_sub_ledger(N(acca), "4,TOK") );
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(acca), N(submint), mvo()("custodian", "acca")("subs", std::vector<uint64_t>{ 1 })),
+                    "Nothing to claim");
+
+   // Rewards have to be settled before they can be withdrawn
+   REQUIRE_SUCCESS(withdraw(1, "5.0328 TOK"));
+   BOOST_CHECK(postoken_c.get_sub_account(N(acca), 1).is_null());
+   CHECK_ASSERT_MSG(withdraw(2, "5.0410 TOK"), "quantity exceeds allocated balance, subsettle first");
+
+   BOOST_CHECK_EQUAL(postoken_c.push_action(N(accb), N(subsettle), mvo()("custodian", "acca")("sym_code", sym_code)),
+                     auth_error(N(acca)));
+   events = postoken_c.push_action_events(N(acca), N(subsettle), mvo()("custodian", "acca")("sym_code", sym_code));
+   BOOST_REQUIRE_EQUAL(events.size(), 1);
+   CHECK_MATCHING_OBJECT(mvo()("type", 7)("account", "acca")("quantity", asset_str("0.0738 TOK"))
+                         ("new_quantity", asset_str("0.0738 TOK")), events[0] );
+   CHECK_MATCHING_OBJECT(mvo()("balance", asset_str("10.0738 TOK")), postoken_c.get_account(N(acca), "4,TOK") );
+   CHECK_MATCHING_OBJECT(mvo()("supply", asset_str("40.0738 TOK")), postoken_c.get_stats("4,TOK") );
+   BOOST_CHECK_EQUAL(postoken_c.get_total_balance(symbol(4, "TOK")), asset_str("40.0738 TOK"));
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(acca), N(subsettle), mvo()("custodian", "acca")("sym_code", sym_code)),
+                    "Nothing to settle");
+
+   // Once every sub-account is empty the sub-ledger is gone and the balance is minted again, for the
+   // time after the withdraw only: sub-accounts were paid for the time before
+   REQUIRE_SUCCESS(withdraw(2, "5.0410 TOK"));
+   BOOST_CHECK(postoken_c.get_sub_ledger(N(acca), "4,TOK").is_null());
+   CHECK_MATCHING_OBJECT(postoken_c.get_account(N(acca), "4,TOK"),
+                         mvo()("balance", asset_str("10.0738 TOK"))("first_in", LAST_BLOCK_EPOCH_TIME()) );
+   BOOST_CHECK_EQUAL(postoken_c.get_entry_count(N(acca), N(transferins)), 1);
+   CHECK_ASSERT_MSG(postoken_c.push_action(N(acca), N(mint), mvo()("account", "acca")("sym_code", sym_code)),
+                    "Nothing to claim");
+   produce_block(fc::microseconds(to_epoch_time(2) * (uint64_t)1000000));
+   REQUIRE_SUCCESS(postoken_c.push_action(N(acca), N(mint), mvo()("account", "acca")("sym_code", sym_code)) );
+   CHECK_MATCHING_OBJECT(mvo()("balance", asset_str("10.0793 TOK")), postoken_c.get_account(N(acca), "4,TOK") );
+
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END() // postoken_tests
 
 
@@ -0,0 +1,133 @@
+// postoken-extract: reads stat, accounts, transferins and subledgers rows of every holder straight from
+// a nodeos portable snapshot (memory mapped, read-only) and writes them as a columnar file
+// (postoken/columnar.hpp), without going through the RPC API.
+//
+// A chainbase state directory can't be read this way: shared_memory.bin is a boost::interprocess
+// image whose layout depends on the nodeos build. Take a snapshot of it instead
+// (producer_api create_snapshot, or nodeos started with the state directory and --snapshot).
+
+#include <postoken/columnar.hpp>
+#include <postoken/mapped_file.hpp>
+#include <postoken/snapshot.hpp>
+#include <postoken/state_dump.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+#include <sys/stat.h>
+
+using namespace postoken;
+
+namespace {
+
+struct extract_stats {
+   uint64_t stats        = 0;
+   uint64_t balances     = 0;
+   uint64_t transfer_ins = 0;
+   uint64_t sub_ledgers  = 0;
+   uint64_t other        = 0; // rows of tables this tool doesn't know
+};
+
+void extract(const char* data, size_t size, uint64_t contract, columnar_table& out, extract_stats& stats) {
+   const uint64_t n_stat        = string_to_name("stat");
+   const uint64_t n_accounts    = string_to_name("accounts");
+   const uint64_t n_transferins = string_to_name("transferins");
+   const uint64_t n_subledgers  = string_to_name("subledgers");
+
+   read_snapshot_contract_rows(data, size, contract, [&](const snapshot_table& t, const snapshot_kv_row& r) {
+      // Fields appended to rows later (binary extensions) are ignored, except the token's options
+      datastream ds(r.value, r.size);
+      if( t.table == n_transferins ) {
+         out.add_transfer_in(t.scope, ds.read_transfer_in());
+         stats.transfer_ins++;
+      } else if( t.table == n_accounts ) {
+         out.add_balance(t.scope, ds.read_asset());
+         stats.balances++;
+      } else if( t.table == n_subledgers ) {
+         out.add_sub_ledger(t.scope, ds.read_asset());
+         stats.sub_ledgers++;
+      } else if( t.table == n_stat ) {
+         out.stats.push_back(ds.read_currency_stats());
+         if( ds.remaining() >= sizeof(uint32_t) )
+            out.stats.back().options = ds.read_raw<uint32_t>();
+         stats.stats++;
+      } else {
+         stats.other++;
+      }
+   });
+}
+
+bool is_directory(const std::string& path) {
+   struct stat st;
+   return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+void print_help() {
+   std::cout << "Usage:    postoken-extract [OPTIONS] SNAPSHOT OUTPUT\n"
+             << "Extracts postoken tables from a nodeos portable snapshot into a columnar file.\n"
+             << "  --contract NAME  account the contract is deployed to (default: postoken)\n"
+             << "  --dump FILE      also write the rows as a text dump ('-' for stdout), see postoken-replay --verify\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+   std::string contract = "postoken", dump_path;
+   std::vector<std::string> paths;
+   for( int i = 1; i < argc; i++ ) {
+      std::string arg = argv[i];
+      if( arg == "-h" || arg == "--help" ) {
+         print_help();
+         return 0;
+      } else if( arg == "--contract" && i + 1 < argc ) {
+         contract = argv[++i];
+      } else if( arg == "--dump" && i + 1 < argc ) {
+         dump_path = argv[++i];
+      } else {
+         paths.push_back(arg);
+      }
+   }
+   if( paths.size() != 2 ) {
+      print_help();
+      return 1;
+   }
+
+   try {
+      if( is_directory(paths[0]) )
+         throw std::runtime_error(paths[0] + " is a directory: chainbase state can't be read portably, "
+                                  "create a snapshot of it with producer_api create_snapshot");
+
+      auto start = std::chrono::steady_clock::now();
+      mapped_file snapshot(paths[0]);
+      columnar_table table;
+      extract_stats stats;
+      extract(snapshot.data, snapshot.size, string_to_name(contract), table, stats);
+
+      std::ofstream out(paths[1], std::ios::binary);
+      if( !out )
+         throw std::runtime_error("cannot open " + paths[1]);
+      table.write(out);
+      out.close();
+      if( !out )
+         throw std::runtime_error("cannot write " + paths[1]);
+      double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      std::cerr << "extracted " << stats.stats << " stat, " << stats.balances << " accounts, "
+                << stats.transfer_ins << " transferins and " << stats.sub_ledgers << " subledgers rows (" << stats.other << " other rows skipped) in "
+                << secs << " s\n";
+
+      if( !dump_path.empty() ) {
+         // Read back what was written, so the dump also checks the columnar file
+         std::ofstream file;
+         std::ostream& dump = dump_path == "-" ? std::cout : (file.open(dump_path), file);
+         mapped_file columns(paths[1]);
+         for( const auto& line : dump_lines(columnar_view(columns.data, columns.size)) )
+            dump << line << "\n";
+      }
+      return 0;
+   } catch( const std::exception& e ) {
+      std::cerr << "error: " << e.what() << std::endl;
+      return 1;
+   }
+}
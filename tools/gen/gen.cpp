@@ -0,0 +1,162 @@
+// postoken-gen: writes synthetic postoken chain state (stat, accounts and transferins rows) of a
+// parametric holder population (postoken/population.hpp) as a columnar file, the format
+// postoken-extract writes for real chains. Offline tools read it directly, tests load it into
+// a tester chain with postoken_tester::load_state.
+//
+// nodeos can't start from it: a portable snapshot also needs every other chain table
+// (accounts, permissions, resource limits, ...) consistent with the rows.
+
+#include <postoken/population.hpp>
+#include <postoken/mapped_file.hpp>
+#include <postoken/state_dump.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+using namespace postoken;
+
+namespace {
+
+std::vector<std::string> split(const std::string& s, char sep) {
+   std::vector<std::string> parts;
+   std::stringstream ss(s);
+   std::string part;
+   while( std::getline(ss, part, sep) )
+      parts.push_back(part);
+   return parts;
+}
+
+// "0.10/1,0.05/0" (rate as a fraction / years of each tier)
+std::vector<std::pair<double, uint16_t>> parse_interests(const std::string& s) {
+   std::vector<std::pair<double, uint16_t>> v;
+   for( const auto& tier : split(s, ',') ) {
+      auto slash = tier.find('/');
+      check(slash != std::string::npos, "interest tier has to be RATE/YEARS");
+      v.emplace_back(std::stod(tier.substr(0, slash)), (uint16_t)std::stoul(tier.substr(slash + 1)));
+   }
+   return v;
+}
+
+// Totals and transfer ins per balance (median, 99th percentile and maximum)
+void report(const population_config& cfg, const columnar_table& t, double secs) {
+   std::map<std::pair<uint64_t, uint64_t>, uint32_t> counts; // (owner, symbol) -> rows
+   for( size_t i = 0; i < t.size(); i++ ) {
+      if( t.kind[i] == transfer_in_row )
+         counts[{ t.owner[i], t.symbol[i] }]++;
+   }
+   std::vector<uint32_t> rows;
+   rows.reserve(counts.size());
+   for( const auto& c : counts )
+      rows.push_back(c.second);
+   std::sort(rows.begin(), rows.end());
+
+   std::cerr << "generated " << cfg.holders << " holders, " << rows.size() << " balances and "
+             << t.size() - rows.size() << " transfer ins in " << secs << " s\n";
+   if( !rows.empty() ) {
+      std::cerr << "transfer ins per balance: median " << rows[rows.size() / 2] << ", p99 "
+                << rows[std::min(rows.size() - 1, rows.size() * 99 / 100)] << ", max " << rows.back() << "\n";
+   }
+   for( const auto& st : t.stats )
+      std::cerr << dump_stat_line(st) << "\n";
+}
+
+void print_help() {
+   std::cout << "Usage:    postoken-gen [OPTIONS] OUTPUT\n"
+             << "Writes synthetic postoken state of a holder population as a columnar file.\n"
+             << "  --holders N              number of holders (default: 1000000)\n"
+             << "  --symbol SYM             token as PRECISION,CODE, repeat for more (default: 4,POSA 4,POSB 6,POSC)\n"
+             << "  --extra-symbol-share P   probability of holding each symbol after the first (default: 0.3)\n"
+             << "  --balance-median X       median balance in tokens (default: 1000)\n"
+             << "  --balance-sigma X        sigma of the log-normal balances (default: 2)\n"
+             << "  --rows-alpha X           tail index of transfer ins per balance, lower is heavier (default: 1.2)\n"
+             << "  --max-rows N             most transfer ins of a balance (default: 10000)\n"
+             << "  --time EPOCH             newest transfer in time (default: 1577836800, the tester's genesis)\n"
+             << "  --history-days N         oldest transfer ins are this old, staking starts then (default: 730)\n"
+             << "  --issuer NAME            issuer of the tokens (default: postoken)\n"
+             << "  --max-supply-factor X    max_supply as a multiple of supply (default: 10)\n"
+             << "  --min-coin-age DAYS      (default: 3)\n"
+             << "  --max-coin-age DAYS      (default: 90)\n"
+             << "  --interests TIERS        anual_interests as RATE/YEARS,... with rates as fractions (default: 0.10/1,0.05/0)\n"
+             << "  --seed N                 (default: 1)\n"
+             << "  --threads N              (default: all cores)\n"
+             << "  --dump FILE              also write the rows as a text dump ('-' for stdout)\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+   population_config cfg;
+   unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+   std::string dump_path, out_path;
+   std::vector<symbol> symbols;
+
+   try {
+      for( int i = 1; i < argc; i++ ) {
+         std::string arg = argv[i];
+         auto next = [&]() -> std::string {
+            check(i + 1 < argc, "missing option value");
+            return argv[++i];
+         };
+         if( arg == "-h" || arg == "--help" ) {
+            print_help();
+            return 0;
+         }
+         else if( arg == "--holders" )            cfg.holders = std::stoul(next());
+         else if( arg == "--symbol" )             symbols.push_back(string_to_symbol(next()));
+         else if( arg == "--extra-symbol-share" ) cfg.extra_symbol_share = std::stod(next());
+         else if( arg == "--balance-median" )     cfg.balance_median = std::stod(next());
+         else if( arg == "--balance-sigma" )      cfg.balance_sigma = std::stod(next());
+         else if( arg == "--rows-alpha" )         cfg.rows_alpha = std::stod(next());
+         else if( arg == "--max-rows" )           cfg.max_rows = std::stoul(next());
+         else if( arg == "--time" )               cfg.time = std::stoul(next());
+         else if( arg == "--history-days" )       cfg.history_days = std::stoul(next());
+         else if( arg == "--issuer" )             cfg.issuer = string_to_name(next());
+         else if( arg == "--max-supply-factor" )  cfg.max_supply_factor = std::stod(next());
+         else if( arg == "--min-coin-age" )       cfg.min_coin_age = (uint16_t)std::stoul(next());
+         else if( arg == "--max-coin-age" )       cfg.max_coin_age = (uint16_t)std::stoul(next());
+         else if( arg == "--interests" )          cfg.interests = parse_interests(next());
+         else if( arg == "--seed" )               cfg.seed = std::stoull(next());
+         else if( arg == "--threads" )            threads = std::max(1ul, std::stoul(next()));
+         else if( arg == "--dump" )               dump_path = next();
+         else if( out_path.empty() )              out_path = arg;
+         else {
+            print_help();
+            return 1;
+         }
+      }
+      if( out_path.empty() ) {
+         print_help();
+         return 1;
+      }
+      if( !symbols.empty() )
+         cfg.symbols = symbols;
+      check(cfg.time > cfg.history_days * 86400, "history_days reaches before 1970");
+      check(cfg.min_coin_age <= cfg.max_coin_age && cfg.max_coin_age > 0, "invalid coin ages");
+
+      auto start = std::chrono::steady_clock::now();
+      columnar_table table = generate_population(cfg, threads);
+      std::ofstream out(out_path, std::ios::binary);
+      if( !out )
+         throw std::runtime_error("cannot open " + out_path);
+      table.write(out);
+      out.close();
+      if( !out )
+         throw std::runtime_error("cannot write " + out_path);
+      report(cfg, table, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+      if( !dump_path.empty() ) {
+         std::ofstream file;
+         std::ostream& dump = dump_path == "-" ? std::cout : (file.open(dump_path), file);
+         mapped_file columns(out_path);
+         for( const auto& line : dump_lines(columnar_view(columns.data, columns.size)) )
+            dump << line << "\n";
+      }
+      return 0;
+   } catch( const std::exception& e ) {
+      std::cerr << "error: " << e.what() << std::endl;
+      return 1;
+   }
+}
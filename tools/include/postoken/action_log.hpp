@@ -0,0 +1,59 @@
+#pragma once
+
+// Binary postoken action log:
+//   "PTALOG1\0" followed by records of
+//   uint32 block time (epoch seconds), uint64 action name, varuint32 size, packed action data
+
+#include <postoken/datastream.hpp>
+
+#include <ostream>
+
+namespace postoken {
+
+static const char action_log_magic[8] = { 'P', 'T', 'A', 'L', 'O', 'G', '1', '\0' };
+
+struct action_record {
+   timestamp_t time;
+   uint64_t    name;
+   const char* data;
+   uint32_t    size;
+};
+
+inline bool is_action_log(const char* data, size_t size) {
+   return size >= sizeof(action_log_magic) && memcmp(data, action_log_magic, sizeof(action_log_magic)) == 0;
+}
+
+// Calls f(record) for every record of the log
+template<typename F>
+void read_action_log(const char* data, size_t size, F&& f) {
+   check(is_action_log(data, size), "not a postoken action log");
+   datastream ds(data + sizeof(action_log_magic), size - sizeof(action_log_magic));
+   while( ds.remaining() ) {
+      action_record r;
+      r.time = ds.read_raw<uint32_t>();
+      r.name = ds.read_raw<uint64_t>();
+      r.size = ds.read_varuint32();
+      r.data = ds.pos();
+      ds.skip(r.size);
+      f(r);
+   }
+}
+
+inline void write_action_log_header(std::ostream& out) {
+   out.write(action_log_magic, sizeof(action_log_magic));
+}
+
+inline void write_action_record(std::ostream& out, timestamp_t time, uint64_t name, const char* data, uint32_t size) {
+   out.write((const char*)&time, sizeof(time));
+   out.write((const char*)&name, sizeof(name));
+   uint32_t v = size;
+   do {
+      uint8_t b = v & 0x7f;
+      v >>= 7;
+      b |= (v > 0) << 7;
+      out.put(b);
+   } while( v );
+   out.write(data, size);
+}
+
+}
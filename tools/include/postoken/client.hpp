@@ -0,0 +1,471 @@
+#pragma once
+
+// Client library for services which talk to the postoken contract natively, without JSON or
+// fc::variant:
+//  - action structs with the contract's action signatures, packed into a reused vector or a
+//    fixed buffer (no allocation)
+//  - decoding of accounts, transferins and stat rows (with their binary extensions) in place
+//  - what mint would issue, with the contract's checks, arithmetic and error messages
+// Packing is checked against the contract's ABI by native_rules_tests.
+
+#include <postoken/datastream.hpp>
+
+namespace postoken {
+
+// eosio name of a literal, usable in constant expressions
+constexpr uint64_t name_literal(const char* s) {
+   uint64_t v = 0;
+   int i = 0;
+   for( ; s[i] && i < 12; i++ ) {
+      char c = s[i];
+      uint64_t x = c >= 'a' && c <= 'z' ? c - 'a' + 6 : c >= '1' && c <= '5' ? c - '1' + 1 : 0;
+      v |= (x & 0x1f) << (64 - 5 * (i + 1));
+   }
+   if( i == 12 && s[12] ) {
+      char c = s[12];
+      uint64_t x = c >= 'a' && c <= 'z' ? c - 'a' + 6 : c >= '1' && c <= '5' ? c - '1' + 1 : 0;
+      v |= x & 0x0f;
+   }
+   return v;
+}
+
+// Non-owning views of action arguments, so actions can be packed from any storage
+struct string_ref {
+   const char* data = "";
+   size_t      size = 0;
+
+   string_ref() = default;
+   string_ref(const char* s) : data(s), size(strlen(s)) {}
+   string_ref(const char* s, size_t n) : data(s), size(n) {}
+   string_ref(const std::string& s) : data(s.data()), size(s.size()) {}
+};
+
+template<typename T>
+struct array_ref {
+   const T* data = nullptr;
+   size_t   size = 0;
+
+   array_ref() = default;
+   array_ref(const T* d, size_t n) : data(d), size(n) {}
+   array_ref(const std::vector<T>& v) : data(v.data()), size(v.size()) {}
+};
+
+// Actions. Member order is the order of the action's arguments.
+
+struct create_action {
+   static constexpr uint64_t name() { return name_literal("create"); }
+   uint64_t issuer;
+   asset    maximum_supply;
+
+   template<typename W> void pack(W& w) const { w.write_raw(issuer); w.write_asset(maximum_supply); }
+};
+
+struct issue_action {
+   static constexpr uint64_t name() { return name_literal("issue"); }
+   uint64_t   to;
+   asset      quantity;
+   string_ref memo;
+
+   template<typename W> void pack(W& w) const {
+      w.write_raw(to);
+      w.write_asset(quantity);
+      w.write_string(memo.data, memo.size);
+   }
+};
+
+struct retire_action {
+   static constexpr uint64_t name() { return name_literal("retire"); }
+   asset      quantity;
+   string_ref memo;
+
+   template<typename W> void pack(W& w) const { w.write_asset(quantity); w.write_string(memo.data, memo.size); }
+};
+
+struct transfer_action {
+   static constexpr uint64_t name() { return name_literal("transfer"); }
+   uint64_t   from;
+   uint64_t   to;
+   asset      quantity;
+   string_ref memo;
+
+   template<typename W> void pack(W& w) const {
+      w.write_raw(from);
+      w.write_raw(to);
+      w.write_asset(quantity);
+      w.write_string(memo.data, memo.size);
+   }
+};
+
+struct xfer_action {
+   static constexpr uint64_t name() { return name_literal("xfer"); }
+   uint64_t from;
+   uint64_t to;
+   int64_t  amount;
+
+   template<typename W> void pack(W& w) const { w.write_raw(from); w.write_raw(to); w.write_raw(amount); }
+};
+
+struct setdefsym_action {
+   static constexpr uint64_t name() { return name_literal("setdefsym"); }
+   uint64_t sym_code;
+
+   template<typename W> void pack(W& w) const { w.write_raw(sym_code); }
+};
+
+struct open_action {
+   static constexpr uint64_t name() { return name_literal("open"); }
+   uint64_t owner;
+   symbol   sym;
+   uint64_t ram_payer;
+
+   template<typename W> void pack(W& w) const { w.write_raw(owner); w.write_symbol(sym); w.write_raw(ram_payer); }
+};
+
+struct close_action {
+   static constexpr uint64_t name() { return name_literal("close"); }
+   uint64_t owner;
+   symbol   sym;
+
+   template<typename W> void pack(W& w) const { w.write_raw(owner); w.write_symbol(sym); }
+};
+
+struct openmany_action {
+   static constexpr uint64_t name() { return name_literal("openmany"); }
+   array_ref<uint64_t> owners;
+   symbol              sym;
+   uint64_t            ram_payer;
+
+   template<typename W> void pack(W& w) const {
+      w.write_names(owners.data, owners.size);
+      w.write_symbol(sym);
+      w.write_raw(ram_payer);
+   }
+};
+
+struct closemany_action {
+   static constexpr uint64_t name() { return name_literal("closemany"); }
+   array_ref<uint64_t> owners;
+   symbol              sym;
+
+   template<typename W> void pack(W& w) const { w.write_names(owners.data, owners.size); w.write_symbol(sym); }
+};
+
+struct setstakespec_action {
+   static constexpr uint64_t name() { return name_literal("setstakespec"); }
+   timestamp_t           stake_start_time;
+   uint16_t              min_coin_age;
+   uint16_t              max_coin_age;
+   array_ref<interest_t> anual_interests;
+
+   template<typename W> void pack(W& w) const {
+      w.write_raw(stake_start_time);
+      w.write_raw(min_coin_age);
+      w.write_raw(max_coin_age);
+      w.write_interests(anual_interests.data, anual_interests.size);
+   }
+};
+
+struct mint_action {
+   static constexpr uint64_t name() { return name_literal("mint"); }
+   uint64_t account;
+   uint64_t sym_code;
+
+   template<typename W> void pack(W& w) const { w.write_raw(account); w.write_raw(sym_code); }
+};
+
+struct mintall_action {
+   static constexpr uint64_t name() { return name_literal("mintall"); }
+   uint64_t account;
+
+   template<typename W> void pack(W& w) const { w.write_raw(account); }
+};
+
+struct compact_action {
+   static constexpr uint64_t name() { return name_literal("compact"); }
+   uint64_t account;
+   uint64_t sym_code;
+   uint32_t max_rows;
+
+   template<typename W> void pack(W& w) const { w.write_raw(account); w.write_raw(sym_code); w.write_raw(max_rows); }
+};
+
+struct setoptions_action {
+   static constexpr uint64_t name() { return name_literal("setoptions"); }
+   uint64_t sym_code;
+   uint32_t options; // token_option bits
+
+   template<typename W> void pack(W& w) const { w.write_raw(sym_code); w.write_raw(options); }
+};
+
+struct setrewardpool_action {
+   static constexpr uint64_t name() { return name_literal("setrewardpool"); }
+   uint64_t sym_code;
+   uint16_t shards;
+   asset    shard_budget;
+
+   template<typename W> void pack(W& w) const { w.write_raw(sym_code); w.write_raw(shards); w.write_asset(shard_budget); }
+};
+
+struct settle_action {
+   static constexpr uint64_t name() { return name_literal("settle"); }
+   uint64_t sym_code;
+
+   template<typename W> void pack(W& w) const { w.write_raw(sym_code); }
+};
+
+struct regholder_action {
+   static constexpr uint64_t name() { return name_literal("regholder"); }
+   uint64_t owner;
+   uint64_t sym_code;
+   uint64_t ram_payer;
+
+   template<typename W> void pack(W& w) const { w.write_raw(owner); w.write_raw(sym_code); w.write_raw(ram_payer); }
+};
+
+struct initagg_action {
+   static constexpr uint64_t name() { return name_literal("initagg"); }
+   uint64_t            sym_code;
+   array_ref<uint64_t> owners;
+
+   template<typename W> void pack(W& w) const { w.write_raw(sym_code); w.write_names(owners.data, owners.size); }
+};
+
+struct subdeposit_action {
+   static constexpr uint64_t name() { return name_literal("subdeposit"); }
+   uint64_t custodian;
+   uint64_t sub;
+   asset    quantity;
+
+   template<typename W> void pack(W& w) const { w.write_raw(custodian); w.write_raw(sub); w.write_asset(quantity); }
+};
+
+struct subwithdraw_action {
+   static constexpr uint64_t name() { return name_literal("subwithdraw"); }
+   uint64_t custodian;
+   uint64_t sub;
+   asset    quantity;
+
+   template<typename W> void pack(W& w) const { w.write_raw(custodian); w.write_raw(sub); w.write_asset(quantity); }
+};
+
+struct submove_action {
+   static constexpr uint64_t name() { return name_literal("submove"); }
+   uint64_t custodian;
+   uint64_t from;
+   uint64_t to;
+   asset    quantity;
+
+   template<typename W> void pack(W& w) const {
+      w.write_raw(custodian);
+      w.write_raw(from);
+      w.write_raw(to);
+      w.write_asset(quantity);
+   }
+};
+
+struct submint_action {
+   static constexpr uint64_t name() { return name_literal("submint"); }
+   uint64_t            custodian;
+   array_ref<uint64_t> subs;
+
+   // vector<uint64_t> is packed like vector<name>
+   template<typename W> void pack(W& w) const { w.write_raw(custodian); w.write_names(subs.data, subs.size); }
+};
+
+struct subsettle_action {
+   static constexpr uint64_t name() { return name_literal("subsettle"); }
+   uint64_t custodian;
+   uint64_t sym_code;
+
+   template<typename W> void pack(W& w) const { w.write_raw(custodian); w.write_raw(sym_code); }
+};
+
+// Action data appended to out (which can be reused between calls)
+template<typename Action>
+void pack_action(const Action& a, std::vector<char>& out) {
+   datastream_writer w(out);
+   a.pack(w);
+}
+
+template<typename Action>
+std::vector<char> pack_action(const Action& a) {
+   std::vector<char> out;
+   pack_action(a, out);
+   return out;
+}
+
+// Action data written to buf, returns its size. Throws rules_error if it doesn't fit.
+template<typename Action>
+size_t pack_action(const Action& a, char* buf, size_t capacity) {
+   buffer_writer w(buf, capacity);
+   a.pack(w);
+   return w.size();
+}
+
+// Table rows
+
+// accounts row
+struct account_row {
+   asset       balance;
+   bool        has_first_in = false; // rows of earlier contract versions may not have it
+   timestamp_t first_in     = 0;
+};
+
+inline account_row decode_account(const char* data, size_t size) {
+   datastream ds(data, size);
+   account_row r;
+   r.balance = ds.read_asset();
+   if( ds.remaining() ) {
+      r.has_first_in = true;
+      r.first_in     = ds.read_raw<timestamp_t>();
+   }
+   return r;
+}
+
+// transferins row
+inline transfer_in decode_transfer_in(const char* data, size_t size) {
+   datastream ds(data, size);
+   return ds.read_transfer_in();
+}
+
+// postoken::reward_pool_spec
+struct reward_pool_spec {
+   uint16_t shards       = 0;
+   int64_t  shard_budget = 0;
+   int64_t  reserved     = 0;
+};
+
+// anual_interests of a stat row, decoded while iterated
+class interest_range {
+public:
+   static constexpr size_t packed_size = sizeof(int64_t) + sizeof(uint64_t) + sizeof(uint16_t);
+
+   class iterator {
+   public:
+      explicit iterator(const char* p) : _p(p) {}
+      interest_t operator*() const {
+         datastream ds(_p, packed_size);
+         return ds.read_interest();
+      }
+      iterator& operator++() { _p += packed_size; return *this; }
+      bool operator!=(const iterator& o) const { return _p != o._p; }
+      bool operator==(const iterator& o) const { return _p == o._p; }
+
+   private:
+      const char* _p;
+   };
+
+   interest_range() = default;
+   interest_range(const char* data, uint32_t count) : _data(data), _count(count) {}
+
+   size_t     size() const { return _count; }
+   iterator   begin() const { return iterator(_data); }
+   iterator   end() const { return iterator(_data + _count * packed_size); }
+   interest_t operator[](size_t i) const { return *iterator(_data + i * packed_size); }
+
+private:
+   const char* _data  = nullptr;
+   uint32_t    _count = 0;
+};
+
+// stat row, referencing the row's data for anual_interests (the data has to outlive the view).
+// Members are named as in currency_stats, so the rules' templates take either.
+struct currency_stats_view {
+   asset            supply;
+   asset            max_supply;
+   uint64_t         issuer           = 0;
+   uint16_t         min_coin_age     = 0;
+   uint16_t         max_coin_age     = 0;
+   interest_range   anual_interests;
+   timestamp_t      stake_start_time = 0;
+   uint32_t         options          = 0; // binary extensions, 0 when the row doesn't have them
+   bool             has_pool         = false;
+   reward_pool_spec pool;
+
+   currency_stats_view(const char* data, size_t size) {
+      datastream ds(data, size);
+      supply       = ds.read_asset();
+      max_supply   = ds.read_asset();
+      issuer       = ds.read_raw<uint64_t>();
+      min_coin_age = ds.read_raw<uint16_t>();
+      max_coin_age = ds.read_raw<uint16_t>();
+      uint32_t count = ds.read_varuint32();
+      check(count <= ds.remaining() / interest_range::packed_size, "read datastream over by");
+      anual_interests = interest_range(ds.pos(), count);
+      ds.skip(count * interest_range::packed_size);
+      stake_start_time = ds.read_raw<timestamp_t>();
+      if( ds.remaining() )
+         options = ds.read_raw<uint32_t>();
+      if( ds.remaining() ) {
+         has_pool           = true;
+         pool.shards        = ds.read_raw<uint16_t>();
+         pool.shard_budget  = ds.read_raw<int64_t>();
+         pool.reserved      = ds.read_raw<int64_t>();
+      }
+   }
+
+   bool has_option(token_option o) const { return options & o; }
+};
+
+// Supply issue and mint can still use: neither issued nor reserved by a reward pool
+inline int64_t available_supply(const currency_stats_view& st) {
+   return st.max_supply.amount - st.supply.amount - (st.has_pool ? st.pool.reserved : 0);
+}
+
+inline int64_t available_supply(const currency_stats& st) {
+   return st.max_supply.amount - st.supply.amount;
+}
+
+// postoken::can_claim: whether the balance's oldest transfer in is old enough for mint
+template<typename Stats>
+bool can_claim(const Stats& st, const account_row& acc, timestamp_t curr_time) {
+   if( !acc.has_first_in )
+      return true;
+   uint32_t max_age = epoch_to_days(curr_time - std::max(st.stake_start_time, acc.first_in));
+   return max_age > 0 && max_age >= st.min_coin_age;
+}
+
+// Reward mint(account, sym_code) would issue at curr_time. st is the token's stat row, acc the
+// account's accounts row of the token (nullptr if there is none), has_sub_ledger whether the account
+// has a subledgers row of the token (mint fails, submint pays instead) and transfer_ins its transfer ins of
+// the token in id order (any range of transfer_in, e.g. decoded rows of the symbol index).
+// shard_budget is the budget of the account's rewardpool row (account % shards), used with
+// deferred_supply_option. Throws rules_error with the message mint would fail with.
+template<typename Stats, typename TransferIns>
+asset mint_reward(const Stats& st, const account_row* acc, bool has_sub_ledger, const TransferIns& transfer_ins,
+                  timestamp_t curr_time, int64_t shard_budget = 0) {
+   const symbol sym = st.max_supply.sym;
+   check(st.stake_start_time < curr_time, "Can't mint before stake start time");
+   asset interest_rate = get_interest_rate(st, curr_time);
+   check(interest_rate.amount > 0, "Nothing to claim: 0 interest rate");
+   check(!has_sub_ledger, "Balance has a sub-ledger, use submint");
+   check(acc != nullptr && can_claim(st, *acc, curr_time), "Nothing to claim");
+
+   // The contract walks the symbol index from the first row of the code while the precision matches
+   bool  found = false, stopped = false;
+   asset coin_age(0, sym);
+   for( const transfer_in& tr : transfer_ins ) {
+      if( tr.quantity.sym.code() != sym.code() )
+         continue;
+      found = true;
+      stopped = stopped || tr.quantity.sym != sym;
+      if( !stopped )
+         coin_age += tr.quantity * coin_age_days(st, tr.time, curr_time);
+   }
+   check(found, "Nothing to claim");
+
+   asset reward = coin_age_reward(coin_age, interest_rate);
+   check(reward.amount > 0, "Nothing to claim");
+
+   // postoken::issue_reward
+   asset from_pool(0, sym);
+   if( st.options & deferred_supply_option )
+      from_pool.amount = std::min(reward.amount, shard_budget);
+   asset rest = reward - from_pool;
+   rest.amount = std::max<int64_t>(0, std::min(rest.amount, available_supply(st)));
+   reward = from_pool + rest;
+   check(reward.amount > 0, "Max supply reached");
+   return reward;
+}
+
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+// Columnar file of postoken holder rows, for analytics and audit jobs:
+//   "PTCOL1\0\0", uint64 row count, uint64 size of stats block,
+//   columns of row count values each (every column starts at a multiple of 8 bytes):
+//     uint64 owner
+//     uint64 symbol  (raw eosio::symbol: code << 8 | precision)
+//     int64  amount
+//     uint64 id      (transferins primary key, 0 for balances and sub-ledgers)
+//     uint32 time    (transfer in time, epoch seconds; 0 for balances and sub-ledgers)
+//     uint8  kind    (row_kind)
+//   and the stats block: varuint32 count, stat rows packed as in the contract (without binary
+//   extensions) and the options (setoptions) of each row as uint32; files written before options
+//   were added end after the rows, their tokens read as options 0.
+// Transfer in times are kept in seconds rather than days because coin age is computed from
+// the difference of exact times (day = time / 86400).
+
+#include <postoken/datastream.hpp>
+
+#include <ostream>
+
+namespace postoken {
+
+static const char columnar_magic[8] = { 'P', 'T', 'C', 'O', 'L', '1', '\0', '\0' };
+
+enum row_kind : uint8_t {
+   balance_row     = 0, // accounts table
+   transfer_in_row = 1, // transferins table
+   sub_ledger_row  = 2  // subledgers table, amount is allocated (the owner's balance can't be minted)
+};
+
+struct columnar_layout {
+   uint64_t rows;
+   size_t   owner, symbol, amount, id, time, kind, stats, end; // offsets from the start of the file
+
+   columnar_layout(uint64_t rows, uint64_t stats_size) : rows(rows) {
+      size_t pos = sizeof(columnar_magic) + sizeof(uint64_t) * 2;
+      owner  = pos; pos += rows * sizeof(uint64_t);
+      symbol = pos; pos += rows * sizeof(uint64_t);
+      amount = pos; pos += rows * sizeof(int64_t);
+      id     = pos; pos += rows * sizeof(uint64_t);
+      time   = pos; pos += align(rows * sizeof(uint32_t));
+      kind   = pos; pos += align(rows * sizeof(uint8_t));
+      stats  = pos; pos += stats_size;
+      end    = pos;
+   }
+
+   static size_t align(size_t s) { return (s + 7) & ~size_t(7); }
+};
+
+// Columns being collected in memory
+struct columnar_table {
+   std::vector<uint64_t>       owner;
+   std::vector<uint64_t>       symbol;
+   std::vector<int64_t>        amount;
+   std::vector<uint64_t>       id;
+   std::vector<uint32_t>       time;
+   std::vector<uint8_t>        kind;
+   std::vector<currency_stats> stats;
+
+   size_t size() const { return owner.size(); }
+
+   void add_balance(uint64_t o, const asset& balance) {
+      push(o, balance, 0, 0, balance_row);
+   }
+
+   void add_transfer_in(uint64_t o, const transfer_in& tr) {
+      push(o, tr.quantity, tr.id, tr.time, transfer_in_row);
+   }
+
+   void add_sub_ledger(uint64_t o, const asset& allocated) {
+      push(o, allocated, 0, 0, sub_ledger_row);
+   }
+
+   void write(std::ostream& out) const {
+      std::vector<char> stats_block;
+      datastream_writer w(stats_block);
+      w.write_varuint32(stats.size());
+      for( const auto& st : stats )
+         w.write_currency_stats(st);
+      for( const auto& st : stats )
+         w.write_raw(st.options);
+
+      uint64_t rows = size();
+      uint64_t stats_size = stats_block.size();
+      out.write(columnar_magic, sizeof(columnar_magic));
+      out.write((const char*)&rows, sizeof(rows));
+      out.write((const char*)&stats_size, sizeof(stats_size));
+      write_column(out, owner);
+      write_column(out, symbol);
+      write_column(out, amount);
+      write_column(out, id);
+      write_column(out, time);
+      write_column(out, kind);
+      out.write(stats_block.data(), stats_block.size());
+   }
+
+private:
+   void push(uint64_t o, const asset& a, uint64_t i, timestamp_t t, row_kind k) {
+      owner.push_back(o);
+      symbol.push_back(a.sym.value);
+      amount.push_back(a.amount);
+      id.push_back(i);
+      time.push_back(t);
+      kind.push_back(k);
+   }
+
+   template<typename T>
+   static void write_column(std::ostream& out, const std::vector<T>& v) {
+      static const char zeros[8] = {};
+      size_t size = v.size() * sizeof(T);
+      out.write((const char*)v.data(), size);
+      out.write(zeros, columnar_layout::align(size) - size);
+   }
+};
+
+// Columns of a (memory mapped) columnar file, referenced in place
+struct columnar_view {
+   uint64_t        rows = 0;
+   const uint64_t* owner;
+   const uint64_t* symbol;
+   const int64_t*  amount;
+   const uint64_t* id;
+   const uint32_t* time;
+   const uint8_t*  kind;
+   const char*     stats_data;
+   size_t          stats_size;
+
+   // data has to be 8 byte aligned (as returned by mmap)
+   columnar_view(const char* data, size_t size) {
+      check(is_columnar(data, size), "not a postoken columnar file");
+      uint64_t stats_size64;
+      memcpy(&rows, data + sizeof(columnar_magic), sizeof(rows));
+      memcpy(&stats_size64, data + sizeof(columnar_magic) + sizeof(rows), sizeof(stats_size64));
+      check(rows <= size / sizeof(uint64_t) && stats_size64 <= size, "truncated columnar file");
+      columnar_layout l(rows, stats_size64);
+      check(l.end <= size, "truncated columnar file");
+      owner      = (const uint64_t*)(data + l.owner);
+      symbol     = (const uint64_t*)(data + l.symbol);
+      amount     = (const int64_t*)(data + l.amount);
+      id         = (const uint64_t*)(data + l.id);
+      time       = (const uint32_t*)(data + l.time);
+      kind       = (const uint8_t*)(data + l.kind);
+      stats_data = data + l.stats;
+      stats_size = stats_size64;
+   }
+
+   static bool is_columnar(const char* data, size_t size) {
+      return size >= sizeof(columnar_magic) + sizeof(uint64_t) * 2 &&
+             memcmp(data, columnar_magic, sizeof(columnar_magic)) == 0;
+   }
+
+   asset row_asset(size_t i) const { return asset(amount[i], postoken::symbol(symbol[i])); }
+
+   std::vector<currency_stats> stats() const {
+      datastream ds(stats_data, stats_size);
+      std::vector<currency_stats> v(ds.read_varuint32());
+      for( auto& st : v )
+         st = ds.read_currency_stats();
+      if( ds.remaining() >= v.size() * sizeof(uint32_t) ) {
+         for( auto& st : v )
+            st.options = ds.read_raw<uint32_t>();
+      }
+      return v;
+   }
+};
+
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+// Reader for eosio binary serialization (the format of packed action data and table rows)
+
+#include <postoken/rules.hpp>
+
+#include <cstring>
+
+namespace postoken {
+
+class datastream {
+public:
+   datastream(const char* data, size_t size) : _pos(data), _end(data + size) {}
+
+   size_t remaining() const { return _end - _pos; }
+   const char* pos() const { return _pos; }
+
+   void skip(size_t s) {
+      check(s <= remaining(), "read datastream over by");
+      _pos += s;
+   }
+
+   template<typename T>
+   T read_raw() {
+      T v;
+      check(sizeof(T) <= remaining(), "read datastream over by");
+      memcpy(&v, _pos, sizeof(T));
+      _pos += sizeof(T);
+      return v;
+   }
+
+   uint32_t read_varuint32() {
+      uint64_t v = 0;
+      uint8_t  b;
+      uint8_t  by = 0;
+      do {
+         b = read_raw<uint8_t>();
+         v |= uint32_t(b & 0x7f) << by;
+         by += 7;
+      } while( (b & 0x80) && by < 32 );
+      return (uint32_t)v;
+   }
+
+   std::string read_string() {
+      uint32_t size = read_varuint32();
+      check(size <= remaining(), "read datastream over by");
+      std::string s(_pos, size);
+      _pos += size;
+      return s;
+   }
+
+   symbol read_symbol() { return symbol(read_raw<uint64_t>()); }
+
+   std::vector<uint64_t> read_names() {
+      uint32_t size = read_varuint32();
+      check(size <= remaining() / sizeof(uint64_t), "read datastream over by");
+      std::vector<uint64_t> v(size);
+      for( auto& n : v )
+         n = read_raw<uint64_t>();
+      return v;
+   }
+
+   asset read_asset() {
+      int64_t amount = read_raw<int64_t>();
+      return asset(amount, read_symbol());
+   }
+
+   interest_t read_interest() {
+      interest_t i;
+      i.interest_rate = read_asset();
+      i.years         = read_raw<uint16_t>();
+      return i;
+   }
+
+   std::vector<interest_t> read_interests() {
+      std::vector<interest_t> v(read_varuint32());
+      for( auto& i : v )
+         i = read_interest();
+      return v;
+   }
+
+   currency_stats read_currency_stats() {
+      currency_stats st;
+      st.supply           = read_asset();
+      st.max_supply       = read_asset();
+      st.issuer           = read_raw<uint64_t>();
+      st.min_coin_age     = read_raw<uint16_t>();
+      st.max_coin_age     = read_raw<uint16_t>();
+      st.anual_interests  = read_interests();
+      st.stake_start_time = read_raw<uint32_t>();
+      return st;
+   }
+
+   transfer_in read_transfer_in() {
+      transfer_in tr;
+      tr.id       = read_raw<uint64_t>();
+      tr.quantity = read_asset();
+      tr.time     = read_raw<uint32_t>();
+      return tr;
+   }
+
+private:
+   const char* _pos;
+   const char* _end;
+};
+
+// Writer for the same format. Derived supplies write_bytes(data, size).
+template<typename Derived>
+class writer_base {
+public:
+   template<typename T>
+   void write_raw(const T& v) {
+      bytes((const char*)&v, sizeof(T));
+   }
+
+   void write_varuint32(uint32_t v) {
+      do {
+         uint8_t b = v & 0x7f;
+         v >>= 7;
+         b |= (v > 0) << 7;
+         write_raw(b);
+      } while( v );
+   }
+
+   void write_string(const char* s, size_t size) {
+      write_varuint32(size);
+      bytes(s, size);
+   }
+
+   void write_string(const std::string& s) { write_string(s.data(), s.size()); }
+
+   void write_names(const uint64_t* names, size_t count) {
+      write_varuint32(count);
+      bytes((const char*)names, count * sizeof(uint64_t));
+   }
+
+   void write_symbol(const symbol& s) { write_raw(s.value); }
+
+   void write_asset(const asset& a) {
+      write_raw(a.amount);
+      write_symbol(a.sym);
+   }
+
+   void write_interest(const interest_t& i) {
+      write_asset(i.interest_rate);
+      write_raw(i.years);
+   }
+
+   void write_interests(const interest_t* v, size_t count) {
+      write_varuint32(count);
+      for( size_t i = 0; i < count; i++ )
+         write_interest(v[i]);
+   }
+
+   void write_interests(const std::vector<interest_t>& v) { write_interests(v.data(), v.size()); }
+
+   void write_currency_stats(const currency_stats& st) {
+      write_asset(st.supply);
+      write_asset(st.max_supply);
+      write_raw(st.issuer);
+      write_raw(st.min_coin_age);
+      write_raw(st.max_coin_age);
+      write_interests(st.anual_interests);
+      write_raw(st.stake_start_time);
+   }
+
+   void write_transfer_in(const transfer_in& tr) {
+      write_raw(tr.id);
+      write_asset(tr.quantity);
+      write_raw(tr.time);
+   }
+
+private:
+   void bytes(const char* data, size_t size) { static_cast<Derived*>(this)->write_bytes(data, size); }
+};
+
+// Appends to a vector
+class datastream_writer : public writer_base<datastream_writer> {
+public:
+   explicit datastream_writer(std::vector<char>& out) : _out(out) {}
+
+   void write_bytes(const char* data, size_t size) { _out.insert(_out.end(), data, data + size); }
+
+private:
+   std::vector<char>& _out;
+};
+
+// Writes into a fixed buffer, without allocating
+class buffer_writer : public writer_base<buffer_writer> {
+public:
+   buffer_writer(char* data, size_t capacity) : _begin(data), _pos(data), _end(data + capacity) {}
+
+   size_t size() const { return _pos - _begin; }
+
+   void write_bytes(const char* data, size_t size) {
+      check(size <= size_t(_end - _pos), "write datastream over by");
+      memcpy(_pos, data, size);
+      _pos += size;
+   }
+
+private:
+   char* _begin;
+   char* _pos;
+   char* _end;
+};
+
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+// Minimal blocking HTTP/1.1 client (keep-alive POST) for nodeos and keosd RPC. One connection per
+// object, not thread safe; give each thread its own.
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace postoken {
+
+struct http_response {
+   int         status = 0;
+   std::string body;
+};
+
+class http_client {
+public:
+   // url is http://host[:port], without a path
+   explicit http_client(const std::string& url) {
+      std::string rest = url;
+      if( rest.compare(0, 7, "http://") == 0 )
+         rest = rest.substr(7);
+      else if( rest.find("://") != std::string::npos )
+         throw std::runtime_error("only http:// urls are supported: " + url);
+      while( !rest.empty() && rest.back() == '/' )
+         rest.pop_back();
+      auto colon = rest.rfind(':');
+      _host = colon == std::string::npos ? rest : rest.substr(0, colon);
+      _port = colon == std::string::npos ? "80" : rest.substr(colon + 1);
+   }
+
+   ~http_client() { disconnect(); }
+
+   http_client(const http_client&) = delete;
+   http_client& operator=(const http_client&) = delete;
+
+   // Reconnects once if the server closed the kept-alive connection
+   http_response post(const std::string& path, const std::string& body) {
+      for( int attempt = 0;; attempt++ ) {
+         bool reused = _fd >= 0;
+         try {
+            if( _fd < 0 )
+               connect();
+            send_all("POST " + path + " HTTP/1.1\r\nHost: " + _host + ":" + _port +
+                     "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) +
+                     "\r\nConnection: keep-alive\r\n\r\n" + body);
+            return read_response();
+         } catch( const std::exception& ) {
+            disconnect();
+            if( !reused || attempt > 0 )
+               throw;
+         }
+      }
+   }
+
+private:
+   void connect() {
+      addrinfo hints = {};
+      hints.ai_family   = AF_UNSPEC;
+      hints.ai_socktype = SOCK_STREAM;
+      addrinfo* res     = nullptr;
+      if( int err = getaddrinfo(_host.c_str(), _port.c_str(), &hints, &res) )
+         throw std::runtime_error("cannot resolve " + _host + ": " + gai_strerror(err));
+      for( addrinfo* ai = res; ai; ai = ai->ai_next ) {
+         _fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+         if( _fd < 0 )
+            continue;
+         if( ::connect(_fd, ai->ai_addr, ai->ai_addrlen) == 0 )
+            break;
+         close(_fd);
+         _fd = -1;
+      }
+      freeaddrinfo(res);
+      if( _fd < 0 )
+         throw std::runtime_error("cannot connect to " + _host + ":" + _port);
+      int one = 1;
+      setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      _buffer.clear();
+   }
+
+   void disconnect() {
+      if( _fd >= 0 )
+         close(_fd);
+      _fd = -1;
+      _buffer.clear();
+   }
+
+   void send_all(const std::string& data) {
+      for( size_t sent = 0; sent < data.size(); ) {
+         ssize_t n = send(_fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+         if( n <= 0 )
+            throw std::runtime_error("connection lost while sending");
+         sent += n;
+      }
+   }
+
+   void fill() {
+      char    chunk[16384];
+      ssize_t n = recv(_fd, chunk, sizeof(chunk), 0);
+      if( n <= 0 )
+         throw std::runtime_error("connection closed by server");
+      _buffer.append(chunk, n);
+   }
+
+   std::string read_line() {
+      size_t eol;
+      while( (eol = _buffer.find("\r\n")) == std::string::npos )
+         fill();
+      std::string line = _buffer.substr(0, eol);
+      _buffer.erase(0, eol + 2);
+      return line;
+   }
+
+   std::string read_bytes(size_t size) {
+      while( _buffer.size() < size )
+         fill();
+      std::string s = _buffer.substr(0, size);
+      _buffer.erase(0, size);
+      return s;
+   }
+
+   http_response read_response() {
+      http_response r;
+      std::string status_line = read_line();
+      auto sp = status_line.find(' ');
+      if( status_line.compare(0, 5, "HTTP/") != 0 || sp == std::string::npos )
+         throw std::runtime_error("invalid http response");
+      r.status = std::stoi(status_line.substr(sp + 1));
+
+      long long content_length = -1;
+      bool      chunked = false, close_after = false;
+      for( std::string line; !(line = read_line()).empty(); ) {
+         auto colon = line.find(':');
+         if( colon == std::string::npos )
+            continue;
+         std::string key = line.substr(0, colon), value = line.substr(colon + 1);
+         for( auto& c : key )
+            c = (char)tolower((unsigned char)c);
+         value.erase(0, value.find_first_not_of(' '));
+         if( key == "content-length" )
+            content_length = std::stoll(value);
+         else if( key == "transfer-encoding" && value.find("chunked") != std::string::npos )
+            chunked = true;
+         else if( key == "connection" && (value == "close" || value == "Close") )
+            close_after = true;
+      }
+
+      if( chunked ) {
+         while( size_t size = std::stoul(read_line(), nullptr, 16) ) {
+            r.body += read_bytes(size);
+            read_line();
+         }
+         while( !read_line().empty() ) {}
+      } else if( content_length >= 0 ) {
+         r.body = read_bytes((size_t)content_length);
+      } else {
+         try {
+            while( true )
+               fill();
+         } catch( const std::runtime_error& ) {}
+         r.body.swap(_buffer);
+         close_after = true;
+      }
+      if( close_after )
+         disconnect();
+      return r;
+   }
+
+   std::string _host;
+   std::string _port;
+   int         _fd = -1;
+   std::string _buffer;
+};
+
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+// Minimal JSON reader for action logs and RPC responses. Numbers are kept as text so that 64 bit values survive.
+
+#include <postoken/rules.hpp>
+
+#include <cctype>
+#include <memory>
+#include <utility>
+
+namespace postoken { namespace json {
+
+struct value {
+   enum kind_t { null_t, bool_t, number_t, string_t, array_t, object_t };
+
+   kind_t                                     kind = null_t;
+   std::string                                str;    // string, number or bool text
+   std::vector<value>                         array;
+   std::vector<std::pair<std::string, value>> object;
+
+   const value* find(const std::string& key) const {
+      for( const auto& kv : object )
+         if( kv.first == key )
+            return &kv.second;
+      return nullptr;
+   }
+
+   const value& operator[](const std::string& key) const {
+      const value* v = find(key);
+      if( !v )
+         throw rules_error("missing field " + key);
+      return *v;
+   }
+
+   const std::string& as_string() const {
+      check(kind == string_t, "expected string");
+      return str;
+   }
+
+   uint64_t as_uint64() const {
+      check(kind == number_t || kind == string_t, "expected number");
+      return std::stoull(str);
+   }
+
+   int64_t as_int64() const {
+      check(kind == number_t || kind == string_t, "expected number");
+      return std::stoll(str);
+   }
+};
+
+class parser {
+public:
+   parser(const char* begin, const char* end) : _pos(begin), _end(end) {}
+
+   value parse() {
+      value v = parse_value();
+      skip_ws();
+      check(_pos == _end, "trailing characters after json value");
+      return v;
+   }
+
+private:
+   void skip_ws() {
+      while( _pos != _end && (*_pos == ' ' || *_pos == '\t' || *_pos == '\r' || *_pos == '\n') )
+         ++_pos;
+   }
+
+   char peek() {
+      skip_ws();
+      check(_pos != _end, "unexpected end of json");
+      return *_pos;
+   }
+
+   void expect(char c) {
+      check(peek() == c, "unexpected character in json");
+      ++_pos;
+   }
+
+   value parse_value() {
+      value v;
+      char c = peek();
+      if( c == '{' ) {
+         v.kind = value::object_t;
+         ++_pos;
+         if( peek() == '}' ) {
+            ++_pos;
+            return v;
+         }
+         while( true ) {
+            std::string key = parse_string();
+            expect(':');
+            v.object.emplace_back(std::move(key), parse_value());
+            if( peek() == ',' ) {
+               ++_pos;
+               continue;
+            }
+            expect('}');
+            return v;
+         }
+      }
+      if( c == '[' ) {
+         v.kind = value::array_t;
+         ++_pos;
+         if( peek() == ']' ) {
+            ++_pos;
+            return v;
+         }
+         while( true ) {
+            v.array.push_back(parse_value());
+            if( peek() == ',' ) {
+               ++_pos;
+               continue;
+            }
+            expect(']');
+            return v;
+         }
+      }
+      if( c == '"' ) {
+         v.kind = value::string_t;
+         v.str  = parse_string();
+         return v;
+      }
+      const char* start = _pos;
+      while( _pos != _end && (isalnum((unsigned char)*_pos) || *_pos == '-' || *_pos == '+' || *_pos == '.') )
+         ++_pos;
+      v.str.assign(start, _pos);
+      check(!v.str.empty(), "unexpected character in json");
+      if( v.str == "null" )
+         v.kind = value::null_t;
+      else if( v.str == "true" || v.str == "false" )
+         v.kind = value::bool_t;
+      else
+         v.kind = value::number_t;
+      return v;
+   }
+
+   std::string parse_string() {
+      expect('"');
+      std::string s;
+      while( true ) {
+         check(_pos != _end, "unterminated json string");
+         char c = *_pos++;
+         if( c == '"' )
+            return s;
+         if( c == '\\' ) {
+            check(_pos != _end, "unterminated json string");
+            char e = *_pos++;
+            switch( e ) {
+               case 'n': s += '\n'; break;
+               case 't': s += '\t'; break;
+               case 'r': s += '\r'; break;
+               case 'b': s += '\b'; break;
+               case 'f': s += '\f'; break;
+               case 'u': {
+                  check(_end - _pos >= 4, "invalid json escape");
+                  unsigned cp = std::stoul(std::string(_pos, 4), nullptr, 16);
+                  _pos += 4;
+                  s += cp < 0x80 ? char(cp) : '?'; // names, assets and memos we care about are ASCII
+                  break;
+               }
+               default: s += e;
+            }
+         } else {
+            s += c;
+         }
+      }
+   }
+
+   const char* _pos;
+   const char* _end;
+};
+
+inline value parse(const std::string& text) {
+   return parser(text.data(), text.data() + text.size()).parse();
+}
+
+} }
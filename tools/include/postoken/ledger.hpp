@@ -0,0 +1,589 @@
+#pragma once
+
+// In-memory postoken state with the contract's actions applied natively.
+// Table layout mirrors the contract: stat rows by symbol code and, per owner,
+// the accounts rows and the transferins table (ids shared by all symbols of the owner).
+
+#include <postoken/rules.hpp>
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+namespace postoken {
+
+class ledger {
+public:
+   struct holder {
+      std::vector<asset>       balances; // accounts table, one row per symbol
+      std::vector<transfer_in> ins;      // transferins table, ordered by id
+
+      asset* find_balance(uint64_t sym_code) {
+         for( auto& b : balances )
+            if( b.sym.code() == sym_code )
+               return &b;
+         return nullptr;
+      }
+
+      // transfer_ins::available_primary_key()
+      uint64_t next_id() const { return ins.empty() ? 0 : ins.back().id + 1; }
+   };
+
+   std::unordered_map<uint64_t, currency_stats> stats;   // by symbol code
+   std::unordered_map<uint64_t, holder>         holders; // by owner
+   timestamp_t                                  now = 0; // block time of the action being applied
+   symbol                                       default_symbol; // config row (setdefsym), value 0 if not set
+
+   // rewardpool table and stat row's pool of a token (setrewardpool)
+   struct reward_pool {
+      int64_t            shard_budget = 0;
+      int64_t            reserved     = 0; // sum of budget and pending
+      std::vector<asset> budget;           // by shard
+      std::vector<asset> pending;
+   };
+   std::unordered_map<uint64_t, reward_pool> reward_pools; // by symbol code
+
+   // Omnibus sub-ledgers: subledgers rows by (custodian, symbol code), subaccounts rows by (custodian, id)
+   struct sub_ledger {
+      asset allocated;
+      asset unsettled;
+   };
+   struct sub_account {
+      asset       balance;
+      timestamp_t time;
+   };
+   std::map<std::pair<uint64_t, uint64_t>, sub_ledger>  sub_ledgers;
+   std::map<std::pair<uint64_t, uint64_t>, sub_account> sub_accounts;
+
+   const currency_stats& get_stats(uint64_t sym_code) const {
+      auto it = stats.find(sym_code);
+      check(it != stats.end(), "unable to find key");
+      return it->second;
+   }
+
+   void create(uint64_t issuer, const asset& maximum_supply) {
+      check(maximum_supply.is_valid(), "invalid supply");
+      check(maximum_supply.amount > 0, "max-supply must be positive");
+      check(stats.find(maximum_supply.sym.code()) == stats.end(), "token with symbol already exists");
+
+      currency_stats& s = stats[maximum_supply.sym.code()];
+      s.supply     = asset(0, maximum_supply.sym);
+      s.max_supply = maximum_supply;
+      s.issuer     = issuer;
+   }
+
+   void issue(uint64_t to, const asset& quantity) {
+      auto it = stats.find(quantity.sym.code());
+      check(it != stats.end(), "token with symbol does not exist, create token before issue");
+      currency_stats& st = it->second;
+      check(quantity.is_valid(), "invalid quantity");
+      check(quantity.amount > 0, "must issue positive quantity");
+      check(quantity.sym == st.supply.sym, "symbol precision mismatch");
+      check(quantity.amount <= available_supply(st), "quantity exceeds available supply");
+
+      st.supply += quantity;
+      add_balance(st.issuer, quantity);
+      if( to != st.issuer )
+         transfer(st.issuer, to, quantity);
+   }
+
+   void retire(const asset& quantity) {
+      auto it = stats.find(quantity.sym.code());
+      check(it != stats.end(), "token with symbol does not exist");
+      currency_stats& st = it->second;
+      check(quantity.is_valid(), "invalid quantity");
+      check(quantity.amount > 0, "must retire positive quantity");
+      check(quantity.sym == st.supply.sym, "symbol precision mismatch");
+
+      st.supply -= quantity;
+      sub_balance(st.issuer, quantity);
+   }
+
+   void transfer(uint64_t from, uint64_t to, const asset& quantity) {
+      check(from != to, "cannot transfer to self");
+      const currency_stats& st = get_stats(quantity.sym.code());
+      check(quantity.is_valid(), "invalid quantity");
+      check(quantity.amount > 0, "must transfer positive quantity");
+      check(quantity.sym == st.supply.sym, "symbol precision mismatch");
+
+      sub_balance(from, quantity);
+      add_balance(to, quantity);
+   }
+
+   void xfer(uint64_t from, uint64_t to, int64_t amount) {
+      check(from != to, "cannot transfer to self");
+      check(default_symbol.value != 0, "default symbol is not set");
+      check(amount > 0, "must transfer positive quantity");
+      asset quantity(amount, default_symbol);
+      check(quantity.is_valid(), "magnitude of asset amount must be less than 2^62");
+
+      sub_balance(from, quantity);
+      add_balance(to, quantity);
+   }
+
+   void setdefsym(uint64_t sym_code) {
+      auto it = stats.find(sym_code);
+      check(it != stats.end(), "Token with this symbol does not exist");
+      default_symbol = it->second.supply.sym;
+   }
+
+   void open(uint64_t owner, const symbol& sym) {
+      openmany({ owner }, sym);
+   }
+
+   void close(uint64_t owner, const symbol& sym) {
+      closemany({ owner }, sym);
+   }
+
+   void openmany(const std::vector<uint64_t>& owners, const symbol& sym) {
+      auto it = stats.find(sym.code());
+      check(it != stats.end(), "symbol does not exist");
+      check(it->second.supply.sym == sym, "symbol precision mismatch");
+
+      for( uint64_t owner : owners ) {
+         holder& h = holders[owner];
+         if( !h.find_balance(sym.code()) )
+            h.balances.push_back(asset(0, sym));
+      }
+   }
+
+   void closemany(const std::vector<uint64_t>& owners, const symbol& sym) {
+      // Every row is checked before any is erased, failed action must leave no changes.
+      // Second close of the same owner fails in the contract.
+      std::vector<uint64_t> sorted(owners);
+      std::sort(sorted.begin(), sorted.end());
+      check(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end(),
+            "Balance row already deleted or never existed. Action won't have any effect.");
+      for( uint64_t owner : owners ) {
+         auto it = holders.find(owner);
+         asset* b = it == holders.end() ? nullptr : it->second.find_balance(sym.code());
+         check(b != nullptr, "Balance row already deleted or never existed. Action won't have any effect.");
+         check(b->amount == 0, "Cannot close because the balance is not zero.");
+      }
+      for( uint64_t owner : owners ) {
+         holder& h = holders[owner];
+         asset* b = h.find_balance(sym.code());
+         h.balances.erase(h.balances.begin() + (b - h.balances.data()));
+      }
+   }
+
+   void setstakespec(timestamp_t stake_start_time, uint16_t min_coin_age, uint16_t max_coin_age,
+                     const std::vector<interest_t>& anual_interests) {
+      check(anual_interests.size() > 0, "You have to specify interest rates");
+      symbol sym = anual_interests[0].interest_rate.sym;
+      auto it = stats.find(sym.code());
+      check(it != stats.end(), "Token with this symbol does not exist");
+      currency_stats& st = it->second;
+
+      check(st.max_supply.sym == sym, "Invalid token precision");
+      for( const interest_t& i : anual_interests )
+         check(i.interest_rate.sym == sym, "All anual interest rates have to have the same symbol");
+      check(st.stake_start_time < now, "Staking has already started");
+      check(stake_start_time >= now, "stake_start_time cannot be in the past");
+      check(max_coin_age > 0, "Coin age cannot be 0");
+      check(min_coin_age <= max_coin_age, "min_coin_age cannot be greater than max_coin_age");
+
+      st.stake_start_time = stake_start_time;
+      st.min_coin_age     = min_coin_age;
+      st.max_coin_age     = max_coin_age;
+      st.anual_interests  = anual_interests;
+   }
+
+   // Returns issued reward
+   asset mint(uint64_t account, uint64_t sym_code) {
+      asset reward = claim(account, sym_code, false);
+      check(reward.amount > 0, "Max supply reached");
+      return reward;
+   }
+
+   // mint for every token of the account's transfer ins in symbol code order (the contract's symbol
+   // index), tokens with nothing to claim are skipped. Returns issued rewards.
+   std::vector<asset> mintall(uint64_t account) {
+      std::vector<uint64_t> codes;
+      auto h_it = holders.find(account);
+      if( h_it != holders.end() )
+         for( const transfer_in& tr : h_it->second.ins )
+            codes.push_back(tr.quantity.sym.code());
+      std::sort(codes.begin(), codes.end());
+      codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+
+      std::vector<asset> rewards;
+      for( uint64_t code : codes ) {
+         asset reward = claim(account, code, true);
+         if( reward.amount > 0 )
+            rewards.push_back(reward);
+      }
+      check(!rewards.empty(), "Nothing to claim");
+      return rewards;
+   }
+
+   // Options which don't change balances or transfer ins are only recorded
+   void setoptions(uint64_t sym_code, uint32_t options) {
+      auto it = stats.find(sym_code);
+      check(it != stats.end(), "Token with this symbol does not exist");
+      check((options & ~known_options) == 0, "unknown option");
+      auto pool = reward_pools.find(sym_code);
+      if( options & deferred_supply_option )
+         check(pool != reward_pools.end(), "Reward pool is not set");
+      else
+         check(pool == reward_pools.end() || pool->second.reserved == 0,
+               "Reward pool has reserved supply, release it first");
+      it->second.options = options;
+   }
+
+   void setrewardpool(uint64_t sym_code, uint16_t shards, const asset& shard_budget) {
+      const currency_stats& st = get_stats(sym_code);
+      check(shard_budget.sym == st.max_supply.sym, "symbol precision mismatch");
+      check(shard_budget.is_valid() && shard_budget.amount >= 0, "invalid shard budget");
+      check(shards > 0 && shards <= max_pool_shards, "invalid number of shards");
+
+      reward_pool& pool = reward_pools[sym_code];
+      if( pool.budget.size() != shards ) {
+         check(pool.reserved == 0, "Reward pool has reserved supply, release it first");
+         pool.budget.assign(shards, asset(0, st.max_supply.sym));
+         pool.pending.assign(shards, asset(0, st.max_supply.sym));
+      }
+      pool.shard_budget = shard_budget.amount;
+   }
+
+   void settle(uint64_t sym_code) {
+      auto st_it = stats.find(sym_code);
+      check(st_it != stats.end(), "Token with this symbol does not exist");
+      currency_stats& st = st_it->second;
+      check(st.options & deferred_supply_option, "Deferred supply is not enabled for this token");
+
+      reward_pool& pool = reward_pools.at(sym_code);
+      for( size_t i = 0; i < pool.budget.size(); i++ ) {
+         st.supply += pool.pending[i];
+         pool.reserved -= pool.pending[i].amount;
+         pool.pending[i].amount = 0;
+         int64_t budget = std::min(pool.shard_budget, pool.budget[i].amount + available_supply(st));
+         pool.reserved += budget - pool.budget[i].amount;
+         pool.budget[i].amount = budget;
+      }
+   }
+
+   // Returns number of erased transfer ins
+   uint32_t compact(uint64_t account, uint64_t sym_code, uint32_t max_rows) {
+      const currency_stats& st = get_stats(sym_code);
+      check(st.max_coin_age > 0, "Stake spec is not set");
+
+      // Positions of the leading matured transfer ins of the symbol
+      std::vector<size_t> rows;
+      auto h_it = holders.find(account);
+      if( h_it != holders.end() ) {
+         const auto& ins = h_it->second.ins;
+         for( size_t i = 0; i < ins.size() && rows.size() < std::max(max_rows, 1u); i++ ) {
+            if( ins[i].quantity.sym.code() != sym_code )
+               continue;
+            if( !is_matured(st, ins[i].time, now) )
+               break;
+            rows.push_back(i);
+         }
+      }
+      check(rows.size() > 1, "Nothing to compact");
+
+      auto& ins = h_it->second.ins;
+      asset folded(0, st.max_supply.sym);
+      for( size_t i : rows ) {
+         check(ins[i].quantity.sym == st.max_supply.sym, "Invalid precision in transferin!");
+         if( i != rows.back() )
+            folded += ins[i].quantity;
+      }
+      ins[rows.back()].quantity += folded;
+      for( auto it = rows.rbegin() + 1; it != rows.rend(); ++it )
+         ins.erase(ins.begin() + *it);
+      return uint32_t(rows.size() - 1);
+   }
+
+   void subdeposit(uint64_t custodian, uint64_t sub, const asset& quantity) {
+      check(quantity.is_valid(), "invalid quantity");
+      check(quantity.amount > 0, "must deposit positive quantity");
+      auto h_it = holders.find(custodian);
+      asset* acc = h_it == holders.end() ? nullptr : h_it->second.find_balance(quantity.sym.code());
+      check(acc != nullptr, "no balance object found");
+      check(acc->sym == quantity.sym, "symbol precision mismatch");
+
+      auto key = std::make_pair(custodian, quantity.sym.code());
+      auto l_it = sub_ledgers.find(key);
+      int64_t allocated = l_it == sub_ledgers.end() ? 0 : l_it->second.allocated.amount;
+      check(quantity.amount <= acc->amount - allocated, "quantity exceeds unallocated balance");
+      auto s_it = sub_accounts.find({ custodian, sub });
+      check(s_it == sub_accounts.end() || s_it->second.balance.sym == quantity.sym, "sub-account holds another token");
+
+      if( l_it == sub_ledgers.end() ) {
+         sub_ledgers[key] = { quantity, asset(0, quantity.sym) };
+         restart_coin_age(h_it->second, *acc);
+      } else
+         l_it->second.allocated += quantity;
+      credit_sub_account(custodian, sub, quantity);
+   }
+
+   void subwithdraw(uint64_t custodian, uint64_t sub, const asset& quantity) {
+      check(quantity.is_valid(), "invalid quantity");
+      check(quantity.amount > 0, "must withdraw positive quantity");
+      auto l_it = sub_ledgers.find({ custodian, quantity.sym.code() });
+      check(l_it != sub_ledgers.end(), "no sub-ledger found");
+      sub_ledger& l = l_it->second;
+      check(quantity.amount <= l.allocated.amount, "quantity exceeds allocated balance, subsettle first");
+
+      debit_sub_account(custodian, sub, quantity);
+      l.allocated -= quantity;
+      if( l.allocated.amount == 0 && l.unsettled.amount == 0 ) {
+         sub_ledgers.erase(l_it);
+         holder& h = holders.at(custodian);
+         restart_coin_age(h, *h.find_balance(quantity.sym.code()));
+      }
+   }
+
+   void submove(uint64_t custodian, uint64_t from, uint64_t to, const asset& quantity) {
+      check(from != to, "cannot move to self");
+      check(quantity.is_valid(), "invalid quantity");
+      check(quantity.amount > 0, "must move positive quantity");
+      auto to_it = sub_accounts.find({ custodian, to });
+      auto from_it = sub_accounts.find({ custodian, from });
+      check(from_it != sub_accounts.end(), "no sub-account found");
+      check(from_it->second.balance.sym == quantity.sym, "symbol precision mismatch");
+      check(from_it->second.balance.amount >= quantity.amount, "overdrawn sub-account");
+      check(to_it == sub_accounts.end() || to_it->second.balance.sym == quantity.sym, "sub-account holds another token");
+
+      debit_sub_account(custodian, from, quantity);
+      credit_sub_account(custodian, to, quantity);
+   }
+
+   // Returns rewards of the claimed sub-accounts
+   std::vector<asset> submint(uint64_t custodian, const std::vector<uint64_t>& subs) {
+      std::vector<asset> rewards;
+      for( uint64_t id : subs ) {
+         auto s_it = sub_accounts.find({ custodian, id });
+         check(s_it != sub_accounts.end(), "no sub-account found");
+         sub_account& sub = s_it->second;
+         auto st_it = stats.find(sub.balance.sym.code());
+         check(st_it != stats.end(), "unable to find key");
+         currency_stats& st = st_it->second;
+
+         if( st.stake_start_time >= now )
+            continue;
+         asset coin_age = sub.balance * coin_age_days(st, sub.time, now);
+         asset reward = coin_age_reward(coin_age, get_interest_rate(st, now));
+         if( reward.amount <= 0 )
+            continue;
+         reward = issue_reward(st, custodian, reward);
+         if( reward.amount <= 0 )
+            continue;
+
+         sub.balance += reward;
+         sub.time = now;
+         sub_ledgers.at({ custodian, sub.balance.sym.code() }).unsettled += reward;
+         rewards.push_back(reward);
+      }
+      check(!rewards.empty(), "Nothing to claim");
+      return rewards;
+   }
+
+   // Returns settled rewards
+   asset subsettle(uint64_t custodian, uint64_t sym_code) {
+      check(stats.find(sym_code) != stats.end(), "Token with this symbol does not exist");
+      auto l_it = sub_ledgers.find({ custodian, sym_code });
+      check(l_it != sub_ledgers.end(), "no sub-ledger found");
+      sub_ledger& l = l_it->second;
+      asset settled = l.unsettled;
+      check(settled.amount > 0, "Nothing to settle");
+      l.allocated += settled;
+      l.unsettled.amount = 0;
+      add_balance(custodian, settled);
+      return settled;
+   }
+
+private:
+   // postoken::restart_coin_age
+   void restart_coin_age(holder& h, const asset& balance) {
+      if( std::any_of(h.ins.begin(), h.ins.end(), [&](const transfer_in& tr) { return tr.quantity.sym.code() == balance.sym.code(); }) )
+         erase_transferins(h, balance.sym);
+      if( balance.amount > 0 )
+         h.ins.push_back({ h.next_id(), balance, now });
+   }
+
+   // postoken::credit_sub_account, the sub-account's token has been checked
+   void credit_sub_account(uint64_t custodian, uint64_t sub, const asset& quantity) {
+      auto it = sub_accounts.find({ custodian, sub });
+      if( it == sub_accounts.end() ) {
+         sub_accounts[{ custodian, sub }] = { quantity, now };
+         return;
+      }
+      sub_account& s = it->second;
+      s.time = timestamp_t(((unsigned __int128)s.balance.amount * s.time + (unsigned __int128)quantity.amount * now) /
+                           uint64_t(s.balance.amount + quantity.amount));
+      s.balance += quantity;
+   }
+
+   void debit_sub_account(uint64_t custodian, uint64_t sub, const asset& quantity) {
+      auto it = sub_accounts.find({ custodian, sub });
+      check(it != sub_accounts.end(), "no sub-account found");
+      sub_account& s = it->second;
+      check(s.balance.sym == quantity.sym, "symbol precision mismatch");
+      check(s.balance.amount >= quantity.amount, "overdrawn sub-account");
+      s.balance -= quantity;
+      if( s.balance.amount == 0 )
+         sub_accounts.erase(it);
+   }
+
+   // Supply neither issued nor reserved by a reward pool
+   int64_t available_supply(const currency_stats& st) const {
+      auto pool = reward_pools.find(st.max_supply.sym.code());
+      return st.max_supply.amount - st.supply.amount - (pool == reward_pools.end() ? 0 : pool->second.reserved);
+   }
+
+   // mint of one token (postoken::mint and mintall). With skip, returns 0 where mint fails for
+   // lack of something to claim. Returns 0 as well if max_supply is reached.
+   asset claim(uint64_t account, uint64_t sym_code, bool skip) {
+      auto st_it = stats.find(sym_code);
+      check(st_it != stats.end(), "unable to find key");
+      currency_stats& st = st_it->second;
+      symbol sym = st.max_supply.sym;
+      const asset none(0, sym);
+      auto claimable = [&](bool pred, const char* msg) {
+         check(pred || skip, msg);
+         return pred;
+      };
+
+      if( !claimable(st.stake_start_time < now, "Can't mint before stake start time") )
+         return none;
+      asset interest_rate = get_interest_rate(st, now);
+      if( !claimable(interest_rate.amount > 0, "Nothing to claim: 0 interest rate") )
+         return none;
+
+      if( !claimable(sub_ledgers.find({ account, sym_code }) == sub_ledgers.end(), "Balance has a sub-ledger, use submint") )
+         return none;
+
+      auto h_it = holders.find(account);
+      asset* to = h_it == holders.end() ? nullptr : h_it->second.find_balance(sym_code);
+      if( !claimable(to != nullptr, "Nothing to claim") )
+         return none;
+      holder& h = h_it->second;
+
+      // mint walks the symbol index while the precision matches, mintall fails on a mismatch
+      bool found = false, mismatch = false;
+      asset coin_age(0, sym);
+      asset balance(0, sym);
+      for( const transfer_in& tr : h.ins ) {
+         if( tr.quantity.sym.code() != sym_code )
+            continue;
+         found = true;
+         check(!skip || tr.quantity.sym == sym, "Invalid precision in transferin!");
+         if( tr.quantity.sym != sym ) {
+            mismatch = true;
+            break;
+         }
+         balance += tr.quantity;
+         coin_age += tr.quantity * coin_age_days(st, tr.time, now);
+      }
+      if( !claimable(found, "Nothing to claim") )
+         return none;
+
+      asset reward = coin_age_reward(coin_age, interest_rate);
+      if( !claimable(reward.amount > 0, "Nothing to claim") )
+         return none;
+      // Replacing the transfer ins fails on the mismatching row once anything is issued, checked
+      // before issue_reward so that the ledger is left unchanged
+      if( mismatch )
+         check(reward_from_pool(st, account, reward).amount == 0 && available_supply(st) <= 0,
+               "Invalid precision in transferin!");
+      reward = issue_reward(st, account, reward);
+      if( reward.amount <= 0 )
+         return none;
+
+      add_balance(account, reward);
+      erase_transferins(h, sym);
+      h.ins.push_back({ h.next_id(), balance + reward, now });
+      return reward;
+   }
+
+   // Part of reward issue_reward takes from the account's reward pool shard
+   asset reward_from_pool(const currency_stats& st, uint64_t account, asset reward) const {
+      asset from_pool(0, reward.sym);
+      if( st.options & deferred_supply_option ) {
+         const reward_pool& pool = reward_pools.at(st.max_supply.sym.code());
+         from_pool.amount = std::min(reward.amount, pool.budget[account % pool.budget.size()].amount);
+      }
+      return from_pool;
+   }
+
+   // postoken::issue_reward
+   asset issue_reward(currency_stats& st, uint64_t account, asset reward) {
+      asset from_pool = reward_from_pool(st, account, reward);
+      if( from_pool.amount > 0 ) {
+         reward_pool& pool = reward_pools.at(st.max_supply.sym.code());
+         size_t shard = account % pool.budget.size();
+         pool.budget[shard] -= from_pool;
+         pool.pending[shard] += from_pool;
+      }
+      asset rest = reward - from_pool;
+      rest.amount = std::max<int64_t>(0, std::min(rest.amount, available_supply(st)));
+      st.supply += rest;
+      return from_pool + rest;
+   }
+
+   void sub_balance(uint64_t owner, const asset& value) {
+      auto it = holders.find(owner);
+      asset* from = it == holders.end() ? nullptr : it->second.find_balance(value.sym.code());
+      check(from != nullptr, "no balance object found");
+      check(from->amount >= value.amount, "overdrawn balance");
+      auto l_it = sub_ledgers.find({ owner, value.sym.code() });
+      if( l_it != sub_ledgers.end() )
+         check(value.amount <= from->amount - l_it->second.allocated.amount, "quantity exceeds unallocated balance");
+
+      holder& h = it->second;
+      *from -= value;
+      if( get_stats(value.sym.code()).options & newest_first_debit_option ) {
+         debit_transferins(h, value);
+         return;
+      }
+      erase_transferins(h, value.sym);
+      if( from->amount > 0 )
+         h.ins.push_back({ h.next_id(), *from, now });
+   }
+
+   // Takes value from the newest transfer ins of its symbol
+   static void debit_transferins(holder& h, asset value) {
+      for( size_t i = h.ins.size(); value.amount > 0; ) {
+         check(i > 0, "No transfer ins found");
+         transfer_in& tr = h.ins[--i];
+         if( tr.quantity.sym.code() != value.sym.code() )
+            continue;
+         check(tr.quantity.sym == value.sym, "Invalid precision in transferin!");
+         if( tr.quantity.amount <= value.amount ) {
+            value -= tr.quantity;
+            h.ins.erase(h.ins.begin() + i);
+         } else {
+            tr.quantity -= value;
+            value.amount = 0;
+         }
+      }
+   }
+
+   void add_balance(uint64_t owner, const asset& value) {
+      holder& h = holders[owner];
+      if( asset* to = h.find_balance(value.sym.code()) )
+         *to += value;
+      else
+         h.balances.push_back(value);
+
+      h.ins.push_back({ h.next_id(), value, now });
+   }
+
+   static void erase_transferins(holder& h, const symbol& sym) {
+      bool found = false;
+      auto end = std::remove_if(h.ins.begin(), h.ins.end(), [&](const transfer_in& tr) {
+         if( tr.quantity.sym.code() != sym.code() )
+            return false;
+         check(tr.quantity.sym == sym, "Invalid precision in transferin!");
+         found = true;
+         return true;
+      });
+      check(found, "No transfer ins found");
+      h.ins.erase(end, h.ins.end());
+   }
+};
+
+}
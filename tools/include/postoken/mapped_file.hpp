@@ -0,0 +1,47 @@
+#pragma once
+
+// Read-only memory mapping of a whole file
+
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace postoken {
+
+struct mapped_file {
+   const char* data = nullptr;
+   size_t      size = 0;
+
+   explicit mapped_file(const std::string& path) {
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if( fd < 0 )
+         throw std::runtime_error("cannot open " + path);
+      struct stat st;
+      fstat(fd, &st);
+      size = st.st_size;
+      if( size > 0 ) {
+         void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+         if( p == MAP_FAILED ) {
+            ::close(fd);
+            throw std::runtime_error("cannot map " + path);
+         }
+         madvise(p, size, MADV_SEQUENTIAL);
+         data = (const char*)p;
+      }
+      ::close(fd);
+   }
+
+   mapped_file(const mapped_file&) = delete;
+   mapped_file& operator=(const mapped_file&) = delete;
+
+   ~mapped_file() {
+      if( data )
+         munmap((void*)data, size);
+   }
+};
+
+}
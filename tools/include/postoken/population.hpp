@@ -0,0 +1,189 @@
+#pragma once
+
+// Parametric model of a token's holder population, for synthetic chain state at mainnet scale.
+//
+// Every holder has a balance of the first symbol and, with probability extra_symbol_share each,
+// of the others. Balances are log-normal. The number of transfer ins of a balance is heavy-tailed
+// (discrete Pareto with tail index rows_alpha, at most max_rows); the balance is split between them
+// at random and their times are uniform over the holding period, which starts up to history_days
+// before `time`. Transfer in ids of an owner follow their times over all symbols, as
+// available_primary_key gives them on chain.
+//
+// Holder i is generated from its own random stream, so a population doesn't depend on how it is
+// split between threads.
+
+#include <postoken/columnar.hpp>
+
+#include <cmath>
+#include <exception>
+#include <random>
+#include <thread>
+
+namespace postoken {
+
+struct population_config {
+   uint32_t                holders            = 1000000;
+   std::vector<symbol>     symbols            = { string_to_symbol("4,POSA"), string_to_symbol("4,POSB"),
+                                                  string_to_symbol("6,POSC") };
+   double                  extra_symbol_share = 0.3;  // probability of holding each symbol after the first
+   double                  balance_median     = 1000; // tokens
+   double                  balance_sigma      = 2;    // of the balance's natural logarithm
+   double                  rows_alpha         = 1.2;  // tail index of transfer in counts, lower is heavier
+   uint32_t                max_rows           = 10000;
+   timestamp_t             time               = 1577836800; // 2020-01-01, the tester's genesis
+   uint32_t                history_days       = 730;
+   uint64_t                issuer             = string_to_name("postoken");
+   double                  max_supply_factor  = 10; // max_supply = supply * factor
+   uint16_t                min_coin_age       = 3;
+   uint16_t                max_coin_age       = 90;
+   // Tiers as in setstakespec, rates as fractions (interest_rate 0.0500 TOK is 0.05)
+   std::vector<std::pair<double, uint16_t>> interests = { { 0.1, 1 }, { 0.05, 0 } };
+   uint64_t                seed               = 1;
+};
+
+// Distinct valid account names: "g" followed by the index in base 31 (digits 1-5, a-z)
+inline uint64_t population_holder_name(uint32_t i) {
+   static const char digits[] = "12345abcdefghijklmnopqrstuvwxyz";
+   std::string s(7, '1');
+   s[0] = 'g';
+   for( int p = 6; p > 0; p--, i /= 31 )
+      s[p] = digits[i % 31];
+   return string_to_name(s);
+}
+
+// Rows of holders [begin, end), grouped by owner; adds each symbol's balances to supply
+inline void generate_holders(const population_config& cfg, uint32_t begin, uint32_t end, columnar_table& out,
+                             std::vector<int64_t>& supply) {
+   struct pending_row {
+      timestamp_t time;
+      asset       quantity;
+   };
+   std::vector<pending_row> rows;
+   std::vector<double>      weights;
+   const timestamp_t        history = cfg.history_days * 86400;
+
+   for( uint32_t h = begin; h < end; h++ ) {
+      std::mt19937_64 rng(cfg.seed * 0x9e3779b97f4a7c15ULL + h);
+      std::uniform_real_distribution<double> uniform(0, 1);
+      std::lognormal_distribution<double>    balance_dist(std::log(cfg.balance_median), cfg.balance_sigma);
+      std::exponential_distribution<double>  weight_dist(1);
+      const uint64_t owner = population_holder_name(h);
+
+      rows.clear();
+      for( size_t s = 0; s < cfg.symbols.size(); s++ ) {
+         if( s > 0 && uniform(rng) >= cfg.extra_symbol_share )
+            continue;
+         const symbol sym = cfg.symbols[s];
+         double units = std::min(balance_dist(rng) * pow10(sym.precision()), 1e15);
+         int64_t balance = std::max<int64_t>(1, int64_t(units));
+
+         // Discrete Pareto: P(count >= k) = k^-alpha
+         double  u     = 1 - uniform(rng);
+         int64_t count = int64_t(std::min<double>(std::floor(std::pow(u, -1 / cfg.rows_alpha)), cfg.max_rows));
+         count = std::max<int64_t>(1, std::min(count, balance));
+
+         // Every row gets at least one unit, the rest is split in random proportions
+         weights.resize(count);
+         double total = 0;
+         for( auto& w : weights )
+            total += (w = weight_dist(rng));
+         int64_t left = balance - count;
+         timestamp_t first = cfg.time - timestamp_t(uniform(rng) * history);
+         for( int64_t i = 0; i < count; i++ ) {
+            int64_t share = i + 1 == count ? left : std::min(left, int64_t(weights[i] / total * (balance - count)));
+            left -= share;
+            timestamp_t t = first + timestamp_t(uniform(rng) * (cfg.time - first));
+            rows.push_back({ t, asset(share + 1, sym) });
+         }
+         out.add_balance(owner, asset(balance, sym));
+         supply[s] += balance;
+         check(supply[s] <= asset::max_amount, "supply overflow, lower balance_median");
+      }
+
+      std::stable_sort(rows.begin(), rows.end(), [](const pending_row& a, const pending_row& b) {
+         return a.time < b.time;
+      });
+      for( size_t i = 0; i < rows.size(); i++ )
+         out.add_transfer_in(owner, { i, rows[i].quantity, rows[i].time });
+   }
+}
+
+// stat rows of the population's symbols, given their supply
+inline std::vector<currency_stats> population_stats(const population_config& cfg, const std::vector<int64_t>& supply) {
+   std::vector<currency_stats> stats;
+   for( size_t s = 0; s < cfg.symbols.size(); s++ ) {
+      const symbol sym = cfg.symbols[s];
+      currency_stats st;
+      st.supply     = asset(supply[s], sym);
+      st.max_supply = asset(int64_t(std::min(supply[s] * cfg.max_supply_factor, double(asset::max_amount))), sym);
+      st.issuer       = cfg.issuer;
+      st.min_coin_age = cfg.min_coin_age;
+      st.max_coin_age = cfg.max_coin_age;
+      for( const auto& tier : cfg.interests )
+         st.anual_interests.push_back({ asset(int64_t(std::llround(tier.first * pow10(sym.precision()))), sym),
+                                        tier.second });
+      st.stake_start_time = cfg.time - cfg.history_days * 86400;
+      stats.push_back(st);
+   }
+   return stats;
+}
+
+// The whole population, generated on `threads` threads
+inline columnar_table generate_population(const population_config& cfg, unsigned threads) {
+   check(!cfg.symbols.empty(), "population needs at least one symbol");
+   check(cfg.max_rows > 0, "max_rows has to be positive");
+   threads = std::max(1u, std::min<unsigned>(threads, std::max<uint32_t>(1, cfg.holders / 1024)));
+
+   std::vector<columnar_table>       parts(threads);
+   std::vector<std::vector<int64_t>> supplies(threads, std::vector<int64_t>(cfg.symbols.size()));
+   std::vector<std::exception_ptr>   errors(threads);
+   std::vector<std::thread>          workers;
+   for( unsigned t = 0; t < threads; t++ ) {
+      workers.emplace_back([&, t] {
+         uint32_t begin = uint64_t(cfg.holders) * t / threads, end = uint64_t(cfg.holders) * (t + 1) / threads;
+         try {
+            generate_holders(cfg, begin, end, parts[t], supplies[t]);
+         } catch( ... ) {
+            errors[t] = std::current_exception();
+         }
+      });
+   }
+   for( auto& w : workers )
+      w.join();
+   for( auto& e : errors )
+      if( e )
+         std::rethrow_exception(e);
+
+   columnar_table out;
+   std::vector<int64_t> supply(cfg.symbols.size());
+   size_t rows = 0;
+   for( const auto& p : parts )
+      rows += p.size();
+   out.owner.reserve(rows);
+   out.symbol.reserve(rows);
+   out.amount.reserve(rows);
+   out.id.reserve(rows);
+   out.time.reserve(rows);
+   out.kind.reserve(rows);
+   for( unsigned t = 0; t < threads; t++ ) {
+      auto append = [](auto& to, auto& from) {
+         to.insert(to.end(), from.begin(), from.end());
+         from.clear();
+         from.shrink_to_fit();
+      };
+      append(out.owner, parts[t].owner);
+      append(out.symbol, parts[t].symbol);
+      append(out.amount, parts[t].amount);
+      append(out.id, parts[t].id);
+      append(out.time, parts[t].time);
+      append(out.kind, parts[t].kind);
+      for( size_t s = 0; s < supply.size(); s++ ) {
+         supply[s] += supplies[t][s];
+         check(supply[s] <= asset::max_amount, "supply overflow, lower balance_median");
+      }
+   }
+   out.stats = population_stats(cfg, supply);
+   return out;
+}
+
+}
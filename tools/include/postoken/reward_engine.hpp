@@ -0,0 +1,176 @@
+#pragma once
+
+// Batch evaluation of what mint would issue to every holder, over the columns of a columnar file.
+// Results are those of the contract: the coin age terms are the same integers with the same
+// overflow checks, and the reward itself goes through coin_age_reward() and limit_reward().
+//
+// The per row pass is branch-free over fixed width columns so the compiler vectorizes it; rows are
+// split between threads at owner boundaries.
+
+#include <postoken/columnar.hpp>
+
+#include <thread>
+
+namespace postoken {
+
+enum reward_status : uint8_t {
+   reward_ok          = 0,
+   nothing_to_claim   = 1, // mint would fail with "Nothing to claim"
+   reward_overflow    = 2, // mint would fail an asset overflow check
+   max_supply_reached = 3, // mint would fail with "Max supply reached"
+   has_sub_ledger     = 4, // mint would fail with "Balance has a sub-ledger, use submint"
+   invalid_precision  = 5  // mint would fail with "Invalid precision in transferin!"
+};
+
+struct pending_reward {
+   uint64_t      owner;
+   int64_t       coin_age; // sum of quantity * days as accumulated by mint (undefined on overflow)
+   int64_t       reward;   // what mint would issue, 0 unless status is reward_ok
+   reward_status status;
+};
+
+namespace detail {
+
+// For rows [begin, end): term = amount * clamped day age of the transfer ins of sym (0 for other rows),
+// ovf set where that product exceeds asset::max_amount.
+// amount < 2^62 and age < 2^16, so the product is split in 32 bit halves which can't overflow uint64.
+inline void coin_age_terms(const columnar_view& c, size_t begin, size_t end, uint64_t sym,
+                           const currency_stats& st, timestamp_t now, uint64_t* term, uint8_t* ovf) {
+   const uint32_t stake_start = st.stake_start_time;
+   const uint32_t min_age     = st.min_coin_age;
+   const uint32_t max_age     = st.max_coin_age;
+   const uint64_t* symbol     = c.symbol + begin;
+   const int64_t*  amount     = c.amount + begin;
+   const uint32_t* time       = c.time + begin;
+   const uint8_t*  kind       = c.kind + begin;
+   const size_t    n          = end - begin;
+
+   for( size_t i = 0; i < n; i++ ) {
+      uint32_t start = time[i] > stake_start ? time[i] : stake_start;
+      uint32_t days  = (now - start) / 86400;
+      uint32_t age   = days < min_age ? 0 : (days < max_age ? days : max_age);
+      uint64_t match = uint64_t(kind[i] == transfer_in_row) & uint64_t(symbol[i] == sym);
+      uint64_t q     = uint64_t(amount[i]) & (0 - match);
+      uint64_t hi    = (q >> 32) * age;
+      uint64_t lo    = (q & 0xffffffff) * age;
+      uint64_t low62 = ((hi & ((1ull << 30) - 1)) << 32) + lo;
+      term[i] = low62;
+      ovf[i]  = uint8_t((hi >> 30) != 0) | uint8_t(low62 > uint64_t(asset::max_amount));
+   }
+}
+
+// Reward of one owner, the tail of postoken::mint (ledger: the owner has a sub-ledger of the token,
+// mismatch: coin age stopped at a transfer in of the token with another precision)
+inline void finish_reward(pending_reward& r, bool overflow, bool ledger, bool mismatch, const currency_stats& st,
+                          const asset& interest_rate) {
+   r.reward = 0;
+   if( ledger ) {
+      // Checked by mint before coin age, the balance earns through submint
+      r.status = has_sub_ledger;
+      return;
+   }
+   if( overflow ) {
+      r.status = reward_overflow;
+      return;
+   }
+   asset reward;
+   try {
+      reward = coin_age_reward(asset(r.coin_age, st.max_supply.sym), interest_rate);
+   } catch( const rules_error& ) {
+      r.status = reward_overflow;
+      return;
+   }
+   if( reward.amount <= 0 ) {
+      r.status = nothing_to_claim;
+   } else if( st.max_supply.amount - st.supply.amount <= 0 ) {
+      r.status = max_supply_reached;
+   } else if( mismatch ) {
+      // Replacing the transfer ins fails on that row once the reward is issued
+      r.status = invalid_precision;
+   } else {
+      r.reward = limit_reward(st, reward).amount;
+      r.status = reward_ok;
+   }
+}
+
+inline void pending_rewards_range(const columnar_view& c, size_t begin, size_t end, const currency_stats& st,
+                                  timestamp_t now, const asset& interest_rate, std::vector<pending_reward>& out) {
+   const size_t   block    = 4096;
+   const uint64_t sym      = st.max_supply.sym.value;
+   const uint64_t sym_code = st.max_supply.sym.code();
+   uint64_t term[block];
+   uint8_t  ovf[block];
+
+   pending_reward r{};
+   bool found = false, overflow = false, ledger = false, mismatch = false;
+   for( size_t b = begin; b < end; b += block ) {
+      size_t e = std::min(end, b + block);
+      coin_age_terms(c, b, e, sym, st, now, term, ovf);
+      for( size_t i = b; i < e; i++ ) {
+         if( c.owner[i] != r.owner || i == begin ) {
+            if( found ) {
+               finish_reward(r, overflow, ledger, mismatch, st, interest_rate);
+               out.push_back(r);
+            }
+            r = pending_reward{ c.owner[i], 0, 0, reward_ok };
+            found = overflow = ledger = mismatch = false;
+         }
+         // mint walks the symbol index (id order) only while the precision matches
+         bool of_code = c.kind[i] == transfer_in_row && (c.symbol[i] >> 8) == sym_code;
+         mismatch |= of_code && c.symbol[i] != sym;
+         if( !mismatch ) {
+            // Sums of values <= max_amount stay below 2^63, and once over max_amount mint would have failed
+            r.coin_age += term[i - b];
+            overflow   |= ovf[i - b] | (uint64_t(r.coin_age) > uint64_t(asset::max_amount));
+         }
+         found  |= of_code;
+         ledger |= c.kind[i] == sub_ledger_row && (c.symbol[i] >> 8) == sym_code;
+      }
+   }
+   if( found ) {
+      finish_reward(r, overflow, ledger, mismatch, st, interest_rate);
+      out.push_back(r);
+   }
+}
+
+}
+
+// Rewards mint would issue at time now to every owner with transfer ins of st's token, each claim
+// evaluated on its own against the current supply. Rows of an owner have to be adjacent, as written
+// by postoken-extract. Throws rules_error where every mint would fail (staking not started, 0 rate)
+// and for tokens with deferred_supply_option.
+inline std::vector<pending_reward> compute_pending_rewards(const columnar_view& c, const currency_stats& st,
+                                                           timestamp_t now, unsigned threads = 1) {
+   // mint of such tokens draws from reward pool budgets first, which aren't part of the rows
+   check(!(st.options & deferred_supply_option), "Deferred supply token, rewards depend on its reward pool");
+   check(st.stake_start_time < now, "Can't mint before stake start time");
+   asset interest_rate = get_interest_rate(st, now);
+   check(interest_rate.amount > 0, "Nothing to claim: 0 interest rate");
+
+   threads = std::max(1u, std::min<unsigned>(threads, c.rows / 4096 + 1));
+   std::vector<size_t> bounds{ 0 };
+   for( unsigned t = 1; t < threads; t++ ) {
+      size_t b = std::max<size_t>(bounds.back(), c.rows * t / threads);
+      while( b > 0 && b < c.rows && c.owner[b] == c.owner[b - 1] )
+         b++;
+      bounds.push_back(b);
+   }
+   bounds.push_back(c.rows);
+
+   std::vector<std::vector<pending_reward>> parts(threads);
+   std::vector<std::thread> workers;
+   for( unsigned t = 0; t < threads; t++ ) {
+      workers.emplace_back([&, t]() {
+         detail::pending_rewards_range(c, bounds[t], bounds[t + 1], st, now, interest_rate, parts[t]);
+      });
+   }
+   for( auto& w : workers )
+      w.join();
+
+   std::vector<pending_reward> res;
+   for( auto& p : parts )
+      res.insert(res.end(), p.begin(), p.end());
+   return res;
+}
+
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+// Native re-implementation of the types and staking rules of the postoken contract
+// (include/postoken.hpp, src/postoken.cpp). Arithmetic, overflow checks and error
+// messages follow the contract (and eosio::asset) so results are bit-identical.
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace postoken {
+
+// Thrown where the contract would fail a check()
+struct rules_error : std::runtime_error {
+   using std::runtime_error::runtime_error;
+};
+
+inline void check(bool pred, const char* msg) {
+   if( !pred )
+      throw rules_error(msg);
+}
+
+typedef uint32_t timestamp_t;
+
+inline uint32_t epoch_to_days(uint32_t epoch_time) {
+   return epoch_time / 60 / 60 / 24;
+}
+
+// eosio::name encoding
+inline uint64_t char_to_value(char c) {
+   if( c >= 'a' && c <= 'z' )
+      return (c - 'a') + 6;
+   if( c >= '1' && c <= '5' )
+      return (c - '1') + 1;
+   check(c == '.', "character is not in allowed character set for names");
+   return 0;
+}
+
+inline uint64_t string_to_name(const std::string& str) {
+   check(str.size() <= 13, "string is too long to be a valid name");
+   uint64_t value = 0;
+   for( size_t i = 0; i < str.size() && i < 12; i++ )
+      value |= (char_to_value(str[i]) & 0x1f) << (64 - 5 * (i + 1));
+   if( str.size() == 13 )
+      value |= char_to_value(str[12]) & 0x0f;
+   return value;
+}
+
+inline std::string name_to_string(uint64_t value) {
+   static const char* charmap = ".12345abcdefghijklmnopqrstuvwxyz";
+   std::string str(13, '.');
+   uint64_t tmp = value;
+   for( uint32_t i = 0; i <= 12; ++i ) {
+      char c = charmap[tmp & (i == 0 ? 0x0f : 0x1f)];
+      str[12 - i] = c;
+      tmp >>= (i == 0 ? 4 : 5);
+   }
+   str.erase(str.find_last_not_of('.') + 1);
+   return str;
+}
+
+// eosio::symbol_code raw value
+inline uint64_t string_to_symbol_code(const std::string& str) {
+   check(!str.empty() && str.size() <= 7, "invalid symbol name");
+   uint64_t value = 0;
+   for( auto it = str.rbegin(); it != str.rend(); ++it ) {
+      check(*it >= 'A' && *it <= 'Z', "invalid symbol name");
+      value <<= 8;
+      value |= *it;
+   }
+   return value;
+}
+
+inline std::string symbol_code_to_string(uint64_t code) {
+   std::string str;
+   for( ; code; code >>= 8 )
+      str += char(code & 0xff);
+   return str;
+}
+
+struct symbol {
+   uint64_t value = 0;
+
+   symbol() = default;
+   explicit symbol(uint64_t v) : value(v) {}
+   symbol(uint64_t code, uint8_t precision) : value((code << 8) | precision) {}
+
+   uint8_t  precision() const { return value & 0xff; }
+   uint64_t code() const { return value >> 8; }
+
+   friend bool operator==(const symbol& a, const symbol& b) { return a.value == b.value; }
+   friend bool operator!=(const symbol& a, const symbol& b) { return a.value != b.value; }
+};
+
+// "4,TOK"
+inline symbol string_to_symbol(const std::string& str) {
+   auto comma = str.find(',');
+   check(comma != std::string::npos, "invalid symbol");
+   return symbol(string_to_symbol_code(str.substr(comma + 1)), (uint8_t)std::stoul(str.substr(0, comma)));
+}
+
+// eosio::asset with the same range checks
+struct asset {
+   static constexpr int64_t max_amount = (1LL << 62) - 1;
+
+   int64_t amount = 0;
+   symbol  sym;
+
+   asset() = default;
+   asset(int64_t a, symbol s) : amount(a), sym(s) {
+      check(is_amount_within_range(), "magnitude of asset amount must be less than 2^62");
+   }
+
+   bool is_amount_within_range() const { return -max_amount <= amount && amount <= max_amount; }
+   bool is_valid() const { return is_amount_within_range() && sym.precision() <= 18; }
+
+   asset operator-() const { return asset(-amount, sym); }
+
+   asset& operator+=(const asset& a) {
+      check(a.sym == sym, "attempt to add asset with different symbol");
+      amount += a.amount;
+      check(-max_amount <= amount, "addition underflow");
+      check(amount <= max_amount, "addition overflow");
+      return *this;
+   }
+
+   asset& operator-=(const asset& a) {
+      check(a.sym == sym, "attempt to subtract asset with different symbol");
+      amount -= a.amount;
+      check(-max_amount <= amount, "subtraction underflow");
+      check(amount <= max_amount, "subtraction overflow");
+      return *this;
+   }
+
+   asset& operator*=(int64_t a) {
+      __int128 tmp = (__int128)amount * (__int128)a;
+      check(tmp <= max_amount, "multiplication overflow");
+      check(tmp >= -max_amount, "multiplication underflow");
+      amount = (int64_t)tmp;
+      return *this;
+   }
+
+   asset& operator/=(int64_t a) {
+      check(a != 0, "divide by zero");
+      check(!(amount == std::numeric_limits<int64_t>::min() && a == -1), "signed division overflow");
+      amount /= a;
+      return *this;
+   }
+
+   friend asset operator+(const asset& a, const asset& b) { asset r = a; r += b; return r; }
+   friend asset operator-(const asset& a, const asset& b) { asset r = a; r -= b; return r; }
+   friend asset operator*(const asset& a, int64_t b) { asset r = a; r *= b; return r; }
+   friend asset operator*(int64_t b, const asset& a) { asset r = a; r *= b; return r; }
+   friend asset operator/(const asset& a, int64_t b) { asset r = a; r /= b; return r; }
+
+   friend bool operator==(const asset& a, const asset& b) { return a.sym == b.sym && a.amount == b.amount; }
+   friend bool operator!=(const asset& a, const asset& b) { return !(a == b); }
+   friend bool operator<(const asset& a, const asset& b) {
+      check(a.sym == b.sym, "comparison of assets with different symbols is not allowed");
+      return a.amount < b.amount;
+   }
+};
+
+// "1.0000 TOK"
+inline asset string_to_asset(const std::string& str) {
+   auto space = str.find(' ');
+   check(space != std::string::npos, "asset's amount and symbol should be separated with space");
+   std::string amount_str = str.substr(0, space);
+   std::string code = str.substr(space + 1);
+   bool negative = !amount_str.empty() && amount_str[0] == '-';
+   if( negative )
+      amount_str.erase(0, 1);
+
+   auto dot = amount_str.find('.');
+   uint8_t precision = dot == std::string::npos ? 0 : amount_str.size() - dot - 1;
+   if( dot != std::string::npos )
+      amount_str.erase(dot, 1);
+   check(!amount_str.empty() && amount_str.find_first_not_of("0123456789") == std::string::npos,
+         "invalid asset amount");
+   int64_t amount = std::stoll(amount_str);
+   return asset(negative ? -amount : amount, symbol(string_to_symbol_code(code), precision));
+}
+
+inline std::string asset_to_string(const asset& a) {
+   uint8_t p = a.sym.precision();
+   bool negative = a.amount < 0;
+   std::string digits = std::to_string(negative ? -a.amount : a.amount);
+   if( p > 0 ) {
+      if( digits.size() <= p )
+         digits.insert(0, p + 1 - digits.size(), '0');
+      digits.insert(digits.size() - p, ".");
+   }
+   return (negative ? "-" : "") + digits + " " + symbol_code_to_string(a.sym.code());
+}
+
+inline int64_t pow10(uint8_t precision) {
+   int64_t p = 1;
+   for( uint8_t i = 0; i < precision; i++ )
+      p *= 10;
+   return p;
+}
+
+struct interest_t {
+   asset    interest_rate;
+   uint16_t years = 0;
+};
+
+struct currency_stats {
+   asset                   supply;
+   asset                   max_supply;
+   uint64_t                issuer = 0;
+   uint16_t                min_coin_age = 0; // days
+   uint16_t                max_coin_age = 0; // days
+   std::vector<interest_t> anual_interests;
+   timestamp_t             stake_start_time = 0; // epoch time in seconds
+   uint32_t                options = 0;          // token_option bits (setoptions), a binary extension of the row
+};
+
+// postoken::token_option
+enum token_option : uint32_t {
+   holder_registry_option     = 1,
+   balance_checkpoints_option = 2,
+   newest_first_debit_option  = 4,
+   deferred_supply_option     = 8
+};
+constexpr uint32_t known_options = holder_registry_option | balance_checkpoints_option | newest_first_debit_option |
+                                   deferred_supply_option;
+constexpr uint16_t max_pool_shards = 256;
+
+struct transfer_in {
+   uint64_t    id = 0;
+   asset       quantity;
+   timestamp_t time = 0;
+};
+
+// postoken::get_interest_rate (Stats is currency_stats or client.hpp's currency_stats_view)
+template<typename Stats>
+asset get_interest_rate(const Stats& stats, uint32_t epoch_time) {
+   asset interest_rate(0, stats.max_supply.sym);
+   uint32_t years_passed = epoch_to_days(epoch_time - stats.stake_start_time) / 365;
+   uint16_t y = 0;
+   for( const interest_t& rate : stats.anual_interests ) {
+      if( rate.years + y > years_passed || rate.years == 0 ) {
+         interest_rate = rate.interest_rate;
+         break;
+      }
+      y += rate.years;
+   }
+   return interest_rate;
+}
+
+// Contribution of one transfer in to coin age at curr_time (coin age loop of postoken::mint)
+template<typename Stats>
+int64_t coin_age_days(const Stats& st, timestamp_t time, timestamp_t curr_time) {
+   uint32_t start_time = std::max(st.stake_start_time, time);
+   uint32_t age = epoch_to_days(curr_time - start_time);
+   if( age < st.min_coin_age )
+      return 0;
+   return std::min(static_cast<uint32_t>(st.max_coin_age), age);
+}
+
+// Transfer in which earns max_coin_age days from now on, can be folded by compact
+inline bool is_matured(const currency_stats& st, timestamp_t time, timestamp_t curr_time) {
+   uint32_t start_time = std::max(st.stake_start_time, time);
+   return curr_time > start_time && epoch_to_days(curr_time - start_time) >= st.max_coin_age;
+}
+
+// Reward for accumulated coin_age, before it is limited by max_supply
+inline asset coin_age_reward(const asset& coin_age, const asset& interest_rate) {
+   asset m = asset(pow10(coin_age.sym.precision()), coin_age.sym);
+   return (coin_age.amount * interest_rate) / (365 * m).amount;
+}
+
+// Limits reward to what is left until max_supply (throws if nothing is left)
+inline asset limit_reward(const currency_stats& st, asset reward) {
+   asset rem = st.max_supply - st.supply;
+   check(rem.amount > 0, "Max supply reached");
+   if( rem < reward )
+      reward = rem;
+   return reward;
+}
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+// Reader for the contract_tables section of a nodeos portable snapshot
+// (producer_api create_snapshot, or --snapshot files).
+//
+// Snapshot layout (chain/snapshot.cpp, ostream_snapshot_writer):
+//   uint32 magic 0x30510550, uint32 version, then sections of
+//   uint64 size (bytes after this field), uint64 row count, null terminated name, rows
+//   and a uint64 0xffffffffffffffff end marker.
+// Every contract_tables row is a table_id_object {code, scope, table, payer, uint32 count}
+// followed by its kv, idx64, idx128, idx256, idx_double and idx_long_double rows, each group
+// as a varuint32 count and rows of {primary_key, payer, value or secondary key}.
+
+#include <postoken/datastream.hpp>
+
+namespace postoken {
+
+static const uint32_t snapshot_magic = 0x30510550;
+
+struct snapshot_table {
+   uint64_t code;
+   uint64_t scope;
+   uint64_t table;
+   uint64_t payer;
+   uint32_t count;
+};
+
+struct snapshot_kv_row {
+   uint64_t    primary_key;
+   uint64_t    payer;
+   const char* value;
+   uint32_t    size;
+};
+
+inline bool is_snapshot(const char* data, size_t size) {
+   uint32_t magic;
+   if( size < sizeof(magic) )
+      return false;
+   memcpy(&magic, data, sizeof(magic));
+   return magic == snapshot_magic;
+}
+
+// Calls f(table, row) for every primary row of every table of contract code.
+// Secondary index rows are skipped. Rows are referenced in place, nothing is copied.
+template<typename F>
+void read_snapshot_contract_rows(const char* data, size_t size, uint64_t code, F&& f) {
+   check(is_snapshot(data, size), "not a portable snapshot");
+   datastream ds(data, size);
+   ds.skip(sizeof(uint32_t) * 2);
+
+   bool found = false;
+   while( true ) {
+      uint64_t section_size = ds.read_raw<uint64_t>();
+      if( section_size == std::numeric_limits<uint64_t>::max() )
+         break;
+      check(section_size <= ds.remaining(), "truncated snapshot section");
+      datastream section(ds.pos(), section_size);
+      ds.skip(section_size);
+
+      section.skip(sizeof(uint64_t)); // row count
+      const char* name = section.pos();
+      const char* name_end = (const char*)memchr(name, '\0', section.remaining());
+      check(name_end != nullptr, "invalid snapshot section name");
+      section.skip(name_end - name + 1);
+      if( strcmp(name, "contract_tables") != 0 )
+         continue;
+
+      found = true;
+      static const size_t secondary_key_sizes[] = { 8, 16, 32, 8, 16 };
+      while( section.remaining() ) {
+         snapshot_table t;
+         t.code  = section.read_raw<uint64_t>();
+         t.scope = section.read_raw<uint64_t>();
+         t.table = section.read_raw<uint64_t>();
+         t.payer = section.read_raw<uint64_t>();
+         t.count = section.read_raw<uint32_t>();
+
+         uint32_t kv_count = section.read_varuint32();
+         for( uint32_t i = 0; i < kv_count; i++ ) {
+            snapshot_kv_row r;
+            r.primary_key = section.read_raw<uint64_t>();
+            r.payer       = section.read_raw<uint64_t>();
+            r.size        = section.read_varuint32();
+            r.value       = section.pos();
+            section.skip(r.size);
+            if( t.code == code )
+               f(t, r);
+         }
+         for( size_t key_size : secondary_key_sizes )
+            section.skip(section.read_varuint32() * (sizeof(uint64_t) * 2 + key_size));
+      }
+   }
+   check(found, "snapshot has no contract_tables section");
+}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+// Text dump of postoken tables, one row per line, sorted:
+//   stat <SYM> <supply> <max_supply> <issuer> <min_coin_age> <max_coin_age> <stake_start_time>
+//   account <owner> <balance>
+//   transferin <owner> <id> <quantity> <time>
+//   subledger <custodian> <allocated>
+// Tools which reconstruct or extract state write it, so their results can be diffed.
+
+#include <postoken/columnar.hpp>
+#include <postoken/ledger.hpp>
+
+#include <algorithm>
+#include <istream>
+#include <ostream>
+
+namespace postoken {
+
+inline std::string dump_stat_line(const currency_stats& st) {
+   return "stat " + symbol_code_to_string(st.supply.sym.code()) + " " + asset_to_string(st.supply) + " " +
+          asset_to_string(st.max_supply) + " " + name_to_string(st.issuer) + " " +
+          std::to_string(st.min_coin_age) + " " + std::to_string(st.max_coin_age) + " " +
+          std::to_string(st.stake_start_time);
+}
+
+inline std::string dump_account_line(uint64_t owner, const asset& balance) {
+   return "account " + name_to_string(owner) + " " + asset_to_string(balance);
+}
+
+inline std::string dump_transfer_in_line(uint64_t owner, const transfer_in& tr) {
+   return "transferin " + name_to_string(owner) + " " + std::to_string(tr.id) + " " +
+          asset_to_string(tr.quantity) + " " + std::to_string(tr.time);
+}
+
+inline std::string dump_sub_ledger_line(uint64_t custodian, const asset& allocated) {
+   return "subledger " + name_to_string(custodian) + " " + asset_to_string(allocated);
+}
+
+inline std::vector<std::string> dump_lines(const ledger& l) {
+   std::vector<std::string> lines;
+   for( const auto& st : l.stats )
+      lines.push_back(dump_stat_line(st.second));
+   for( const auto& h : l.holders ) {
+      for( const auto& b : h.second.balances )
+         lines.push_back(dump_account_line(h.first, b));
+      for( const auto& tr : h.second.ins )
+         lines.push_back(dump_transfer_in_line(h.first, tr));
+   }
+   for( const auto& sl : l.sub_ledgers )
+      lines.push_back(dump_sub_ledger_line(sl.first.first, sl.second.allocated));
+   std::sort(lines.begin(), lines.end());
+   return lines;
+}
+
+inline std::vector<std::string> dump_lines(const columnar_view& c) {
+   std::vector<std::string> lines;
+   for( const auto& st : c.stats() )
+      lines.push_back(dump_stat_line(st));
+   for( size_t i = 0; i < c.rows; i++ ) {
+      if( c.kind[i] == balance_row )
+         lines.push_back(dump_account_line(c.owner[i], c.row_asset(i)));
+      else if( c.kind[i] == sub_ledger_row )
+         lines.push_back(dump_sub_ledger_line(c.owner[i], c.row_asset(i)));
+      else
+         lines.push_back(dump_transfer_in_line(c.owner[i], { c.id[i], c.row_asset(i), c.time[i] }));
+   }
+   std::sort(lines.begin(), lines.end());
+   return lines;
+}
+
+inline std::vector<std::string> read_dump_lines(std::istream& in) {
+   std::vector<std::string> lines;
+   std::string line;
+   while( std::getline(in, line) )
+      if( !line.empty() )
+         lines.push_back(line);
+   std::sort(lines.begin(), lines.end());
+   return lines;
+}
+
+// Writes lines which are only in one of the dumps to out ("-" expected, "+" actual), returns their count
+inline size_t diff_dumps(const std::vector<std::string>& expected, const std::vector<std::string>& actual,
+                         std::ostream& out, size_t max_reported = 100) {
+   std::vector<std::string> missing, extra;
+   std::set_difference(expected.begin(), expected.end(), actual.begin(), actual.end(), std::back_inserter(missing));
+   std::set_difference(actual.begin(), actual.end(), expected.begin(), expected.end(), std::back_inserter(extra));
+   size_t reported = 0;
+   for( const auto& l : missing )
+      if( reported++ < max_reported )
+         out << "- " << l << "\n";
+   for( const auto& l : extra )
+      if( reported++ < max_reported )
+         out << "+ " << l << "\n";
+   return missing.size() + extra.size();
+}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+// Packing of eosio transactions and their signing digests, for submitting pre-built postoken
+// actions without cleos
+
+#include <postoken/client.hpp>
+#include <postoken/sha256.hpp>
+
+namespace postoken {
+
+struct permission_level {
+   uint64_t actor;
+   uint64_t permission;
+};
+
+struct packed_action {
+   uint64_t                      account;
+   uint64_t                      name;
+   std::vector<permission_level> authorization;
+   std::vector<char>             data;
+};
+
+struct transaction_header {
+   uint32_t expiration          = 0;
+   uint16_t ref_block_num       = 0;
+   uint32_t ref_block_prefix    = 0;
+   uint32_t max_net_usage_words = 0;
+   uint8_t  max_cpu_usage_ms    = 0;
+   uint32_t delay_sec           = 0;
+};
+
+// TaPoS fields from a block id (as in get_info's head_block_id)
+inline void set_reference_block(transaction_header& h, const std::string& block_id) {
+   std::vector<char> id = from_hex(block_id);
+   if( id.size() != 32 )
+      throw std::runtime_error("invalid block id");
+   uint32_t block_num = uint32_t(uint8_t(id[0])) << 24 | uint32_t(uint8_t(id[1])) << 16 |
+                        uint32_t(uint8_t(id[2])) << 8 | uint32_t(uint8_t(id[3]));
+   h.ref_block_num = uint16_t(block_num & 0xffff);
+   memcpy(&h.ref_block_prefix, id.data() + 8, sizeof(h.ref_block_prefix));
+}
+
+inline std::vector<char> pack_transaction(const transaction_header& h, const std::vector<packed_action>& actions) {
+   std::vector<char> out;
+   datastream_writer ds(out);
+   ds.write_raw(h.expiration);
+   ds.write_raw(h.ref_block_num);
+   ds.write_raw(h.ref_block_prefix);
+   ds.write_varuint32(h.max_net_usage_words);
+   ds.write_raw(h.max_cpu_usage_ms);
+   ds.write_varuint32(h.delay_sec);
+   ds.write_varuint32(0); // context free actions
+   ds.write_varuint32(actions.size());
+   for( const auto& a : actions ) {
+      ds.write_raw(a.account);
+      ds.write_raw(a.name);
+      ds.write_varuint32(a.authorization.size());
+      for( const auto& p : a.authorization ) {
+         ds.write_raw(p.actor);
+         ds.write_raw(p.permission);
+      }
+      ds.write_varuint32(a.data.size());
+      out.insert(out.end(), a.data.begin(), a.data.end());
+   }
+   ds.write_varuint32(0); // transaction extensions
+   return out;
+}
+
+inline sha256_digest transaction_id(const std::vector<char>& packed_trx) {
+   return sha256::hash(packed_trx.data(), packed_trx.size());
+}
+
+// What is signed: chain id, packed transaction and the digest of (empty) context free data
+inline sha256_digest signing_digest(const std::vector<char>& chain_id, const std::vector<char>& packed_trx) {
+   sha256 h;
+   h.update(chain_id.data(), chain_id.size());
+   h.update(packed_trx.data(), packed_trx.size());
+   uint8_t cfd_digest[32] = {};
+   h.update(cfd_digest, sizeof(cfd_digest));
+   return h.final();
+}
+
+// Action data of the postoken actions the load generator sends
+
+inline std::vector<char> pack_transfer(uint64_t from, uint64_t to, const asset& quantity, const std::string& memo) {
+   return pack_action(transfer_action{ from, to, quantity, memo });
+}
+
+inline std::vector<char> pack_issue(uint64_t to, const asset& quantity, const std::string& memo) {
+   return pack_action(issue_action{ to, quantity, memo });
+}
+
+inline std::vector<char> pack_mint(uint64_t account, uint64_t sym_code) {
+   return pack_action(mint_action{ account, sym_code });
+}
+
+}
@@ -0,0 +1,380 @@
+// postoken-load: closed-loop load generator for a local nodeos running postoken.
+//
+// Builds --transactions transfer, mint and issue transactions up front (random accounts from the
+// population, action types in the proportions of --mix), has keosd sign their digests, then pushes
+// them from --concurrency worker threads. Every worker keeps exactly one transaction in flight on
+// its own connection, so throughput is limited by the node, not by a configured rate.
+//
+// Reported per action type and overall: successful and failed pushes (with the most common errors),
+// sustained TPS, client latency percentiles and the CPU nodeos billed (receipt cpu_usage_us).
+
+#include <postoken/http_client.hpp>
+#include <postoken/json.hpp>
+#include <postoken/transaction.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+using namespace postoken;
+
+namespace {
+
+enum action_type { transfer_type, mint_type, issue_type, action_type_count };
+
+const char* action_type_names[action_type_count] = {"transfer", "mint", "issue"};
+
+struct load_config {
+   std::string           url        = "http://127.0.0.1:8888";
+   std::string           wallet_url = "http://127.0.0.1:8900";
+   uint64_t              contract   = string_to_name("postoken");
+   uint64_t              issuer     = 0;
+   uint64_t              permission = string_to_name("active");
+   std::vector<uint64_t> accounts;
+   std::vector<std::string> keys;
+   asset                 quantity;
+   double                mix[action_type_count] = {100, 0, 0};
+   uint32_t              transactions = 10000;
+   unsigned              concurrency  = 16;
+   double                duration     = 0; // seconds, 0 - until all transactions are pushed
+   uint32_t              expiration   = 300;
+   uint64_t              seed         = 1;
+};
+
+struct prepared_transaction {
+   action_type type;
+   std::string body; // push_transaction request
+};
+
+struct push_result {
+   action_type type;
+   bool        pushed = false;
+   bool        ok     = false;
+   int64_t     latency_us = 0;
+   int64_t     cpu_us     = 0;
+   double      completed  = 0; // seconds since start
+   std::string error;
+};
+
+std::vector<std::string> split(const std::string& s, char sep) {
+   std::vector<std::string> parts;
+   std::stringstream ss(s);
+   std::string part;
+   while( std::getline(ss, part, sep) )
+      if( !part.empty() )
+         parts.push_back(part);
+   return parts;
+}
+
+// "transfer=90,mint=5,issue=5"
+void parse_mix(const std::string& s, double (&mix)[action_type_count]) {
+   std::fill(std::begin(mix), std::end(mix), 0);
+   for( const auto& part : split(s, ',') ) {
+      auto eq = part.find('=');
+      check(eq != std::string::npos, "mix has to be TYPE=WEIGHT,...");
+      auto name = part.substr(0, eq);
+      auto type = std::find(std::begin(action_type_names), std::end(action_type_names), name);
+      if( type == std::end(action_type_names) )
+         throw std::runtime_error("unknown action type in mix: " + name);
+      mix[type - std::begin(action_type_names)] = std::stod(part.substr(eq + 1));
+   }
+}
+
+std::vector<uint64_t> read_accounts(const std::string& path) {
+   std::ifstream in(path);
+   if( !in )
+      throw std::runtime_error("cannot open " + path);
+   std::vector<uint64_t> accounts;
+   for( std::string line; std::getline(in, line); ) {
+      line.erase(line.find_last_not_of(" \t\r") + 1);
+      if( !line.empty() && line[0] != '#' )
+         accounts.push_back(string_to_name(line));
+   }
+   return accounts;
+}
+
+json::value rpc(http_client& client, const std::string& path, const std::string& body) {
+   http_response r = client.post(path, body);
+   if( r.status / 100 != 2 )
+      throw std::runtime_error(path + " failed with " + std::to_string(r.status) + ": " + r.body.substr(0, 512));
+   return json::parse(r.body);
+}
+
+// The most specific message of a nodeos error response
+std::string error_message(const std::string& body) {
+   try {
+      json::value v = json::parse(body);
+      const json::value& error = v["error"];
+      const json::value* details = error.find("details");
+      if( details && !details->array.empty() )
+         return (*details).array[0]["message"].as_string();
+      return error["what"].as_string();
+   } catch( const std::exception& ) {
+      return body.substr(0, 120);
+   }
+}
+
+std::vector<prepared_transaction> prepare(const load_config& cfg) {
+   http_client node(cfg.url);
+   json::value info = rpc(node, "/v1/chain/get_info", "{}");
+   std::vector<char> chain_id = from_hex(info["chain_id"].as_string());
+
+   transaction_header header;
+   set_reference_block(header, info["head_block_id"].as_string());
+   std::tm tm = {};
+   check(strptime(info["head_block_time"].as_string().c_str(), "%Y-%m-%dT%H:%M:%S", &tm) != nullptr,
+         "invalid head block time");
+   const uint32_t head_time = (uint32_t)timegm(&tm);
+
+   std::mt19937_64 rng(cfg.seed);
+   std::discrete_distribution<int> type_dist(std::begin(cfg.mix), std::end(cfg.mix));
+   std::vector<uint32_t> mints(cfg.accounts.size());
+
+   std::vector<prepared_transaction> trxs(cfg.transactions);
+   std::vector<sha256_digest>        digests(cfg.transactions);
+   std::vector<std::vector<char>>    packed(cfg.transactions);
+   for( uint32_t i = 0; i < cfg.transactions; i++ ) {
+      action_type   type = (action_type)type_dist(rng);
+      packed_action a;
+      a.account = cfg.contract;
+      header.expiration = head_time + cfg.expiration;
+      size_t from = rng() % cfg.accounts.size();
+      if( type == transfer_type ) {
+         size_t to = (from + 1 + rng() % (cfg.accounts.size() - 1)) % cfg.accounts.size();
+         a.name = string_to_name("transfer");
+         a.authorization.push_back({cfg.accounts[from], cfg.permission});
+         // The memo makes every transaction unique
+         a.data = pack_transfer(cfg.accounts[from], cfg.accounts[to], cfg.quantity, "load " + std::to_string(i));
+      } else if( type == mint_type ) {
+         a.name = string_to_name("mint");
+         a.authorization.push_back({cfg.accounts[from], cfg.permission});
+         a.data = pack_mint(cfg.accounts[from], cfg.quantity.sym.code());
+         // mint has no memo, repeated mints of an account differ in expiration instead
+         header.expiration += mints[from]++ % 3000;
+      } else {
+         a.name = string_to_name("issue");
+         a.authorization.push_back({cfg.issuer, cfg.permission});
+         a.data = pack_issue(cfg.issuer, cfg.quantity, "load " + std::to_string(i));
+      }
+      trxs[i].type = type;
+      packed[i]    = pack_transaction(header, {a});
+      digests[i]   = signing_digest(chain_id, packed[i]);
+   }
+
+   // keosd signs one digest per request; spread them over a few connections
+   std::atomic<uint32_t> next{ 0 };
+   std::vector<std::string> errors(std::min(cfg.concurrency, 8u));
+   std::vector<std::thread> workers;
+   for( size_t t = 0; t < errors.size(); t++ ) {
+      workers.emplace_back([&, t]() {
+         try {
+            http_client wallet(cfg.wallet_url);
+            for( uint32_t i; (i = next++) < cfg.transactions; ) {
+               std::string sigs;
+               for( const auto& key : cfg.keys ) {
+                  json::value sig = rpc(wallet, "/v1/wallet/sign_digest",
+                                        "[\"" + to_hex(digests[i]) + "\",\"" + key + "\"]");
+                  sigs += (sigs.empty() ? "\"" : ",\"") + sig.as_string() + "\"";
+               }
+               trxs[i].body = "{\"signatures\":[" + sigs +
+                              "],\"compression\":\"none\",\"packed_context_free_data\":\"\",\"packed_trx\":\"" +
+                              to_hex(packed[i].data(), packed[i].size()) + "\"}";
+            }
+         } catch( const std::exception& e ) {
+            errors[t] = e.what();
+            next = cfg.transactions;
+         }
+      });
+   }
+   for( auto& w : workers )
+      w.join();
+   for( const auto& e : errors )
+      if( !e.empty() )
+         throw std::runtime_error("signing failed: " + e);
+   return trxs;
+}
+
+std::vector<push_result> run(const load_config& cfg, const std::vector<prepared_transaction>& trxs, double& elapsed) {
+   using clock = std::chrono::steady_clock;
+   std::vector<push_result>   results(trxs.size());
+   std::atomic<uint32_t>      next{ 0 };
+   std::vector<std::thread>   workers;
+   const auto start = clock::now();
+   const auto seconds_since = [&](clock::time_point t) { return std::chrono::duration<double>(t - start).count(); };
+
+   for( unsigned t = 0; t < cfg.concurrency; t++ ) {
+      workers.emplace_back([&]() {
+         http_client node(cfg.url);
+         for( uint32_t i; (i = next++) < trxs.size(); ) {
+            if( cfg.duration > 0 && seconds_since(clock::now()) >= cfg.duration ) {
+               next = trxs.size();
+               break;
+            }
+            push_result& r = results[i];
+            r.type         = trxs[i].type;
+            auto sent      = clock::now();
+            try {
+               http_response resp = node.post("/v1/chain/push_transaction", trxs[i].body);
+               if( resp.status / 100 == 2 ) {
+                  json::value v = json::parse(resp.body);
+                  r.cpu_us      = v["processed"]["receipt"]["cpu_usage_us"].as_int64();
+                  r.ok          = true;
+               } else {
+                  r.error = error_message(resp.body);
+               }
+            } catch( const std::exception& e ) {
+               r.error = e.what();
+            }
+            auto now     = clock::now();
+            r.latency_us = std::chrono::duration_cast<std::chrono::microseconds>(now - sent).count();
+            r.completed  = seconds_since(now);
+            r.pushed     = true;
+         }
+      });
+   }
+   for( auto& w : workers )
+      w.join();
+   elapsed = seconds_since(clock::now());
+   results.erase(std::remove_if(results.begin(), results.end(), [](const push_result& r) { return !r.pushed; }),
+                 results.end());
+   return results;
+}
+
+int64_t percentile(std::vector<int64_t>& sorted, double p) {
+   return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, size_t(p * (sorted.size() - 1) + 0.5))];
+}
+
+void print_distribution(std::ostream& out, const char* what, std::vector<int64_t> v) {
+   std::sort(v.begin(), v.end());
+   out << "    " << what << ": p50 " << percentile(v, 0.5) << "  p90 " << percentile(v, 0.9) << "  p99 "
+       << percentile(v, 0.99) << "  max " << (v.empty() ? 0 : v.back()) << "\n";
+}
+
+void report(std::ostream& out, const std::vector<push_result>& results, double elapsed) {
+   for( int type = -1; type < action_type_count; type++ ) {
+      std::vector<int64_t> latency, cpu;
+      std::map<std::string, uint64_t> errors;
+      uint64_t failed = 0;
+      for( const auto& r : results ) {
+         if( type >= 0 && r.type != type )
+            continue;
+         latency.push_back(r.latency_us);
+         if( r.ok )
+            cpu.push_back(r.cpu_us);
+         else {
+            failed++;
+            errors[r.error]++;
+         }
+      }
+      if( latency.empty() )
+         continue;
+      out << (type < 0 ? "all" : action_type_names[type]) << ": " << cpu.size() << " ok, " << failed << " failed, "
+          << cpu.size() / elapsed << " tps\n";
+      print_distribution(out, "latency us", latency);
+      if( !cpu.empty() )
+         print_distribution(out, "billed cpu us", cpu);
+      std::vector<std::pair<uint64_t, std::string>> top;
+      for( const auto& e : errors )
+         top.emplace_back(e.second, e.first);
+      std::sort(top.rbegin(), top.rend());
+      for( size_t i = 0; i < std::min<size_t>(top.size(), 3); i++ )
+         out << "    " << top[i].first << " x " << top[i].second << "\n";
+   }
+
+   // Throughput of each whole second, to see whether the rate was sustained
+   std::vector<int64_t> per_second(static_cast<size_t>(elapsed));
+   for( const auto& r : results )
+      if( r.ok && size_t(r.completed) < per_second.size() )
+         per_second[size_t(r.completed)]++;
+   if( !per_second.empty() ) {
+      std::sort(per_second.begin(), per_second.end());
+      out << "tps per second over " << per_second.size() << " s: min " << per_second.front() << "  p50 "
+          << percentile(per_second, 0.5) << "  max " << per_second.back() << "\n";
+   }
+}
+
+void print_help() {
+   std::cout << "Usage:    postoken-load [OPTIONS] --accounts LIST --key PUBKEY --quantity ASSET\n"
+             << "Pushes pre-signed postoken transactions to nodeos from concurrent closed loops and reports\n"
+             << "sustained TPS, latency and billed CPU.\n"
+             << "  --url URL             nodeos (default: http://127.0.0.1:8888)\n"
+             << "  --wallet-url URL      unlocked keosd holding the keys (default: http://127.0.0.1:8900)\n"
+             << "  --contract NAME       (default: postoken)\n"
+             << "  --accounts LIST       comma separated account population\n"
+             << "  --accounts-file FILE  account population, one per line\n"
+             << "  --key PUBKEY          key of the accounts' (and issuer's) active permission, repeatable\n"
+             << "  --permission NAME     (default: active)\n"
+             << "  --issuer NAME         issuer of the token, needed for issue\n"
+             << "  --quantity ASSET      amount of each transfer and issue, its symbol is minted\n"
+             << "  --mix WEIGHTS         e.g. transfer=90,mint=5,issue=5 (default: transfer=100)\n"
+             << "  --transactions N      transactions to prepare (default: 10000)\n"
+             << "  --concurrency N       transactions in flight (default: 16)\n"
+             << "  --duration SECONDS    stop pushing after this time (default: when all are pushed)\n"
+             << "  --expiration SECONDS  after the head block time (default: 300)\n"
+             << "  --seed N              (default: 1)\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+   load_config cfg;
+   try {
+      for( int i = 1; i < argc; i++ ) {
+         std::string arg = argv[i];
+         auto next = [&]() -> std::string {
+            check(i + 1 < argc, "missing option value");
+            return argv[++i];
+         };
+         if( arg == "-h" || arg == "--help" ) {
+            print_help();
+            return 0;
+         }
+         else if( arg == "--url" )           cfg.url = next();
+         else if( arg == "--wallet-url" )    cfg.wallet_url = next();
+         else if( arg == "--contract" )      cfg.contract = string_to_name(next());
+         else if( arg == "--accounts" )      for( const auto& a : split(next(), ',') ) cfg.accounts.push_back(string_to_name(a));
+         else if( arg == "--accounts-file" ) for( auto a : read_accounts(next()) ) cfg.accounts.push_back(a);
+         else if( arg == "--key" )           cfg.keys.push_back(next());
+         else if( arg == "--permission" )    cfg.permission = string_to_name(next());
+         else if( arg == "--issuer" )        cfg.issuer = string_to_name(next());
+         else if( arg == "--quantity" )      cfg.quantity = string_to_asset(next());
+         else if( arg == "--mix" )           parse_mix(next(), cfg.mix);
+         else if( arg == "--transactions" )  cfg.transactions = std::stoul(next());
+         else if( arg == "--concurrency" )   cfg.concurrency = std::max(1ul, std::stoul(next()));
+         else if( arg == "--duration" )      cfg.duration = std::stod(next());
+         else if( arg == "--expiration" )    cfg.expiration = std::stoul(next());
+         else if( arg == "--seed" )          cfg.seed = std::stoull(next());
+         else {
+            print_help();
+            return 1;
+         }
+      }
+      check(cfg.accounts.size() >= 2, "need at least 2 accounts");
+      check(!cfg.keys.empty(), "no signing key (--key)");
+      check(cfg.quantity.amount > 0, "--quantity has to be positive");
+      check(cfg.mix[issue_type] == 0 || cfg.issuer != 0, "issue needs --issuer");
+      check(cfg.mix[transfer_type] + cfg.mix[mint_type] + cfg.mix[issue_type] > 0, "empty mix");
+
+      auto start = std::chrono::steady_clock::now();
+      std::vector<prepared_transaction> trxs = prepare(cfg);
+      std::cerr << "prepared and signed " << trxs.size() << " transactions in "
+                << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+
+      double elapsed = 0;
+      std::vector<push_result> results = run(cfg, trxs, elapsed);
+      std::cout << results.size() << " transactions pushed in " << elapsed << " s by " << cfg.concurrency
+                << " loops\n";
+      report(std::cout, results, elapsed);
+      return 0;
+   } catch( const std::exception& e ) {
+      std::cerr << "error: " << e.what() << std::endl;
+      return 1;
+   }
+}
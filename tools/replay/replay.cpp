@@ -0,0 +1,364 @@
+// postoken-replay: rebuilds postoken state (stat, accounts and transferins of every holder)
+// from a log of actions by applying them with the contract's rules.
+//
+// Input is either a binary action log (postoken/action_log.hpp) or JSON lines like
+//   {"time": 1562925600, "action": "transfer", "data": {"from": "acca", "to": "accb", "quantity": "1.0000 TOK", "memo": ""}}
+// where "time" may also be an ISO block time ("2019-07-12T10:00:00.000", UTC).
+
+#include <postoken/action_log.hpp>
+#include <postoken/json.hpp>
+#include <postoken/mapped_file.hpp>
+#include <postoken/state_dump.hpp>
+
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+
+using namespace postoken;
+
+namespace {
+
+const uint64_t n_create        = string_to_name("create");
+const uint64_t n_issue         = string_to_name("issue");
+const uint64_t n_retire        = string_to_name("retire");
+const uint64_t n_transfer      = string_to_name("transfer");
+const uint64_t n_xfer          = string_to_name("xfer");
+const uint64_t n_setdefsym     = string_to_name("setdefsym");
+const uint64_t n_open          = string_to_name("open");
+const uint64_t n_close         = string_to_name("close");
+const uint64_t n_openmany      = string_to_name("openmany");
+const uint64_t n_closemany     = string_to_name("closemany");
+const uint64_t n_setstakespec  = string_to_name("setstakespec");
+const uint64_t n_mint          = string_to_name("mint");
+const uint64_t n_mintall       = string_to_name("mintall");
+const uint64_t n_compact       = string_to_name("compact");
+const uint64_t n_setoptions    = string_to_name("setoptions");
+const uint64_t n_setrewardpool = string_to_name("setrewardpool");
+const uint64_t n_settle        = string_to_name("settle");
+const uint64_t n_subdeposit    = string_to_name("subdeposit");
+const uint64_t n_subwithdraw   = string_to_name("subwithdraw");
+const uint64_t n_submove       = string_to_name("submove");
+const uint64_t n_submint       = string_to_name("submint");
+const uint64_t n_subsettle     = string_to_name("subsettle");
+
+struct replay_stats {
+   uint64_t applied = 0;
+   uint64_t skipped = 0; // actions which don't change state (e.g. event)
+   uint64_t failed  = 0;
+};
+
+// Applies packed action data, returns false if action does not change state
+bool apply_binary(ledger& l, uint64_t action, datastream ds) {
+   if( action == n_transfer ) {
+      uint64_t from = ds.read_raw<uint64_t>();
+      uint64_t to   = ds.read_raw<uint64_t>();
+      l.transfer(from, to, ds.read_asset());
+   } else if( action == n_xfer ) {
+      uint64_t from = ds.read_raw<uint64_t>();
+      uint64_t to   = ds.read_raw<uint64_t>();
+      l.xfer(from, to, ds.read_raw<int64_t>());
+   } else if( action == n_mint ) {
+      uint64_t account = ds.read_raw<uint64_t>();
+      l.mint(account, ds.read_raw<uint64_t>());
+   } else if( action == n_mintall ) {
+      l.mintall(ds.read_raw<uint64_t>());
+   } else if( action == n_compact ) {
+      uint64_t account  = ds.read_raw<uint64_t>();
+      uint64_t sym_code = ds.read_raw<uint64_t>();
+      l.compact(account, sym_code, ds.read_raw<uint32_t>());
+   } else if( action == n_issue ) {
+      uint64_t to = ds.read_raw<uint64_t>();
+      l.issue(to, ds.read_asset());
+   } else if( action == n_retire ) {
+      l.retire(ds.read_asset());
+   } else if( action == n_open ) {
+      uint64_t owner = ds.read_raw<uint64_t>();
+      l.open(owner, ds.read_symbol());
+   } else if( action == n_close ) {
+      uint64_t owner = ds.read_raw<uint64_t>();
+      l.close(owner, ds.read_symbol());
+   } else if( action == n_openmany ) {
+      auto owners = ds.read_names();
+      l.openmany(owners, ds.read_symbol());
+   } else if( action == n_closemany ) {
+      auto owners = ds.read_names();
+      l.closemany(owners, ds.read_symbol());
+   } else if( action == n_create ) {
+      uint64_t issuer = ds.read_raw<uint64_t>();
+      l.create(issuer, ds.read_asset());
+   } else if( action == n_setoptions ) {
+      uint64_t sym_code = ds.read_raw<uint64_t>();
+      l.setoptions(sym_code, ds.read_raw<uint32_t>());
+   } else if( action == n_setrewardpool ) {
+      uint64_t sym_code = ds.read_raw<uint64_t>();
+      uint16_t shards   = ds.read_raw<uint16_t>();
+      l.setrewardpool(sym_code, shards, ds.read_asset());
+   } else if( action == n_settle ) {
+      l.settle(ds.read_raw<uint64_t>());
+   } else if( action == n_subdeposit || action == n_subwithdraw ) {
+      uint64_t custodian = ds.read_raw<uint64_t>();
+      uint64_t sub       = ds.read_raw<uint64_t>();
+      if( action == n_subdeposit )
+         l.subdeposit(custodian, sub, ds.read_asset());
+      else
+         l.subwithdraw(custodian, sub, ds.read_asset());
+   } else if( action == n_submove ) {
+      uint64_t custodian = ds.read_raw<uint64_t>();
+      uint64_t from      = ds.read_raw<uint64_t>();
+      uint64_t to        = ds.read_raw<uint64_t>();
+      l.submove(custodian, from, to, ds.read_asset());
+   } else if( action == n_submint ) {
+      uint64_t custodian = ds.read_raw<uint64_t>();
+      l.submint(custodian, ds.read_names());
+   } else if( action == n_subsettle ) {
+      uint64_t custodian = ds.read_raw<uint64_t>();
+      l.subsettle(custodian, ds.read_raw<uint64_t>());
+   } else if( action == n_setdefsym ) {
+      l.setdefsym(ds.read_raw<uint64_t>());
+   } else if( action == n_setstakespec ) {
+      uint32_t start   = ds.read_raw<uint32_t>();
+      uint16_t min_age = ds.read_raw<uint16_t>();
+      uint16_t max_age = ds.read_raw<uint16_t>();
+      l.setstakespec(start, min_age, max_age, ds.read_interests());
+   } else {
+      return false;
+   }
+   return true;
+}
+
+uint64_t json_name(const json::value& data, const char* field) {
+   return string_to_name(data[field].as_string());
+}
+
+asset json_asset(const json::value& data, const char* field) {
+   return string_to_asset(data[field].as_string());
+}
+
+bool apply_json(ledger& l, const std::string& action, const json::value& data) {
+   if( action == "transfer" ) {
+      l.transfer(json_name(data, "from"), json_name(data, "to"), json_asset(data, "quantity"));
+   } else if( action == "xfer" ) {
+      l.xfer(json_name(data, "from"), json_name(data, "to"), data["amount"].as_int64());
+   } else if( action == "mint" ) {
+      l.mint(json_name(data, "account"), string_to_symbol_code(data["sym_code"].as_string()));
+   } else if( action == "mintall" ) {
+      l.mintall(json_name(data, "account"));
+   } else if( action == "compact" ) {
+      l.compact(json_name(data, "account"), string_to_symbol_code(data["sym_code"].as_string()),
+                (uint32_t)data["max_rows"].as_uint64());
+   } else if( action == "issue" ) {
+      l.issue(json_name(data, "to"), json_asset(data, "quantity"));
+   } else if( action == "retire" ) {
+      l.retire(json_asset(data, "quantity"));
+   } else if( action == "open" ) {
+      l.open(json_name(data, "owner"), string_to_symbol(data["symbol"].as_string()));
+   } else if( action == "close" ) {
+      l.close(json_name(data, "owner"), string_to_symbol(data["symbol"].as_string()));
+   } else if( action == "openmany" || action == "closemany" ) {
+      std::vector<uint64_t> owners;
+      for( const auto& o : data["owners"].array )
+         owners.push_back(string_to_name(o.as_string()));
+      symbol sym = string_to_symbol(data["symbol"].as_string());
+      if( action == "openmany" )
+         l.openmany(owners, sym);
+      else
+         l.closemany(owners, sym);
+   } else if( action == "create" ) {
+      l.create(json_name(data, "issuer"), json_asset(data, "maximum_supply"));
+   } else if( action == "setoptions" ) {
+      l.setoptions(string_to_symbol_code(data["sym_code"].as_string()), (uint32_t)data["options"].as_uint64());
+   } else if( action == "setrewardpool" ) {
+      l.setrewardpool(string_to_symbol_code(data["sym_code"].as_string()), (uint16_t)data["shards"].as_uint64(),
+                      json_asset(data, "shard_budget"));
+   } else if( action == "settle" ) {
+      l.settle(string_to_symbol_code(data["sym_code"].as_string()));
+   } else if( action == "subdeposit" ) {
+      l.subdeposit(json_name(data, "custodian"), data["sub"].as_uint64(), json_asset(data, "quantity"));
+   } else if( action == "subwithdraw" ) {
+      l.subwithdraw(json_name(data, "custodian"), data["sub"].as_uint64(), json_asset(data, "quantity"));
+   } else if( action == "submove" ) {
+      l.submove(json_name(data, "custodian"), data["from"].as_uint64(), data["to"].as_uint64(),
+                json_asset(data, "quantity"));
+   } else if( action == "submint" ) {
+      std::vector<uint64_t> subs;
+      for( const auto& sub : data["subs"].array )
+         subs.push_back(sub.as_uint64());
+      l.submint(json_name(data, "custodian"), subs);
+   } else if( action == "subsettle" ) {
+      l.subsettle(json_name(data, "custodian"), string_to_symbol_code(data["sym_code"].as_string()));
+   } else if( action == "setdefsym" ) {
+      l.setdefsym(string_to_symbol_code(data["sym_code"].as_string()));
+   } else if( action == "setstakespec" ) {
+      std::vector<interest_t> interests;
+      for( const auto& i : data["anual_interests"].array ) {
+         interest_t it;
+         it.interest_rate = string_to_asset(i["interest_rate"].as_string());
+         it.years         = (uint16_t)i["years"].as_uint64();
+         interests.push_back(it);
+      }
+      l.setstakespec((uint32_t)data["stake_start_time"].as_uint64(), (uint16_t)data["min_coin_age"].as_uint64(),
+                     (uint16_t)data["max_coin_age"].as_uint64(), interests);
+   } else {
+      return false;
+   }
+   return true;
+}
+
+timestamp_t json_time(const json::value& line) {
+   const json::value* t = line.find("time");
+   if( !t )
+      t = &line["block_time"];
+   if( t->kind == json::value::number_t )
+      return (timestamp_t)t->as_uint64();
+
+   std::tm tm = {};
+   check(strptime(t->as_string().c_str(), "%Y-%m-%dT%H:%M:%S", &tm) != nullptr, "invalid block time");
+   return (timestamp_t)timegm(&tm);
+}
+
+void report_failure(replay_stats& stats, bool strict, const std::string& where, const std::exception& e) {
+   stats.failed++;
+   std::cerr << where << ": " << e.what() << std::endl;
+   if( strict )
+      throw;
+}
+
+void replay_binary(ledger& l, const char* data, size_t size, replay_stats& stats, bool strict) {
+   uint64_t n = 0;
+   read_action_log(data, size, [&](const action_record& r) {
+      n++;
+      l.now = r.time;
+      try {
+         if( apply_binary(l, r.name, datastream(r.data, r.size)) )
+            stats.applied++;
+         else
+            stats.skipped++;
+      } catch( const rules_error& e ) {
+         report_failure(stats, strict, "record " + std::to_string(n) + " (" + name_to_string(r.name) + ")", e);
+      }
+   });
+}
+
+void replay_json(ledger& l, const char* data, size_t size, replay_stats& stats, bool strict) {
+   const char* end = data + size;
+   uint64_t line_no = 0;
+   for( const char* pos = data; pos < end; ) {
+      const char* eol = (const char*)memchr(pos, '\n', end - pos);
+      if( !eol )
+         eol = end;
+      const char* line_begin = pos;
+      pos = eol + 1;
+      line_no++;
+      if( std::all_of(line_begin, eol, [](char c) { return isspace((unsigned char)c); }) )
+         continue;
+
+      std::string action;
+      try {
+         json::value line = json::parser(line_begin, eol).parse();
+         action = line["action"].as_string();
+         l.now  = json_time(line);
+         if( apply_json(l, action, line["data"]) )
+            stats.applied++;
+         else
+            stats.skipped++;
+      } catch( const rules_error& e ) {
+         report_failure(stats, strict, "line " + std::to_string(line_no) + " (" + action + ")", e);
+      }
+   }
+}
+
+// Expected state from a text dump or a columnar file (postoken-extract)
+std::vector<std::string> read_expected_lines(const std::string& path) {
+   {
+      mapped_file f(path);
+      if( columnar_view::is_columnar(f.data, f.size) )
+         return dump_lines(columnar_view(f.data, f.size));
+   }
+   std::ifstream in(path);
+   if( !in )
+      throw std::runtime_error("cannot open " + path);
+   return read_dump_lines(in);
+}
+
+void print_help() {
+   std::cout << "Usage:    postoken-replay [OPTIONS] LOG\n"
+             << "Replays a postoken action log (binary or JSON lines) and rebuilds all holder state.\n"
+             << "  --dump FILE     write resulting state as a text dump ('-' for stdout)\n"
+             << "  --verify FILE   compare resulting state with chain state (text dump or postoken-extract output)\n"
+             << "  --strict        stop at the first action which fails the contract's checks\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+   std::string log_path, dump_path, verify_path;
+   bool strict = false;
+   for( int i = 1; i < argc; i++ ) {
+      std::string arg = argv[i];
+      if( arg == "-h" || arg == "--help" ) {
+         print_help();
+         return 0;
+      } else if( arg == "--dump" && i + 1 < argc ) {
+         dump_path = argv[++i];
+      } else if( arg == "--verify" && i + 1 < argc ) {
+         verify_path = argv[++i];
+      } else if( arg == "--strict" ) {
+         strict = true;
+      } else {
+         log_path = arg;
+      }
+   }
+   if( log_path.empty() ) {
+      print_help();
+      return 1;
+   }
+
+   try {
+      mapped_file log(log_path);
+      ledger l;
+      replay_stats stats;
+
+      auto start = std::chrono::steady_clock::now();
+      if( is_action_log(log.data, log.size) )
+         replay_binary(l, log.data, log.size, stats, strict);
+      else
+         replay_json(l, log.data, log.size, stats, strict);
+      double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      size_t rows = 0;
+      for( const auto& h : l.holders )
+         rows += h.second.ins.size();
+      std::cerr << "applied " << stats.applied << " actions (" << stats.skipped << " skipped, " << stats.failed
+                << " failed) in " << secs << " s, " << uint64_t(stats.applied / std::max(secs, 1e-9))
+                << " actions/s\n"
+                << l.holders.size() << " holders, " << rows << " transfer ins\n";
+      for( const auto& st : l.stats )
+         std::cerr << "supply " << asset_to_string(st.second.supply) << " of "
+                   << asset_to_string(st.second.max_supply) << "\n";
+
+      std::vector<std::string> lines;
+      if( !dump_path.empty() || !verify_path.empty() )
+         lines = dump_lines(l);
+
+      if( !dump_path.empty() ) {
+         std::ofstream file;
+         std::ostream& out = dump_path == "-" ? std::cout : (file.open(dump_path), file);
+         for( const auto& line : lines )
+            out << line << "\n";
+      }
+
+      if( !verify_path.empty() ) {
+         size_t diffs = diff_dumps(read_expected_lines(verify_path), lines, std::cerr);
+         if( diffs > 0 ) {
+            std::cerr << diffs << " rows differ from " << verify_path << std::endl;
+            return 2;
+         }
+         std::cerr << "state matches " << verify_path << std::endl;
+      }
+      return stats.failed > 0 ? 3 : 0;
+   } catch( const std::exception& e ) {
+      std::cerr << "error: " << e.what() << std::endl;
+      return 1;
+   }
+}
@@ -0,0 +1,133 @@
+// postoken-rewards: computes what mint would issue to every holder at a given time, from a columnar
+// file written by postoken-extract. Rewards are bit-identical to the contract's.
+//
+// Output is CSV: owner,symbol,coin_age,reward,status where status is one of
+// ok, nothing_to_claim, overflow, max_supply_reached, sub_ledger, invalid_precision. Holders with a sub-ledger of the token
+// can't mint, their balance earns through submint.
+
+#include <postoken/mapped_file.hpp>
+#include <postoken/reward_engine.hpp>
+
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+
+using namespace postoken;
+
+namespace {
+
+const char* status_name(reward_status s) {
+   switch( s ) {
+      case reward_ok:          return "ok";
+      case nothing_to_claim:   return "nothing_to_claim";
+      case reward_overflow:    return "overflow";
+      case max_supply_reached: return "max_supply_reached";
+      case has_sub_ledger:     return "sub_ledger";
+      case invalid_precision:  return "invalid_precision";
+   }
+   return "unknown";
+}
+
+// Like asset_to_string, for sums which may not fit an asset
+std::string amount_to_string(__int128 v, const symbol& sym) {
+   bool negative = v < 0;
+   std::string s;
+   for( int digits = 0; v != 0 || digits <= sym.precision(); v /= 10, digits++ ) {
+      if( digits == sym.precision() && digits > 0 )
+         s += '.';
+      s += char('0' + int(negative ? -(v % 10) : v % 10));
+   }
+   if( negative )
+      s += '-';
+   return std::string(s.rbegin(), s.rend()) + " " + symbol_code_to_string(sym.code());
+}
+
+void print_help() {
+   std::cout << "Usage:    postoken-rewards [OPTIONS] COLUMNAR_FILE\n"
+             << "Computes pending staking rewards of all holders (what mint would issue to each of them).\n"
+             << "  --symbol CODE    only this token (default: every token in the file)\n"
+             << "  --time SECONDS   epoch time to evaluate at (default: now)\n"
+             << "  --threads N      worker threads (default: number of cores)\n"
+             << "  --out FILE       write per holder rewards as CSV ('-' for stdout)\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+   std::string path, out_path, sym_code;
+   timestamp_t now = (timestamp_t)std::time(nullptr);
+   unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+   for( int i = 1; i < argc; i++ ) {
+      std::string arg = argv[i];
+      if( arg == "-h" || arg == "--help" ) {
+         print_help();
+         return 0;
+      } else if( arg == "--symbol" && i + 1 < argc ) {
+         sym_code = argv[++i];
+      } else if( arg == "--time" && i + 1 < argc ) {
+         now = (timestamp_t)std::stoul(argv[++i]);
+      } else if( arg == "--threads" && i + 1 < argc ) {
+         threads = (unsigned)std::stoul(argv[++i]);
+      } else if( arg == "--out" && i + 1 < argc ) {
+         out_path = argv[++i];
+      } else {
+         path = arg;
+      }
+   }
+   if( path.empty() ) {
+      print_help();
+      return 1;
+   }
+
+   try {
+      mapped_file file(path);
+      columnar_view columns(file.data, file.size);
+
+      std::ofstream out_file;
+      std::ostream* out = nullptr;
+      if( !out_path.empty() ) {
+         out = out_path == "-" ? &std::cout : (out_file.open(out_path), &out_file);
+         *out << "owner,symbol,coin_age,reward,status\n";
+      }
+
+      for( const currency_stats& st : columns.stats() ) {
+         if( !sym_code.empty() && st.max_supply.sym.code() != string_to_symbol_code(sym_code) )
+            continue;
+         std::string code = symbol_code_to_string(st.max_supply.sym.code());
+
+         auto start = std::chrono::steady_clock::now();
+         std::vector<pending_reward> rewards;
+         try {
+            rewards = compute_pending_rewards(columns, st, now, threads);
+         } catch( const rules_error& e ) {
+            std::cerr << code << ": " << e.what() << std::endl;
+            continue;
+         }
+         double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+         __int128 total = 0;
+         uint64_t counts[6] = {};
+         for( const auto& r : rewards ) {
+            total += r.reward;
+            counts[r.status]++;
+         }
+         std::cerr << code << ": " << rewards.size() << " holders, " << counts[reward_ok] << " can claim "
+                   << amount_to_string(total, st.max_supply.sym) << ", " << counts[nothing_to_claim]
+                   << " nothing to claim, " << counts[reward_overflow] << " overflow, " << counts[max_supply_reached]
+                   << " max supply reached, " << counts[has_sub_ledger] << " with a sub-ledger, "
+                   << counts[invalid_precision] << " with mixed precisions; " << columns.rows << " rows in " << secs
+                   << " s\n";
+
+         if( out ) {
+            for( const auto& r : rewards )
+               *out << name_to_string(r.owner) << "," << code << "," << r.coin_age << ","
+                    << asset_to_string(asset(r.reward, st.max_supply.sym)) << "," << status_name(r.status) << "\n";
+         }
+      }
+      return 0;
+   } catch( const std::exception& e ) {
+      std::cerr << "error: " << e.what() << std::endl;
+      return 1;
+   }
+}
@@ -0,0 +1,376 @@
+// postoken-sim: Monte-Carlo simulation of staking under candidate setstakespec parameters.
+//
+// Every run creates a synthetic population (log-normal initial balances), then for each day lets
+// holders transfer to each other and claimers mint, applying the actions with the contract's rules
+// (postoken::ledger). Each combination of min_coin_age, max_coin_age and anual_interests given on
+// the command line is run --runs times with different seeds, spread over all cores.
+//
+// Run i uses the same seed for every combination, so combinations are compared on the same populations.
+// Reported per combination: supply at the end of each year (mean, 5th and 95th percentile over
+// runs), how often and when max_supply was reached, the number of transferins rows each mint and
+// transfer had to go through, and CPU per action estimated as base + rows * per row cost
+// (calibrate both with the mint_cpu benchmark, see scripts/bench.sh).
+
+#include <postoken/ledger.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+using namespace postoken;
+
+namespace {
+
+const timestamp_t sim_start = 1577836800; // 2020-01-01
+
+struct stake_spec {
+   uint16_t                min_coin_age = 0;
+   uint16_t                max_coin_age = 0;
+   std::vector<interest_t> interests;
+   std::string             interests_text;
+};
+
+struct sim_config {
+   uint32_t holders           = 1000;
+   uint32_t days              = 3 * 365;
+   uint32_t runs              = 8;
+   uint64_t seed              = 1;
+   asset    max_supply        = string_to_asset("1000000000.0000 TOK");
+   asset    initial_supply    = string_to_asset("100000000.0000 TOK");
+   double   transfer_rate     = 0.05; // transfers a holder makes per day
+   double   transfer_fraction = 0.2;  // max part of the balance one transfer sends
+   double   claimers          = 0.5;  // fraction of holders who mint
+   double   claim_interval    = 30;   // mean days between mints of a claimer
+   double   cpu_base_us       = 100;
+   double   cpu_row_us        = 5;
+   unsigned threads           = std::max(1u, std::thread::hardware_concurrency());
+};
+
+struct histogram {
+   std::vector<uint64_t> counts;
+
+   void add(size_t v) {
+      if( v >= counts.size() )
+         counts.resize(v + 1);
+      counts[v]++;
+   }
+
+   void merge(const histogram& h) {
+      if( h.counts.size() > counts.size() )
+         counts.resize(h.counts.size());
+      for( size_t i = 0; i < h.counts.size(); i++ )
+         counts[i] += h.counts[i];
+   }
+
+   uint64_t total() const {
+      uint64_t t = 0;
+      for( auto c : counts )
+         t += c;
+      return t;
+   }
+
+   size_t percentile(double p) const {
+      uint64_t target = uint64_t(std::ceil(total() * p)), seen = 0;
+      for( size_t i = 0; i < counts.size(); i++ ) {
+         seen += counts[i];
+         if( seen >= target && seen > 0 )
+            return i;
+      }
+      return 0;
+   }
+};
+
+struct run_result {
+   int64_t               issued = 0;         // supply when staking started
+   std::vector<uint32_t> sample_days;        // end of every year and the last day
+   std::vector<int64_t>  supply_samples;     // supply at sample_days
+   int32_t               exhausted_day = -1; // day max_supply was reached
+   histogram             mint_rows;
+   histogram             transfer_rows;
+   uint64_t              failed_mints = 0;
+};
+
+run_result simulate(const sim_config& cfg, const stake_spec& spec, uint64_t seed) {
+   std::mt19937_64 rng(seed);
+   std::uniform_real_distribution<double> uniform(0, 1);
+   const symbol   sym    = cfg.max_supply.sym;
+   const uint64_t issuer = cfg.holders + 1; // holders are 1..holders
+
+   ledger l;
+   l.now = sim_start;
+   l.create(issuer, cfg.max_supply);
+
+   std::lognormal_distribution<double> weight_dist(0, 1.5);
+   std::vector<double> weights(cfg.holders);
+   double weight_sum = 0;
+   for( auto& w : weights )
+      weight_sum += (w = weight_dist(rng));
+   for( uint32_t i = 0; i < cfg.holders; i++ ) {
+      int64_t amount = int64_t(cfg.initial_supply.amount * (weights[i] / weight_sum));
+      if( amount > 0 )
+         l.issue(i + 1, asset(amount, sym));
+   }
+   l.setstakespec(sim_start + 1, spec.min_coin_age, spec.max_coin_age, spec.interests);
+
+   std::vector<bool> claimer(cfg.holders);
+   for( uint32_t i = 0; i < cfg.holders; i++ )
+      claimer[i] = uniform(rng) < cfg.claimers;
+
+   run_result res;
+   const currency_stats& st = l.get_stats(sym.code());
+   res.issued = st.supply.amount;
+   for( uint32_t day = 1; day <= cfg.days; day++ ) {
+      for( uint32_t i = 0; i < cfg.holders; i++ ) {
+         l.now = sim_start + day * 86400 + uint32_t(uint64_t(i) * 86400 / cfg.holders);
+         uint64_t owner = i + 1;
+         ledger::holder& h = l.holders[owner];
+
+         if( uniform(rng) < cfg.transfer_rate ) {
+            asset* balance = h.find_balance(sym.code());
+            int64_t max_amount = balance ? int64_t(balance->amount * cfg.transfer_fraction) : 0;
+            if( max_amount > 0 ) {
+               uint64_t to = 1 + (i + 1 + rng() % (cfg.holders - 1)) % cfg.holders;
+               res.transfer_rows.add(h.ins.size());
+               l.transfer(owner, to, asset(1 + int64_t(rng() % uint64_t(max_amount)), sym));
+            }
+         }
+
+         if( claimer[i] && uniform(rng) * cfg.claim_interval < 1 ) {
+            size_t rows = h.ins.size();
+            try {
+               l.mint(owner, sym.code());
+               res.mint_rows.add(rows);
+               if( res.exhausted_day < 0 && st.supply == st.max_supply )
+                  res.exhausted_day = day;
+            } catch( const rules_error& ) {
+               res.failed_mints++;
+            }
+         }
+      }
+      if( day % 365 == 0 || day == cfg.days ) {
+         res.sample_days.push_back(day);
+         res.supply_samples.push_back(st.supply.amount);
+      }
+   }
+   return res;
+}
+
+std::vector<std::string> split(const std::string& s, char sep) {
+   std::vector<std::string> parts;
+   std::stringstream ss(s);
+   std::string part;
+   while( std::getline(ss, part, sep) )
+      parts.push_back(part);
+   return parts;
+}
+
+// "0.5000 TOK/1,0.0500 TOK/0" (rate/years of each tier)
+std::vector<interest_t> parse_interests(const std::string& s) {
+   std::vector<interest_t> v;
+   for( const auto& tier : split(s, ',') ) {
+      auto slash = tier.find('/');
+      check(slash != std::string::npos, "interest tier has to be RATE/YEARS");
+      interest_t i;
+      i.interest_rate = string_to_asset(tier.substr(0, slash));
+      i.years         = (uint16_t)std::stoul(tier.substr(slash + 1));
+      v.push_back(i);
+   }
+   return v;
+}
+
+std::vector<uint16_t> parse_list(const std::string& s) {
+   std::vector<uint16_t> v;
+   for( const auto& p : split(s, ',') )
+      v.push_back((uint16_t)std::stoul(p));
+   return v;
+}
+
+int64_t percentile(std::vector<int64_t> v, double p) {
+   std::sort(v.begin(), v.end());
+   return v[std::min(v.size() - 1, size_t(p * (v.size() - 1) + 0.5))];
+}
+
+void report(std::ostream& out, std::ostream* csv, const sim_config& cfg, const stake_spec& spec,
+            const std::vector<run_result>& runs) {
+   const symbol sym = cfg.max_supply.sym;
+   out << "min_coin_age=" << spec.min_coin_age << " max_coin_age=" << spec.max_coin_age << " anual_interests="
+       << spec.interests_text << "\n";
+
+   double issued = 0;
+   for( const auto& r : runs )
+      issued += r.issued;
+   int64_t prev = int64_t(issued / runs.size());
+   for( size_t y = 0; y < runs[0].supply_samples.size(); y++ ) {
+      std::vector<int64_t> supply;
+      double sum = 0;
+      for( const auto& r : runs ) {
+         supply.push_back(r.supply_samples[y]);
+         sum += r.supply_samples[y];
+      }
+      int64_t mean = int64_t(sum / runs.size());
+      double inflation = 100.0 * (mean - prev) / prev;
+      out << "  day " << runs[0].sample_days[y] << ": supply " << asset_to_string(asset(mean, sym)) << " (p5 "
+          << asset_to_string(asset(percentile(supply, 0.05), sym)) << ", p95 "
+          << asset_to_string(asset(percentile(supply, 0.95), sym)) << "), inflation " << inflation << "%\n";
+      if( csv )
+         *csv << spec.min_coin_age << "," << spec.max_coin_age << ",\"" << spec.interests_text << "\"," << runs[0].sample_days[y]
+              << "," << mean << "," << percentile(supply, 0.05) << "," << percentile(supply, 0.95) << "\n";
+      prev = mean;
+   }
+
+   uint32_t exhausted = 0;
+   double exhausted_day = 0;
+   histogram mint_rows, transfer_rows;
+   uint64_t failed = 0;
+   for( const auto& r : runs ) {
+      if( r.exhausted_day >= 0 ) {
+         exhausted++;
+         exhausted_day += r.exhausted_day;
+      }
+      mint_rows.merge(r.mint_rows);
+      transfer_rows.merge(r.transfer_rows);
+      failed += r.failed_mints;
+   }
+   out << "  max_supply reached in " << exhausted << "/" << runs.size() << " runs";
+   if( exhausted )
+      out << " (mean day " << uint32_t(exhausted_day / exhausted) << ")";
+   out << "\n";
+
+   auto rows_line = [&](const char* action, const histogram& h) {
+      auto cpu = [&](size_t rows) { return uint32_t(cfg.cpu_base_us + rows * cfg.cpu_row_us); };
+      out << "  " << action << ": " << h.total() << " actions, rows p50 " << h.percentile(0.5) << " p90 "
+          << h.percentile(0.9) << " p99 " << h.percentile(0.99) << " max " << h.percentile(1.0)
+          << ", est. cpu us p50 " << cpu(h.percentile(0.5)) << " p99 " << cpu(h.percentile(0.99)) << " max "
+          << cpu(h.percentile(1.0)) << "\n";
+   };
+   rows_line("mint", mint_rows);
+   rows_line("transfer", transfer_rows);
+   out << "  failed mints: " << failed << "\n";
+}
+
+void print_help() {
+   std::cout << "Usage:    postoken-sim [OPTIONS]\n"
+             << "Simulates supply growth and per action cost for every combination of stake spec parameters.\n"
+             << "  --min-coin-age LIST      comma separated values to try (default: 0)\n"
+             << "  --max-coin-age LIST      comma separated values to try (default: 30)\n"
+             << "  --interests TIERS        anual_interests to try as RATE/YEARS,... e.g. \"0.5000 TOK/1,0.0500 TOK/0\"\n"
+             << "                           (repeat the option for more alternatives)\n"
+             << "  --max-supply ASSET       (default: 1000000000.0000 TOK)\n"
+             << "  --initial-supply ASSET   issued to the population before staking starts (default: 100000000.0000 TOK)\n"
+             << "  --holders N              population size (default: 1000)\n"
+             << "  --days N                 simulated days (default: 1095)\n"
+             << "  --runs N                 runs per combination (default: 8)\n"
+             << "  --seed N                 (default: 1)\n"
+             << "  --transfer-rate X        transfers per holder per day (default: 0.05)\n"
+             << "  --transfer-fraction X    max part of the balance sent by one transfer (default: 0.2)\n"
+             << "  --claimers X             fraction of holders who mint (default: 0.5)\n"
+             << "  --claim-interval DAYS    mean days between mints of a claimer (default: 30)\n"
+             << "  --cpu-base-us X          estimated CPU of an action without transfer ins (default: 100)\n"
+             << "  --cpu-row-us X           estimated CPU per transfer in row (default: 5)\n"
+             << "  --threads N              (default: number of cores)\n"
+             << "  --csv FILE               write yearly supply of every combination as CSV\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+   sim_config cfg;
+   std::vector<uint16_t> min_ages{ 0 }, max_ages{ 30 };
+   std::vector<std::string> interests;
+   std::string csv_path;
+   try {
+      for( int i = 1; i < argc; i++ ) {
+         std::string arg = argv[i];
+         auto next = [&]() -> std::string {
+            check(i + 1 < argc, "missing option value");
+            return argv[++i];
+         };
+         if( arg == "-h" || arg == "--help" ) {
+            print_help();
+            return 0;
+         }
+         else if( arg == "--min-coin-age" )      min_ages = parse_list(next());
+         else if( arg == "--max-coin-age" )      max_ages = parse_list(next());
+         else if( arg == "--interests" )         interests.push_back(next());
+         else if( arg == "--max-supply" )        cfg.max_supply = string_to_asset(next());
+         else if( arg == "--initial-supply" )    cfg.initial_supply = string_to_asset(next());
+         else if( arg == "--holders" )           cfg.holders = std::stoul(next());
+         else if( arg == "--days" )              cfg.days = std::stoul(next());
+         else if( arg == "--runs" )              cfg.runs = std::stoul(next());
+         else if( arg == "--seed" )              cfg.seed = std::stoull(next());
+         else if( arg == "--transfer-rate" )     cfg.transfer_rate = std::stod(next());
+         else if( arg == "--transfer-fraction" ) cfg.transfer_fraction = std::stod(next());
+         else if( arg == "--claimers" )          cfg.claimers = std::stod(next());
+         else if( arg == "--claim-interval" )    cfg.claim_interval = std::stod(next());
+         else if( arg == "--cpu-base-us" )       cfg.cpu_base_us = std::stod(next());
+         else if( arg == "--cpu-row-us" )        cfg.cpu_row_us = std::stod(next());
+         else if( arg == "--threads" )           cfg.threads = std::max(1ul, std::stoul(next()));
+         else if( arg == "--csv" )               csv_path = next();
+         else {
+            print_help();
+            return 1;
+         }
+      }
+      check(cfg.holders >= 2 && cfg.runs > 0 && cfg.days > 0, "need at least 2 holders, 1 run and 1 day");
+      check(cfg.initial_supply.sym == cfg.max_supply.sym, "initial and max supply have different symbols");
+      if( interests.empty() ) {
+         int64_t unit = pow10(cfg.max_supply.sym.precision());
+         interests.push_back(asset_to_string(asset(unit / 20, cfg.max_supply.sym)) + "/0");
+      }
+
+      std::vector<stake_spec> specs;
+      for( auto min_age : min_ages )
+         for( auto max_age : max_ages )
+            for( const auto& text : interests ) {
+               if( min_age > max_age )
+                  continue;
+               stake_spec s;
+               s.min_coin_age   = min_age;
+               s.max_coin_age   = max_age;
+               s.interests      = parse_interests(text);
+               s.interests_text = text;
+               specs.push_back(s);
+            }
+      check(!specs.empty(), "no valid combination (min_coin_age > max_coin_age)");
+
+      // One job per (spec, run), picked up by the workers in order
+      std::vector<std::vector<run_result>> results(specs.size(), std::vector<run_result>(cfg.runs));
+      std::atomic<size_t> next_job{ 0 };
+      std::vector<std::string> errors(cfg.threads);
+      std::vector<std::thread> workers;
+      for( unsigned t = 0; t < cfg.threads; t++ ) {
+         workers.emplace_back([&, t]() {
+            try {
+               for( size_t job; (job = next_job++) < specs.size() * cfg.runs; ) {
+                  size_t spec = job / cfg.runs, run = job % cfg.runs;
+                  results[spec][run] = simulate(cfg, specs[spec], cfg.seed * 1000003 + run);
+               }
+            } catch( const std::exception& e ) {
+               errors[t] = e.what();
+               next_job = specs.size() * cfg.runs;
+            }
+         });
+      }
+      for( auto& w : workers )
+         w.join();
+      for( const auto& e : errors )
+         if( !e.empty() )
+            throw std::runtime_error(e);
+
+      std::ofstream csv;
+      if( !csv_path.empty() ) {
+         csv.open(csv_path);
+         csv << "min_coin_age,max_coin_age,anual_interests,day,supply_mean,supply_p5,supply_p95\n";
+      }
+      for( size_t s = 0; s < specs.size(); s++ )
+         report(std::cout, csv_path.empty() ? nullptr : &csv, cfg, specs[s], results[s]);
+      return 0;
+   } catch( const std::exception& e ) {
+      std::cerr << "error: " << e.what() << std::endl;
+      return 1;
+   }
+}